@@ -7,6 +7,8 @@
 #include "Image_Type.h"
 #include "Helper.h"
 #include "Block.h"
+#include "Block_Matching.h"
+#include "Thread_Pool.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -23,6 +25,15 @@ const struct BM3D_Para_Base
     PCType BMstep;
     double thMSE;
     double lambda;
+    int BMalgorithm;
+    PCType PSrange;
+    PCType PSnum;
+    PCType PSfull;
+    int threads;
+    size_t MemoryLimit;
+    bool TransformCache;
+    int GroupTransform;
+    int BMdepth;
 
     explicit BM3D_Para_Base(std::string _profile = "fast")
         : profile(_profile), sigma({ 10.0, 10.0, 10.0 })
@@ -30,6 +41,15 @@ const struct BM3D_Para_Base
         BlockSize = 8;
         BMrange = 16;
         BMstep = 1;
+        BMalgorithm = 0; // 0 for direct SSD of each candidate, 1 for incremental sliding-window SSD, 2 for predictive search
+        PSrange = 2; // Predictive search: radius of the window around each predicted position, in BMstep
+        PSnum = 8; // Predictive search: number of the best matches of each neighbour taken as predictions
+        PSfull = 4; // Predictive search: interval of the reference blocks and rows refreshed by a full search, 0 for never
+        threads = 0; // 0 for all the hardware threads, 1 for serial processing
+        MemoryLimit = 0; // Peak memory of the working planes in MiB, larger Frames are processed in tiles, 0 for no limit
+        TransformCache = false; // Transform each matched block once and apply only the 1D transform along the group
+        GroupTransform = 0; // 1D transform along the group, 0 for DCT, 1 for Haar, 2 for Walsh-Hadamard
+        BMdepth = 0; // Bit depth of the quantized copy of ref used only for block matching, 1-8 for 8-bit, 9-15 for 16-bit, 0 for full precision
 
         if (profile == "fast")
         {
@@ -176,21 +196,34 @@ struct BM3D_FilterData
     typedef BM3D_FilterData _Myt;
 
     typedef fftwh<FLType> fftw;
-
-    std::vector<fftw::plan> fp;
-    std::vector<fftw::plan> bp;
+    typedef fftwh_plan_cache<FLType> plan_cache;
+    typedef plan_cache::plan_ptr plan_ptr;
+
+    // 1D transform along the group, 0 for DCT, 1 for Haar, 2 for Walsh-Hadamard
+    // Haar and Walsh-Hadamard are applied with butterflies between the 2D transforms, thus have no 3D plans.
+    int transform = 0;
+
+    // Plans are shared with all the planes and stages through the process-wide plan cache
+    std::vector<plan_ptr> fp;
+    std::vector<plan_ptr> bp;
+    // Separable forward transform: 2D transform of a block, 1D transform along the group of each size
+    plan_ptr fp2d;
+    std::vector<plan_ptr> fp1d;
+    plan_ptr bp2d;
     std::vector<double> finalAMP;
     std::vector<std::vector<FLType>> thrTable;
     std::vector<FLType> wienerSigmaSqr;
 
     BM3D_FilterData() {}
 
-    BM3D_FilterData(bool wiener, double sigma, PCType GroupSize, PCType BlockSize, double lambda);
+    BM3D_FilterData(bool wiener, double sigma, PCType GroupSize, PCType BlockSize, double lambda,
+        bool separable = false, int transform = 0);
 
     BM3D_FilterData(const _Myt &right) = delete;
 
     BM3D_FilterData(_Myt &&right)
-        : fp(std::move(right.fp)), bp(std::move(right.bp)),
+        : transform(right.transform), fp(std::move(right.fp)), bp(std::move(right.bp)),
+        fp2d(std::move(right.fp2d)), fp1d(std::move(right.fp1d)), bp2d(std::move(right.bp2d)),
         finalAMP(std::move(right.finalAMP)), thrTable(std::move(right.thrTable)),
         wienerSigmaSqr(std::move(right.wienerSigmaSqr))
     {}
@@ -199,8 +232,12 @@ struct BM3D_FilterData
 
     _Myt &operator=(_Myt &&right)
     {
+        transform = right.transform;
         fp = std::move(right.fp);
         bp = std::move(right.bp);
+        fp2d = std::move(right.fp2d);
+        fp1d = std::move(right.fp1d);
+        bp2d = std::move(right.bp2d);
         finalAMP = std::move(right.finalAMP);
         thrTable = std::move(right.thrTable);
         wienerSigmaSqr = std::move(right.wienerSigmaSqr);
@@ -229,6 +266,91 @@ public:
     typedef block_type::PosCode PosCode;
     typedef block_type::PosPairCode PosPairCode;
 
+    typedef BlockGroup<FLType, FLType> group_type;
+    typedef group_type::Pos3Type Pos3Type;
+    typedef group_type::Pos3Pair Pos3Pair;
+    typedef group_type::Pos3PairCode Pos3PairCode;
+
+    // Planes of the frames of a sequence, indexed by the z of Pos3Type
+    typedef std::vector<const Plane_FL *> PlaneSeq;
+
+    // Filtered group and its aggregation weights of one plane
+    struct FilteredGroup
+    {
+        group_type group;
+        FLType numWeight = 0;
+        FLType denWeight = 0;
+    };
+
+    // Forward 2D transforms of the blocks of a plane at the positions in the groups,
+    // each position is transformed only once and shared by all the groups containing it.
+    // Rows of positions above the search windows of the current band are released.
+    struct BlockTransforms
+    {
+        struct Row
+        {
+            std::vector<PCType> slot; // Index of each position in coefs, -1 if not transformed
+            std::vector<FLType> coefs;
+            PCType count = 0;
+        };
+
+        PCType blockSize = 0;
+        PCType top = 0; // Rows above top are released
+        std::vector<Row> rows;
+
+        FLType *Coefs(const PosType &pos)
+        {
+            Row &row = rows[pos.y];
+            return row.coefs.data() + row.slot[pos.x] * blockSize * blockSize;
+        }
+
+        const FLType *Coefs(const PosType &pos) const
+        {
+            const Row &row = rows[pos.y];
+            return row.coefs.data() + row.slot[pos.x] * blockSize * blockSize;
+        }
+    };
+
+    // Rectangle [top, bottom) x [left, right) of a plane
+    struct TileRect
+    {
+        PCType top = 0;
+        PCType left = 0;
+        PCType bottom = 0;
+        PCType right = 0;
+
+        TileRect() {}
+
+        TileRect(PCType _top, PCType _left, PCType _bottom, PCType _right)
+            : top(_top), left(_left), bottom(_bottom), right(_right)
+        {}
+
+        PCType Height() const { return bottom - top; }
+        PCType Width() const { return right - left; }
+
+        // Extended by halo on each side, clipped to the plane of height x width
+        TileRect Extend(PCType halo, PCType height, PCType width) const
+        {
+            return TileRect(Max(PCType(0), top - halo), Max(PCType(0), left - halo),
+                Min(height, bottom + halo), Min(width, right + halo));
+        }
+
+        // Tile of (tileSize + halo * 2) squared containing this rectangle extended by halo, shifted inside the plane,
+        // thus all the tiles of a plane are of the same size, whose buffers are reused through the pool
+        TileRect Tile(PCType halo, PCType height, PCType width, PCType tileSize) const
+        {
+            const PCType size = tileSize + halo * 2;
+            const PCType _top = Clip(top - halo, PCType(0), Max(PCType(0), height - size));
+            const PCType _left = Clip(left - halo, PCType(0), Max(PCType(0), width - size));
+
+            return TileRect(_top, _left, Min(height, _top + size), Min(width, _left + size));
+        }
+    };
+
+    // Number of Plane_FL of the tile size held at the same time when processing a Frame in tiles,
+    // including the YUV planes of src and ref, the aggregation buffers and the filtered planes
+    static const int TilePlanes = 16;
+
 protected:
     BM3D_Para_Base para;
     std::vector<BM3D_FilterData> f;
@@ -249,13 +371,16 @@ public:
 
         para.thMSE *= normY;
 
+        // The differences of the 16-bit integer kernels are limited to signed 16-bit
+        para.BMdepth = Clip(para.BMdepth, 0, 15);
+
         // Initialize BM3D data - FFTW plans, unnormalized transform amplification factor, hard threshold table, etc.
         if (para.sigma[0] > 0) f[0] = BM3D_FilterData(wiener, para.sigma[0] / double(255) * normY,
-            para.GroupSize, para.BlockSize, para.lambda);
+            para.GroupSize, para.BlockSize, para.lambda, para.TransformCache, para.GroupTransform);
         if (para.sigma[1] > 0) f[1] = BM3D_FilterData(wiener, para.sigma[1] / double(255) * normU,
-            para.GroupSize, para.BlockSize, para.lambda);
+            para.GroupSize, para.BlockSize, para.lambda, para.TransformCache, para.GroupTransform);
         if (para.sigma[2] > 0) f[2] = BM3D_FilterData(wiener, para.sigma[2] / double(255) * normV,
-            para.GroupSize, para.BlockSize, para.lambda);
+            para.GroupSize, para.BlockSize, para.lambda, para.TransformCache, para.GroupTransform);
     }
 
     void Kernel(Plane_FL &dst, const Plane_FL &src, const Plane_FL &ref) const;
@@ -264,6 +389,32 @@ public:
         const Plane_FL &srcY, const Plane_FL &srcU, const Plane_FL &srcV,
         const Plane_FL &refY, const Plane_FL &refU, const Plane_FL &refV) const;
 
+    // Filter the planes cropped from tile of the planes of height x width
+    // Only the reference blocks of the whole planes whose groups may cover region are processed,
+    // in the same order, thus the result in region is exactly the same as filtering the whole planes,
+    // except that predictive search (BMalgorithm 2) only takes predictions from the reference blocks in tile.
+    // tile should contain region extended by TileHalo(), the rest of dst is undefined.
+    void Kernel(Plane_FL &dstY, Plane_FL &dstU, Plane_FL &dstV,
+        const Plane_FL &srcY, const Plane_FL &srcU, const Plane_FL &srcV,
+        const Plane_FL &refY, const Plane_FL &refU, const Plane_FL &refV,
+        PCType height, PCType width, const TileRect &tile, const TileRect &region) const;
+
+    // Temporal filtering of frame center of a sequence, src[plane][z] and ref[plane][z] are the YUV planes of frame z
+    // Each group takes the best blocks of all the frames, which are matched by a full search in frame center,
+    // and a predictive search in the other frames around the best PSnum matches of the adjacent frame nearer to center.
+    // Only the filtered blocks in frame center are aggregated. MemoryLimit and TransformCache are not applied.
+    void Kernel(Plane_FL *const dst[], const PlaneSeq src[], const PlaneSeq ref[], PCType center) const;
+
+    // The search windows of the reference blocks covering a pixel are within this distance from it
+    PCType TileHalo() const
+    {
+        return 2 * para.BMrange + para.BlockSize - 1;
+    }
+
+    // Side length of the square tiles whose working planes fit in para.MemoryLimit,
+    // halo is the total halo of all the stages, 0 if the planes of height x width can be processed at once
+    PCType TileSize(PCType height, PCType width, PCType halo) const;
+
     virtual bool RGB2YUV(Plane_FL &srcY, Plane_FL &srcU, Plane_FL &srcV,
         Plane_FL &refY, Plane_FL &refU, Plane_FL &refV,
         const Plane &srcR, const Plane &srcG, const Plane &srcB,
@@ -275,12 +426,130 @@ protected:
     virtual Frame &process_Frame(Frame &dst, const Frame &src, const Frame &ref) override;
 
 protected:
-    PosPairCode BlockMatching(const Plane_FL &ref, PCType j, PCType i) const;
+    // Scan positions of reference blocks, stored row by row
+    std::vector<PosCode> RefBlockPos(PCType height, PCType width) const;
+
+    // Scan positions of the reference blocks of the planes of height x width whose groups may cover region,
+    // relative to the top-left of tile
+    std::vector<PosCode> RefBlockPos(PCType height, PCType width, const TileRect &tile, const TileRect &region) const;
+
+    bool Skip() const
+    {
+        return (para.sigma[0] <= 0 && para.sigma[1] <= 0 && para.sigma[2] <= 0)
+            || para.GroupSize == 0 || para.BlockSize <= 0
+            || para.BMrange <= 0 || para.BMrange < para.BMstep || para.thMSE <= 0;
+    }
+
+    void Kernel(Plane_FL &dstY, Plane_FL &dstU, Plane_FL &dstV,
+        const Plane_FL &srcY, const Plane_FL &srcU, const Plane_FL &srcV,
+        const Plane_FL &refY, const Plane_FL &refU, const Plane_FL &refV,
+        const std::vector<PosCode> &refPos) const;
+
+    // Block matching, collaborative filtering and aggregation of the planes with mask bit set
+    void Kernel(int mask, Plane_FL *const ResNum[], Plane_FL *const ResDen[],
+        const Plane_FL *const src[], const Plane_FL *const ref[], const std::vector<PosCode> &refPos) const;
+
+    // Process the Frame in tiles of tileSize, see TileSize()
+    Frame &process_Frame_Tiled(Frame &dst, const Frame &src, const Frame &ref, PCType tileSize) const;
+
+    // matchCodes holds the match code of each reference block when it's matched in advance, otherwise it's empty
+    void Kernel_Serial(int mask, Plane_FL *const ResNum[], Plane_FL *const ResDen[],
+        const Plane_FL *const src[], const Plane_FL *const ref[],
+        const std::vector<PosCode> &refPos, const std::vector<PosPairCode> &matchCodes) const;
+
+    // Rows of reference blocks are split into bands, and the reference blocks in each band are processed in parallel.
+    // The filtered groups are aggregated in the same order as the serial path, thus the result is bit-identical.
+    // With para.TransformCache, each band is matched first, and the new positions in its groups are transformed
+    // into the BlockTransforms of each plane before filtering, which is also used for serial processing.
+    void Kernel_Parallel(int mask, Plane_FL *const ResNum[], Plane_FL *const ResDen[],
+        const Plane_FL *const src[], const Plane_FL *const ref[],
+        const std::vector<PosCode> &refPos, const std::vector<PosPairCode> &matchCodes, int threads) const;
+
+    // The block matching functions take either Plane_FL, or Plane_8 and Plane_16 quantized from it in para.BMdepth bits,
+    // whose distances are computed by the integer kernels, while the keys are still the MSE in 8-bit scale
+    template < typename _St1 >
+    PosPairCode BlockMatching(const _St1 &ref, PCType j, PCType i) const;
+
+    // Block matching of all the reference blocks with direct SSD, incremental sliding-window SSD or predictive search
+    // Rows of reference blocks are split into contiguous chunks processed in parallel,
+    // for predictive search each chunk holds PSfull rows, which don't depend on the other chunks
+    template < typename _St1 >
+    void BlockMatching(std::vector<PosPairCode> &matchCodes, const _St1 &ref,
+        const std::vector<PosCode> &refPos, int threads) const;
+
+    // Block matching of the reference block in frame center, see the temporal Kernel()
+    template < typename _St1 >
+    Pos3PairCode BlockMatching(const std::vector<const _St1 *> &ref, PCType center, PCType j, PCType i) const;
+
+    // Number of the blocks taken into the group of a match code of count blocks
+    PCType GroupSize(size_t count) const
+    {
+        PCType size = static_cast<PCType>(count);
+
+        // When para.GroupSize > 0, limit GroupSize up to para.GroupSize
+        if (para.GroupSize > 0 && size > para.GroupSize)
+        {
+            size = para.GroupSize;
+        }
+
+        // Haar and Walsh-Hadamard transforms take the largest power of 2 not larger than it
+        if (para.GroupTransform != 0)
+        {
+            PCType pow2 = 1;
+            while (pow2 * 2 <= size) pow2 *= 2;
+            size = pow2;
+        }
+
+        return size;
+    }
+
+    // Transform the blocks of the groups in codes not in dst yet, see BlockTransforms
+    // The rows of positions above top are released, they must not be used by the following groups.
+    void TransformBlocks(BlockTransforms &dst, int plane, const Plane_FL &src,
+        const std::vector<const PosPairCode *> &codes, PCType top, int threads) const;
+
+    // Construct the group of src guided by code and apply forward 3D transform to it,
+    // the 2D transforms of the blocks are taken from cache if it's not nullptr
+    void ForwardTransform(group_type &dst, int plane, const Plane_FL &src,
+        const PosPairCode &code, const BlockTransforms *cache) const;
+
+    // Apply forward 3D transform to the group
+    void ForwardTransform(group_type &group, int plane) const;
+
+    // Apply forward 1D transform along the group to the group of 2D transformed blocks
+    void ForwardTransform1D(group_type &group, int plane) const;
+
+    // Apply backward 3D transform to the filtered group
+    void BackwardTransform(group_type &group, int plane) const;
 
-    virtual void CollaborativeFilter(int plane,
-        Plane_FL &ResNum, Plane_FL &ResDen,
-        const Plane_FL &src, const Plane_FL &ref,
-        const PosPairCode &code) const = 0;
+    // Whether FilterGroup() uses the transformed groups of ref
+    virtual bool TransformRef() const
+    {
+        return false;
+    }
+
+    void Aggregate(Plane_FL &ResNum, Plane_FL &ResDen, const FilteredGroup &filtered) const
+    {
+        // Store the weighted filtered group to the numerator part of the final estimation
+        // Store the weight to the denominator part of the final estimation
+        filtered.group.AddTo(ResNum, filtered.numWeight);
+        filtered.group.CountTo(ResDen, filtered.denWeight);
+    }
+
+    // srcCache and refCache hold the 2D transforms of the blocks of src and ref, or nullptr to transform the groups
+    void CollaborativeFilter(int plane, FilteredGroup &dst,
+        const Plane_FL &src, const Plane_FL &ref, const PosPairCode &code,
+        const BlockTransforms *srcCache, const BlockTransforms *refCache) const;
+
+    // Groups of blocks in the frames of a sequence, src[z] and ref[z] are the data of the planes of frame z
+    void CollaborativeFilter(int plane, FilteredGroup &dst,
+        const std::vector<const FLType *> &src, const std::vector<const FLType *> &ref, PCType stride,
+        const Pos3PairCode &code) const;
+
+    // Filter the transformed group dst.group guided by the transformed reference group,
+    // then apply backward 3D transform to it and calculate its aggregation weights.
+    // refGroup is dst.group itself when TransformRef() is false.
+    virtual void FilterGroup(int plane, FilteredGroup &dst, const group_type &refGroup) const = 0;
 };
 
 
@@ -302,10 +571,7 @@ public:
         const Plane &refR, const Plane &refG, const Plane &refB) const override;
 
 protected:
-    virtual void CollaborativeFilter(int plane,
-        Plane_FL &ResNum, Plane_FL &ResDen,
-        const Plane_FL &src, const Plane_FL &ref,
-        const PosPairCode &code) const override;
+    virtual void FilterGroup(int plane, FilteredGroup &dst, const group_type &refGroup) const override;
 };
 
 
@@ -327,10 +593,12 @@ public:
         const Plane &refR, const Plane &refG, const Plane &refB) const override;
 
 protected:
-    virtual void CollaborativeFilter(int plane,
-        Plane_FL &ResNum, Plane_FL &ResDen,
-        const Plane_FL &src, const Plane_FL &ref,
-        const PosPairCode &code) const override;
+    virtual bool TransformRef() const override
+    {
+        return true;
+    }
+
+    virtual void FilterGroup(int plane, FilteredGroup &dst, const group_type &refGroup) const override;
 };
 
 
@@ -354,6 +622,11 @@ protected:
     virtual Plane_FL &process_Plane_FL(Plane_FL &dst, const Plane_FL &src, const Plane_FL &ref) override;
     virtual Plane &process_Plane(Plane &dst, const Plane &src, const Plane &ref) override;
     virtual Frame &process_Frame(Frame &dst, const Frame &src, const Frame &ref) override;
+
+    // Process the Frame in tiles of tileSize, the basic estimate is computed on each tile extended by the halo
+    // of the final estimate, thus only the working planes of one tile are held in memory.
+    // The limit of the basic estimate para.basic.MemoryLimit applies to the whole process.
+    Frame &process_Frame_Tiled(Frame &dst, const Frame &src, const Frame &ref, PCType tileSize) const;
 };
 
 
@@ -370,6 +643,10 @@ public:
 protected:
     BM3D_Para para;
     std::string RPath;
+    std::string WisdomPath;
+
+    std::unique_ptr<BM3D> filter;
+    Frame ref;
 
     virtual void arguments_process() override
     {
@@ -406,6 +683,11 @@ protected:
                 ArgsObj.GetPara(i, RPath);
                 continue;
             }
+            if (args[i] == "-W" || args[i] == "--wisdom")
+            {
+                ArgsObj.GetPara(i, WisdomPath);
+                continue;
+            }
             if (args[i] == "-S" || args[i] == "--sigma")
             {
                 double sigma;
@@ -480,6 +762,64 @@ protected:
                 thMSE2_def = true;
                 continue;
             }
+            if (args[i] == "-MA1" || args[i] == "--BMalgorithm1")
+            {
+                ArgsObj.GetPara(i, para.basic.BMalgorithm);
+                continue;
+            }
+            if (args[i] == "-MA2" || args[i] == "--BMalgorithm2")
+            {
+                ArgsObj.GetPara(i, para.final.BMalgorithm);
+                continue;
+            }
+            if (args[i] == "-PR" || args[i] == "--PSrange")
+            {
+                ArgsObj.GetPara(i, para.basic.PSrange);
+                para.final.PSrange = para.basic.PSrange;
+                continue;
+            }
+            if (args[i] == "-PN" || args[i] == "--PSnum")
+            {
+                ArgsObj.GetPara(i, para.basic.PSnum);
+                para.final.PSnum = para.basic.PSnum;
+                continue;
+            }
+            if (args[i] == "-PF" || args[i] == "--PSfull")
+            {
+                ArgsObj.GetPara(i, para.basic.PSfull);
+                para.final.PSfull = para.basic.PSfull;
+                continue;
+            }
+            if (args[i] == "-NT" || args[i] == "--threads")
+            {
+                ArgsObj.GetPara(i, para.basic.threads);
+                para.final.threads = para.basic.threads;
+                continue;
+            }
+            if (args[i] == "-ML" || args[i] == "--MemoryLimit")
+            {
+                ArgsObj.GetPara(i, para.basic.MemoryLimit);
+                para.final.MemoryLimit = para.basic.MemoryLimit;
+                continue;
+            }
+            if (args[i] == "-GT" || args[i] == "--GroupTransform")
+            {
+                ArgsObj.GetPara(i, para.basic.GroupTransform);
+                para.final.GroupTransform = para.basic.GroupTransform;
+                continue;
+            }
+            if (args[i] == "-TC" || args[i] == "--TransformCache")
+            {
+                ArgsObj.GetPara(i, para.basic.TransformCache);
+                para.final.TransformCache = para.basic.TransformCache;
+                continue;
+            }
+            if (args[i] == "-MD" || args[i] == "--BMdepth")
+            {
+                ArgsObj.GetPara(i, para.basic.BMdepth);
+                para.final.BMdepth = para.basic.BMdepth;
+                continue;
+            }
             if (args[i][0] == '-')
             {
                 i++;
@@ -504,18 +844,31 @@ protected:
         if (!thMSE2_def) para.final.thMSE_Default();
     }
 
-    virtual Frame process(const Frame &src) override
+    virtual void prepare() override
     {
-        BM3D filter(para);
+        // Load FFTW wisdom from --wisdom or ISP_MW_FFTW_WISDOM before planning, and save the new wisdom afterwards
+        BM3D_FilterData::plan_cache &cache = BM3D_FilterData::plan_cache::instance();
+        cache.load_wisdom(WisdomPath);
+
+        filter.reset(new BM3D(para));
+
+        cache.save_wisdom();
+
+        if (RPath.size() > 0)
+        {
+            ref = ImageReader(RPath);
+        }
+    }
 
+    virtual Frame process(const Frame &src) override
+    {
         if (RPath.size() == 0)
         {
-            return filter(src);
+            return (*filter)(src);
         }
         else
         {
-            const Frame ref = ImageReader(RPath);
-            return filter(src, ref);
+            return (*filter)(src, ref);
         }
     }
 
@@ -526,6 +879,12 @@ public:
 };
 
 
+// Create the FFTW plans of all the BM3D profiles and export the wisdom to filename (or ISP_MW_FFTW_WISDOM if empty),
+// so that later runs with the same wisdom file skip the FFTW_PATIENT planning.
+// Command line: ISP_MW --fftw_wisdom <path>
+int BM3D_Warm_Wisdom(const std::string &filename = "");
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
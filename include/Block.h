@@ -3,6 +3,7 @@
 
 
 #include "Image_Type.h"
+#include "Block_Distance.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -503,7 +504,6 @@ public:
     {
         bool end = false;
         PosType pos;
-        dist_type temp;
         dist_type distMin = TypeMax<dist_type>();
 
         range = range / step * step;
@@ -516,32 +516,18 @@ public:
         double distMul = double(1) / MSE2SSE;
         dist_type thSSE = static_cast<dist_type>(thMSE * MSE2SSE);
 
+        const auto SSD = Block_SSD<value_type, _St1, dist_type>::Select(Height(), Width());
+
         for (PCType j = t; j <= b; j += step)
         {
             for (PCType i = l; i <= r; i += step)
             {
-                dist_type dist = 0;
-
                 if (excludeCurPos && j == PosY() && i == PosX())
                 {
                     continue;
                 }
-                else
-                {
-                    auto refp = data();
-                    auto srcp = src + j * src_stride + i;
 
-                    for (PCType y = 0; y < Height(); ++y)
-                    {
-                        PCType x = y * src_stride;
-
-                        for (PCType upper = x + Width(); x < upper; ++x, ++refp)
-                        {
-                            temp = static_cast<dist_type>(*refp) - static_cast<dist_type>(srcp[x]);
-                            dist += temp * temp;
-                        }
-                    }
-                }
+                dist_type dist = SSD(data(), src + j * src_stride + i, src_stride, Height(), Width());
 
                 if (dist < distMin)
                 {
@@ -569,7 +555,7 @@ public:
     template < typename _St1 >
     PosPair BlockMatching(const _St1 &src, PCType range, PCType step, double thMSE = 10, bool excludeCurPos = false) const
     {
-        return BlockMatching(src.data(), src.Height(), src.Width(), src.Stride(), src.ValueRange(), range, step, thMSE, excludeCurPos);
+        return BlockMatching(src.data(), src.Height(), src.Width(), src.Stride(), static_cast<typename _St1::value_type>(src.ValueRange()), range, step, thMSE, excludeCurPos);
     }
 
     ////////////////////////////////////////////////////////////////
@@ -586,38 +572,109 @@ public:
         size_t index = match_code.size();
         match_code.resize(index + search_pos.size());
 
+        const auto SSD = Block_SSD<value_type, _St1, dist_type>::Select(Height(), Width());
+
         for (auto pos : search_pos)
         {
-            dist_type dist = 0;
+            dist_type dist = SSD(data(), src + pos.y * src_stride + pos.x, src_stride, Height(), Width());
+
+            // Only match similar blocks but not identical blocks
+            if (dist <= thSSE && dist != 0)
+            {
+                match_code[index++] = PosPair(static_cast<KeyType>(dist * distMul), pos);
+            }
+        }
 
-            auto refp = data();
-            auto srcp = src + pos.y * src_stride + pos.x;
+        match_code.resize(index);
+    }
 
-            for (PCType y = 0; y < Height(); ++y)
+    template < typename _St1 >
+    void BlockMatchingMulti(PosPairCode &match_code, const _St1 &src, const PosCode &search_pos, double thMSE) const
+    {
+        BlockMatchingMulti(match_code, src.data(), src.Stride(), static_cast<typename _St1::value_type>(src.ValueRange()), search_pos, thMSE);
+    }
+
+    // Append the best match_size matched blocks of search_pos to match_code,
+    // the entries already in match_code take part in the selection, whose keys should be 0 (the current position).
+    // The best blocks are kept in a bounded max-heap during the search, and the distance of each candidate is stopped
+    // once it exceeds the worst kept block, thus most of the work for hopeless candidates is skipped.
+    // The result is the same as sorting all the matched blocks and keeping the first match_size ones,
+    // with ties broken by position. When no more than match_size blocks are matched, they're sorted only if sorted is set.
+    template < typename _St1 >
+    void BlockMatchingTopK(PosPairCode &match_code, const _St1 *src, PCType src_stride, _St1 src_range,
+        const PosCode &search_pos, double thMSE, size_t match_size, bool sorted = true) const
+    {
+        double MSE2SSE = static_cast<double>(PixelCount()) * src_range * src_range / double(255 * 255);
+        double distMul = double(1) / MSE2SSE;
+        dist_type thSSE = static_cast<dist_type>(thMSE * MSE2SSE);
+
+        const auto SSD = Block_SSD<value_type, _St1, dist_type>::SelectBounded(Height(), Width());
+
+        // The keys hold SSE during the search, which are converted to MSE at last
+        auto less = [](const PosPair &left, const PosPair &right)
+        {
+            return left.first < right.first || (left.first == right.first && left.second < right.second);
+        };
+
+        bool heap = false;
+
+        for (auto pos : search_pos)
+        {
+            const dist_type bound = heap ? Min(thSSE, match_code.front().first) : thSSE;
+            dist_type dist = SSD(data(), src + pos.y * src_stride + pos.x, src_stride, Height(), Width(), bound);
+
+            // Only match similar blocks but not identical blocks
+            if (dist > bound || dist == 0)
             {
-                PCType x = y * src_stride;
+                continue;
+            }
+
+            const PosPair entry(dist, pos);
 
-                for (PCType upper = x + Width(); x < upper; ++x, ++refp)
+            if (heap)
+            {
+                if (less(entry, match_code.front()))
                 {
-                    dist_type temp = static_cast<dist_type>(*refp) - static_cast<dist_type>(srcp[x]);
-                    dist += temp * temp;
+                    std::pop_heap(match_code.begin(), match_code.end(), less);
+                    match_code.back() = entry;
+                    std::push_heap(match_code.begin(), match_code.end(), less);
                 }
             }
-
-            // Only match similar blocks but not identical blocks
-            if (dist <= thSSE && dist != 0)
+            else
             {
-                match_code[index++] = PosPair(static_cast<KeyType>(dist * distMul), pos);
+                match_code.push_back(entry);
+
+                if (match_code.size() > match_size)
+                {
+                    std::make_heap(match_code.begin(), match_code.end(), less);
+                    std::pop_heap(match_code.begin(), match_code.end(), less);
+                    match_code.pop_back();
+                    heap = true;
+                }
             }
         }
 
-        match_code.resize(index);
+        for (auto &code : match_code)
+        {
+            code.first = static_cast<KeyType>(code.first * distMul);
+        }
+
+        // Always sorted when size of match code is larger than match_size
+        if (heap)
+        {
+            std::sort_heap(match_code.begin(), match_code.end(), less);
+        }
+        else if (sorted)
+        {
+            std::stable_sort(match_code.begin(), match_code.end());
+        }
     }
 
     template < typename _St1 >
-    void BlockMatchingMulti(PosPairCode &match_code, const _St1 &src, const PosCode &search_pos, double thMSE) const
+    void BlockMatchingTopK(PosPairCode &match_code, const _St1 &src, const PosCode &search_pos, double thMSE,
+        size_t match_size, bool sorted = true) const
     {
-        BlockMatchingMulti(match_code, src.data(), src.Stride(), src.ValueRange(), search_pos, thMSE);
+        BlockMatchingTopK(match_code, src.data(), src.Stride(), static_cast<typename _St1::value_type>(src.ValueRange()), search_pos, thMSE, match_size, sorted);
     }
 
     template < typename _St1 >
@@ -626,19 +683,15 @@ public:
     {
         PosPairCode match_code;
 
-        BlockMatchingMulti(match_code, src, src_stride, src_range, search_pos, thMSE);
-
         // When match_size > 0, it's the upper limit of the number of matched blocks
-        if (match_size > 0 && match_code.size() > match_size)
+        if (match_size > 0)
         {
-            // Always sorted when size of match code is larger than match_size,
-            // since std::partial_sort is faster than std::nth_element
-            std::partial_sort(match_code.begin(), match_code.begin() + match_size, match_code.end());
-            match_code.resize(match_size);
+            BlockMatchingTopK(match_code, src, src_stride, src_range, search_pos, thMSE, match_size, sorted);
         }
-        else if (sorted)
+        else
         {
-            std::stable_sort(match_code.begin(), match_code.end());
+            BlockMatchingMulti(match_code, src, src_stride, src_range, search_pos, thMSE);
+            if (sorted) std::stable_sort(match_code.begin(), match_code.end());
         }
 
         return match_code;
@@ -648,7 +701,7 @@ public:
     PosPairCode BlockMatchingMulti(const _St1 &src, const PosCode &search_pos, double thMSE,
         size_t match_size = 0, bool sorted = true) const
     {
-        return BlockMatchingMulti(src.data(), src.Stride(), src.ValueRange(), search_pos, thMSE, match_size, sorted);
+        return BlockMatchingMulti(src.data(), src.Stride(), static_cast<typename _St1::value_type>(src.ValueRange()), search_pos, thMSE, match_size, sorted);
     }
 
     // excludeCurPos:
@@ -681,22 +734,21 @@ public:
             }
         }
 
+        // The slot of the excluded current position is left unused
+        search_pos.resize(index);
+
         PosPairCode match_code;
         if (excludeCurPos == 1) match_code.push_back(PosPair(static_cast<KeyType>(0), PosType(PosY(), PosX())));
 
-        BlockMatchingMulti(match_code, src, src_stride, src_range, search_pos, thMSE);
-
         // When match_size > 0, it's the upper limit of the number of matched blocks
-        if (match_size > 0 && match_code.size() > match_size)
+        if (match_size > 0)
         {
-            // Always sorted when size of match code is larger than match_size,
-            // since std::partial_sort is faster than std::nth_element
-            std::partial_sort(match_code.begin(), match_code.begin() + match_size, match_code.end());
-            match_code.resize(match_size);
+            BlockMatchingTopK(match_code, src, src_stride, src_range, search_pos, thMSE, match_size, sorted);
         }
-        else if (sorted)
+        else
         {
-            std::stable_sort(match_code.begin(), match_code.end());
+            BlockMatchingMulti(match_code, src, src_stride, src_range, search_pos, thMSE);
+            if (sorted) std::stable_sort(match_code.begin(), match_code.end());
         }
 
         return match_code;
@@ -706,7 +758,7 @@ public:
     PosPairCode BlockMatchingMulti(const _St1 &src, PCType range, PCType step, double thMSE,
         int excludeCurPos = 1, size_t match_size = 0, bool sorted = true) const
     {
-        return BlockMatchingMulti(src.data(), src.Height(), src.Width(), src.Stride(), src.ValueRange(),
+        return BlockMatchingMulti(src.data(), src.Height(), src.Width(), src.Stride(), static_cast<typename _St1::value_type>(src.ValueRange()),
             range, step, thMSE, excludeCurPos, match_size, sorted);
     }
 
@@ -907,6 +959,13 @@ public:
         InitValue(Init, Value);
     }
 
+    // Constructor from PosPairCode, the data is not initialized
+    BlockGroup(const PosPairCode &code, PCType _GroupSize = -1, PCType _Height = 16, PCType _Width = 16)
+        : Height_(_Height), Width_(_Width)
+    {
+        FromCode(code, _GroupSize);
+    }
+
     // Constructor from plane pointer and PosPairCode
     template < typename _St1 >
     BlockGroup(const _St1 *src, PCType src_stride, const PosPairCode &code,
@@ -1271,6 +1330,13 @@ public:
 
         for (PCType z = 0; z < GroupSize(); ++z)
         {
+            // The blocks of the planes whose dst is nullptr are skipped
+            if (dst[GetPos3(z).z] == nullptr)
+            {
+                srcp += Height() * Width();
+                continue;
+            }
+
             auto dstp = dst[GetPos3(z).z] + GetPos3(z).y * dst_stride + GetPos3(z).x;
 
             for (PCType y = 0; y < Height(); ++y)
@@ -1292,6 +1358,13 @@ public:
 
         for (PCType z = 0; z < GroupSize(); ++z)
         {
+            // The blocks of the planes whose dst is nullptr are skipped
+            if (dst[GetPos3(z).z] == nullptr)
+            {
+                srcp += Height() * Width();
+                continue;
+            }
+
             auto dstp = dst[GetPos3(z).z] + GetPos3(z).y * dst_stride + GetPos3(z).x;
 
             for (PCType y = 0; y < Height(); ++y)
@@ -1361,6 +1434,12 @@ public:
     {
         for (PCType z = 0; z < GroupSize(); ++z)
         {
+            // The blocks of the planes whose dst is nullptr are skipped
+            if (dst[GetPos3(z).z] == nullptr)
+            {
+                continue;
+            }
+
             auto dstp = dst[GetPos3(z).z] + GetPos3(z).y * dst_stride + GetPos3(z).x;
 
             for (PCType y = 0; y < Height(); ++y)
@@ -1380,6 +1459,12 @@ public:
     {
         for (PCType z = 0; z < GroupSize(); ++z)
         {
+            // The blocks of the planes whose dst is nullptr are skipped
+            if (dst[GetPos3(z).z] == nullptr)
+            {
+                continue;
+            }
+
             auto dstp = dst[GetPos3(z).z] + GetPos3(z).y * dst_stride + GetPos3(z).x;
 
             for (PCType y = 0; y < Height(); ++y)
@@ -0,0 +1,259 @@
+#ifndef BLOCK_DISTANCE_H_
+#define BLOCK_DISTANCE_H_
+
+
+#include <iostream>
+#include "Type.h"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Instruction set levels of the distance kernels
+enum class SIMD_Level
+{
+    None = 0,
+    SSE2 = 1,
+    AVX2 = 2,
+    AVX512 = 3
+};
+
+
+// Highest level supported by both the CPU and the OS
+SIMD_Level SIMD_Detect();
+
+// Level currently used by the dispatched kernels, initialized to SIMD_Detect()
+SIMD_Level SIMD_Current();
+
+// Force the level of the dispatched kernels, clipped to SIMD_Detect()
+void SIMD_Set(SIMD_Level level);
+
+const char *SIMD_Name(SIMD_Level level);
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Sum of squared differences between a ref block stored continuously and a block in the src plane
+// The generic version is a scalar loop, float and double kernels are dispatched to SIMD versions at runtime,
+// with fixed-size unrolled variants for 8x8 and 11x11 blocks.
+// Note that the SIMD kernels accumulate in a different order, thus the result may differ from the scalar loop in the last bits.
+// The bounded kernels may stop once the partial sum exceeds bound and return the partial sum,
+// otherwise they return exactly the same result as the unbounded kernels of the same level.
+template < typename _Ty, typename _St1, typename _DTy >
+struct Block_SSD_Base
+{
+    typedef _DTy (*func_type)(const _Ty *ref, const _St1 *src, PCType src_stride, PCType height, PCType width);
+    typedef _DTy (*bounded_type)(const _Ty *ref, const _St1 *src, PCType src_stride, PCType height, PCType width, _DTy bound);
+
+    static _DTy Scalar(const _Ty *ref, const _St1 *src, PCType src_stride, PCType height, PCType width)
+    {
+        _DTy dist = 0;
+
+        for (PCType y = 0; y < height; ++y)
+        {
+            for (PCType x = 0; x < width; ++x, ++ref)
+            {
+                _DTy temp = static_cast<_DTy>(*ref) - static_cast<_DTy>(src[x]);
+                dist += temp * temp;
+            }
+
+            src += src_stride;
+        }
+
+        return dist;
+    }
+
+    static _DTy ScalarBounded(const _Ty *ref, const _St1 *src, PCType src_stride, PCType height, PCType width, _DTy bound)
+    {
+        _DTy dist = 0;
+
+        for (PCType y = 0; y < height; ++y)
+        {
+            for (PCType x = 0; x < width; ++x, ++ref)
+            {
+                _DTy temp = static_cast<_DTy>(*ref) - static_cast<_DTy>(src[x]);
+                dist += temp * temp;
+            }
+
+            if (dist > bound)
+            {
+                break;
+            }
+
+            src += src_stride;
+        }
+
+        return dist;
+    }
+};
+
+
+template < typename _Ty, typename _St1, typename _DTy >
+struct Block_SSD
+    : public Block_SSD_Base<_Ty, _St1, _DTy>
+{
+    typedef Block_SSD_Base<_Ty, _St1, _DTy> _Mybase;
+    typedef typename _Mybase::func_type func_type;
+    typedef typename _Mybase::bounded_type bounded_type;
+
+    static func_type Select(PCType height, PCType width, SIMD_Level level = SIMD_Current())
+    {
+        return _Mybase::Scalar;
+    }
+
+    static bounded_type SelectBounded(PCType height, PCType width, SIMD_Level level = SIMD_Current())
+    {
+        return _Mybase::ScalarBounded;
+    }
+};
+
+
+template < >
+struct Block_SSD<float, float, float>
+    : public Block_SSD_Base<float, float, float>
+{
+    static func_type Select(PCType height, PCType width, SIMD_Level level = SIMD_Current());
+    static bounded_type SelectBounded(PCType height, PCType width, SIMD_Level level = SIMD_Current());
+};
+
+
+template < >
+struct Block_SSD<double, double, double>
+    : public Block_SSD_Base<double, double, double>
+{
+    static func_type Select(PCType height, PCType width, SIMD_Level level = SIMD_Current());
+    static bounded_type SelectBounded(PCType height, PCType width, SIMD_Level level = SIMD_Current());
+};
+
+
+// Integer kernels of the reduced-precision planes used for block matching (Plane_8 and Plane_16),
+// the squared differences are summed exactly in integers by pmaddwd, and converted to the distance type at last.
+// The 16-bit kernels require at most 15-bit data, since the differences are multiplied as signed 16-bit integers.
+// AVX-512 falls back to the AVX2 kernels.
+template < >
+struct Block_SSD<uint8, uint8, float>
+    : public Block_SSD_Base<uint8, uint8, float>
+{
+    static func_type Select(PCType height, PCType width, SIMD_Level level = SIMD_Current());
+    static bounded_type SelectBounded(PCType height, PCType width, SIMD_Level level = SIMD_Current());
+};
+
+
+template < >
+struct Block_SSD<uint8, uint8, double>
+    : public Block_SSD_Base<uint8, uint8, double>
+{
+    static func_type Select(PCType height, PCType width, SIMD_Level level = SIMD_Current());
+    static bounded_type SelectBounded(PCType height, PCType width, SIMD_Level level = SIMD_Current());
+};
+
+
+template < >
+struct Block_SSD<uint16, uint16, float>
+    : public Block_SSD_Base<uint16, uint16, float>
+{
+    static func_type Select(PCType height, PCType width, SIMD_Level level = SIMD_Current());
+    static bounded_type SelectBounded(PCType height, PCType width, SIMD_Level level = SIMD_Current());
+};
+
+
+template < >
+struct Block_SSD<uint16, uint16, double>
+    : public Block_SSD_Base<uint16, uint16, double>
+{
+    static func_type Select(PCType height, PCType width, SIMD_Level level = SIMD_Current());
+    static bounded_type SelectBounded(PCType height, PCType width, SIMD_Level level = SIMD_Current());
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Weighted accumulation of a block in the src plane to the sums stored continuously,
+// sum1 += src * weight, and sum2 += src * src * weight when sum2 is not nullptr.
+// float and double sums of float, double and DType planes are dispatched to SIMD versions at runtime.
+// Each element is computed by the same operations as the scalar loop, thus the results are exactly the same.
+// AVX-512 falls back to the AVX2 kernels.
+template < typename _St1, typename _DTy >
+struct Block_WeightedSum_Base
+{
+    typedef void (*func_type)(_DTy *sum1, _DTy *sum2, const _St1 *src, PCType src_stride, PCType height, PCType width, _DTy weight);
+
+    static void Scalar(_DTy *sum1, _DTy *sum2, const _St1 *src, PCType src_stride, PCType height, PCType width, _DTy weight)
+    {
+        for (PCType y = 0; y < height; ++y)
+        {
+            if (sum2)
+            {
+                for (PCType x = 0; x < width; ++x, ++sum1, ++sum2)
+                {
+                    _DTy temp = static_cast<_DTy>(src[x]) * weight;
+                    *sum1 += temp;
+                    *sum2 += static_cast<_DTy>(src[x]) * temp;
+                }
+            }
+            else
+            {
+                for (PCType x = 0; x < width; ++x, ++sum1)
+                {
+                    *sum1 += static_cast<_DTy>(src[x]) * weight;
+                }
+            }
+
+            src += src_stride;
+        }
+    }
+};
+
+
+template < typename _St1, typename _DTy >
+struct Block_WeightedSum
+    : public Block_WeightedSum_Base<_St1, _DTy>
+{
+    typedef Block_WeightedSum_Base<_St1, _DTy> _Mybase;
+    typedef typename _Mybase::func_type func_type;
+
+    static func_type Select(SIMD_Level level = SIMD_Current())
+    {
+        return _Mybase::Scalar;
+    }
+};
+
+
+template < >
+struct Block_WeightedSum<float, float>
+    : public Block_WeightedSum_Base<float, float>
+{
+    static func_type Select(SIMD_Level level = SIMD_Current());
+};
+
+
+template < >
+struct Block_WeightedSum<double, double>
+    : public Block_WeightedSum_Base<double, double>
+{
+    static func_type Select(SIMD_Level level = SIMD_Current());
+};
+
+
+template < >
+struct Block_WeightedSum<DType, float>
+    : public Block_WeightedSum_Base<DType, float>
+{
+    static func_type Select(SIMD_Level level = SIMD_Current());
+};
+
+
+template < >
+struct Block_WeightedSum<DType, double>
+    : public Block_WeightedSum_Base<DType, double>
+{
+    static func_type Select(SIMD_Level level = SIMD_Current());
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#endif
@@ -0,0 +1,490 @@
+#ifndef BLOCK_MATCHING_H_
+#define BLOCK_MATCHING_H_
+
+
+#include "Block.h"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Scan positions of reference blocks along one dimension
+// The last position is aligned to the boundary
+inline std::vector<PCType> BlockScanLine(PCType length, PCType block_size, PCType block_step)
+{
+    std::vector<PCType> linePos;
+
+    PCType BlockPosLast = length - block_size;
+
+    for (PCType p = 0;; p += block_step)
+    {
+        if (p >= BlockPosLast + block_step)
+        {
+            break;
+        }
+        else if (p > BlockPosLast)
+        {
+            p = BlockPosLast;
+        }
+
+        linePos.push_back(p);
+    }
+
+    return linePos;
+}
+
+
+// Scan positions of reference blocks stored row by row
+// The last row and column are aligned to the bottom and right boundary
+inline std::vector<std::vector<Pos>> BlockScanPos(PCType height, PCType width, PCType block_size, PCType block_step)
+{
+    const std::vector<PCType> rows = BlockScanLine(height, block_size, block_step);
+    const std::vector<PCType> cols = BlockScanLine(width, block_size, block_step);
+
+    std::vector<std::vector<Pos>> refPos(rows.size());
+
+    for (size_t r = 0; r < rows.size(); ++r)
+    {
+        refPos[r].reserve(cols.size());
+
+        for (auto i : cols)
+        {
+            refPos[r].push_back(Pos(rows[r], i));
+        }
+    }
+
+    return refPos;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Exhaustive block matching of a row of reference blocks with incremental sliding-window SSD
+// For each displacement in the search window, the squared differences are summed vertically into column sums,
+// which are updated incrementally from the previous row of reference blocks,
+// and then summed horizontally by a sliding window to get the SSD of every reference block in the row.
+// Thus the cost per candidate is about min(2 * BlockStep, BlockSize) * BlockStep instead of BlockSize * BlockSize,
+// which benefits dense reference block scan (BlockStep smaller than BlockSize) the most.
+// The candidates and their order are the same as Block::BlockMatchingMulti,
+// only the rounding of distances differs due to the incremental summation.
+template < typename _Ty = FLType, typename _DTy = FLType >
+class BlockMatching_Sliding
+{
+public:
+    typedef BlockMatching_Sliding<_Ty, _DTy> _Myt;
+    typedef Block<_Ty, _DTy> block_type;
+
+    typedef typename block_type::dist_type dist_type;
+    typedef typename block_type::KeyType KeyType;
+    typedef typename block_type::PosType PosType;
+    typedef typename block_type::PosPair PosPair;
+    typedef typename block_type::PosCode PosCode;
+    typedef typename block_type::PosPairCode PosPairCode;
+
+private:
+    PCType BlockHeight_;
+    PCType BlockWidth_;
+    double thMSE_;
+    int excludeCurPos_;
+    size_t match_size_;
+    bool sorted_;
+
+    PCType width_ = 0;
+    PosCode disp_;
+    std::vector<dist_type> colSum_;
+    std::vector<PCType> colPos_;
+    std::vector<dist_type> boxSum_;
+
+public:
+    // excludeCurPos and match_size are the same as Block::BlockMatchingMulti
+    BlockMatching_Sliding(PCType block_height, PCType block_width, PCType range, PCType step, double thMSE,
+        int excludeCurPos = 1, size_t match_size = 0, bool sorted = true)
+        : BlockHeight_(block_height), BlockWidth_(block_width), thMSE_(thMSE),
+        excludeCurPos_(excludeCurPos), match_size_(match_size), sorted_(sorted)
+    {
+        range = range / step * step;
+
+        // Displacements in the same order as the search positions of Block::BlockMatchingMulti
+        for (PCType dy = -range; dy <= range; dy += step)
+        {
+            for (PCType dx = -range; dx <= range; dx += step)
+            {
+                if (excludeCurPos_ > 0 && dy == 0 && dx == 0)
+                {
+                    continue;
+                }
+
+                disp_.push_back(PosType(dy, dx));
+            }
+        }
+    }
+
+    // Invalidate the column sums, the next row will compute them from scratch
+    void Reset()
+    {
+        colPos_.assign(disp_.size(), -1);
+    }
+
+    // Match all the reference blocks in a row, rowPos should share the same y and be in ascending x
+    // codes[k] is the match code of rowPos[k]
+    template < typename _St1 >
+    void operator()(std::vector<PosPairCode> &codes, const _St1 &src, const PosCode &rowPos)
+    {
+        const PCType height = src.Height();
+        const PCType width = src.Width();
+        const PCType stride = src.Stride();
+        const auto srcp = src.data();
+
+        const PCType blockCount = static_cast<PCType>(rowPos.size());
+        const PCType dispCount = static_cast<PCType>(disp_.size());
+
+        if (width_ != width)
+        {
+            width_ = width;
+            colSum_.assign(dispCount * width, 0);
+            boxSum_.assign(width, 0);
+            Reset();
+        }
+
+        codes.resize(blockCount);
+
+        for (PCType k = 0; k < blockCount; ++k)
+        {
+            codes[k].clear();
+            if (excludeCurPos_ == 1) codes[k].push_back(PosPair(static_cast<KeyType>(0), rowPos[k]));
+        }
+
+        if (blockCount == 0)
+        {
+            return;
+        }
+
+        const PCType j = rowPos[0].y;
+
+        double MSE2SSE = static_cast<double>(BlockHeight_ * BlockWidth_) * src.ValueRange() * src.ValueRange() / double(255 * 255);
+        double distMul = double(1) / MSE2SSE;
+        dist_type thSSE = static_cast<dist_type>(thMSE_ * MSE2SSE);
+
+        // The incremental summation leaves rounding residue, thus distances close to 0 are re-computed directly,
+        // to keep excluding identical blocks
+        dist_type zeroSSE = static_cast<dist_type>(MSE2SSE * (255 * 255) * std::numeric_limits<dist_type>::epsilon() * 1024);
+
+        // Squared differences of row y between the reference and the displaced candidate
+        // mode 0: colp = diff(y), mode 1: colp += diff(y), mode 2: colp += diff(y) - diff(y - BlockHeight)
+        auto sumRow = [&](dist_type *colp, PCType y, const PosType &d, PCType xl, PCType xr, int mode)
+        {
+            auto p0 = srcp + y * stride;
+            auto p1 = srcp + (y + d.y) * stride + d.x;
+
+            if (mode == 0)
+            {
+                for (PCType x = xl; x < xr; ++x)
+                {
+                    dist_type temp = static_cast<dist_type>(p0[x]) - static_cast<dist_type>(p1[x]);
+                    colp[x] = temp * temp;
+                }
+            }
+            else if (mode == 1)
+            {
+                for (PCType x = xl; x < xr; ++x)
+                {
+                    dist_type temp = static_cast<dist_type>(p0[x]) - static_cast<dist_type>(p1[x]);
+                    colp[x] += temp * temp;
+                }
+            }
+            else
+            {
+                auto q0 = p0 - BlockHeight_ * stride;
+                auto q1 = p1 - BlockHeight_ * stride;
+
+                for (PCType x = xl; x < xr; ++x)
+                {
+                    dist_type temp0 = static_cast<dist_type>(p0[x]) - static_cast<dist_type>(p1[x]);
+                    dist_type temp1 = static_cast<dist_type>(q0[x]) - static_cast<dist_type>(q1[x]);
+                    colp[x] += temp0 * temp0 - temp1 * temp1;
+                }
+            }
+        };
+
+        auto directSSD = [&](PCType i, const PosType &d)
+        {
+            auto p0 = srcp + j * stride + i;
+            auto p1 = srcp + (j + d.y) * stride + i + d.x;
+            dist_type dist = 0;
+
+            for (PCType y = 0; y < BlockHeight_; ++y, p0 += stride, p1 += stride)
+            {
+                for (PCType x = 0; x < BlockWidth_; ++x)
+                {
+                    dist_type temp = static_cast<dist_type>(p0[x]) - static_cast<dist_type>(p1[x]);
+                    dist += temp * temp;
+                }
+            }
+
+            return dist;
+        };
+
+        for (PCType n = 0; n < dispCount; ++n)
+        {
+            const PosType &d = disp_[n];
+
+            // Skip the displacement if the candidate row is out of the plane
+            if (j + d.y < 0 || j + d.y > height - BlockHeight_)
+            {
+                continue;
+            }
+
+            // Columns where both the reference and the candidate pixels are inside the plane
+            const PCType xl = Max(PCType(0), -d.x);
+            const PCType xr = Min(width, width - d.x);
+
+            if (xr - xl < BlockWidth_)
+            {
+                continue;
+            }
+
+            dist_type *colp = colSum_.data() + n * width;
+            PCType &prevY = colPos_[n];
+
+            // Update column sums from the previous row, or compute them from scratch when it's cheaper
+            if (prevY < 0 || j <= prevY || (j - prevY) * 2 >= BlockHeight_)
+            {
+                sumRow(colp, j, d, xl, xr, 0);
+
+                for (PCType y = j + 1; y < j + BlockHeight_; ++y)
+                {
+                    sumRow(colp, y, d, xl, xr, 1);
+                }
+            }
+            else
+            {
+                for (PCType y = prevY + BlockHeight_; y < j + BlockHeight_; ++y)
+                {
+                    sumRow(colp, y, d, xl, xr, 2);
+                }
+            }
+
+            prevY = j;
+
+            // Horizontal sliding sum of column sums
+            const PCType xu = xr - BlockWidth_;
+            dist_type sum = 0;
+
+            for (PCType x = xl; x < xl + BlockWidth_; ++x)
+            {
+                sum += colp[x];
+            }
+
+            boxSum_[xl] = sum;
+
+            for (PCType x = xl + 1; x <= xu; ++x)
+            {
+                sum += colp[x + BlockWidth_ - 1] - colp[x - 1];
+                boxSum_[x] = sum;
+            }
+
+            // Collect the matched blocks
+            for (PCType k = 0; k < blockCount; ++k)
+            {
+                const PCType i = rowPos[k].x;
+
+                if (i < xl || i > xu)
+                {
+                    continue;
+                }
+
+                dist_type dist = boxSum_[i];
+
+                if (dist <= zeroSSE)
+                {
+                    dist = directSSD(i, d);
+                }
+
+                // Only match similar blocks but not identical blocks
+                if (dist <= thSSE && dist != 0)
+                {
+                    codes[k].push_back(PosPair(static_cast<KeyType>(dist * distMul), PosType(j + d.y, i + d.x)));
+                }
+            }
+        }
+
+        for (auto &code : codes)
+        {
+            // When match_size > 0, it's the upper limit of the number of matched blocks
+            if (match_size_ > 0 && code.size() > match_size_)
+            {
+                // Always sorted when size of match code is larger than match_size,
+                // since std::partial_sort is faster than std::nth_element
+                std::partial_sort(code.begin(), code.begin() + match_size_, code.end());
+                code.resize(match_size_);
+            }
+            else if (sorted_)
+            {
+                std::stable_sort(code.begin(), code.end());
+            }
+        }
+    }
+};
+
+
+// Predictive block matching of a row of reference blocks (PS-BM)
+// Instead of the whole search window, only small windows of pred_range steps around the predicted positions are searched.
+// The predicted positions are the current position and the best pred_num matches of the left and the top neighbours,
+// each shifted by the offset from the neighbour to the current reference block,
+// since similar blocks of adjacent reference blocks tend to be adjacent as well.
+// The candidates are clipped to the full search window, and searched in the same order as Block::BlockMatchingMulti.
+// A full search is done for the first reference block, and for every full_interval-th reference block
+// of every full_interval-th row when full_interval > 0, to refresh the predictions.
+// Such rows don't take predictions from the previous row either, thus each band of full_interval rows can be matched
+// independently of the others.
+template < typename _Ty = FLType, typename _DTy = FLType >
+class BlockMatching_Predictive
+{
+public:
+    typedef BlockMatching_Predictive<_Ty, _DTy> _Myt;
+    typedef Block<_Ty, _DTy> block_type;
+
+    typedef typename block_type::KeyType KeyType;
+    typedef typename block_type::PosType PosType;
+    typedef typename block_type::PosPair PosPair;
+    typedef typename block_type::PosCode PosCode;
+    typedef typename block_type::PosPairCode PosPairCode;
+
+private:
+    PCType BlockHeight_;
+    PCType BlockWidth_;
+    PCType range_;
+    PCType step_;
+    double thMSE_;
+    PCType pred_range_;
+    PCType pred_num_;
+    PCType full_interval_;
+    int excludeCurPos_;
+    size_t match_size_;
+    bool sorted_;
+
+    std::vector<uint8> mask_;
+    PosCode search_pos_;
+
+public:
+    // excludeCurPos and match_size are the same as Block::BlockMatchingMulti
+    BlockMatching_Predictive(PCType block_height, PCType block_width, PCType range, PCType step, double thMSE,
+        PCType pred_range, PCType pred_num, PCType full_interval,
+        int excludeCurPos = 1, size_t match_size = 0, bool sorted = true)
+        : BlockHeight_(block_height), BlockWidth_(block_width), range_(range / step * step), step_(step), thMSE_(thMSE),
+        pred_range_(pred_range), pred_num_(pred_num), full_interval_(full_interval),
+        excludeCurPos_(excludeCurPos), match_size_(match_size), sorted_(sorted)
+    {
+        const PCType side = range_ / step_ * 2 + 1;
+        mask_.resize(side * side);
+    }
+
+    // Match all the reference blocks in a row, rowPos should share the same y and be in ascending x
+    // prevCodes holds the match codes of the previous row of reference blocks prevPos, which are empty for the first row,
+    // row is the index of this row in the scan. codes[k] is the match code of rowPos[k]
+    template < typename _St1 >
+    void operator()(std::vector<PosPairCode> &codes, const _St1 &src, const PosCode &rowPos,
+        const PosCode &prevPos, const std::vector<PosPairCode> &prevCodes, PCType row)
+    {
+        const PCType blockCount = static_cast<PCType>(rowPos.size());
+
+        codes.resize(blockCount);
+
+        for (PCType k = 0; k < blockCount; ++k)
+        {
+            block_type refBlock(src, BlockHeight_, BlockWidth_, rowPos[k]);
+
+            const bool hasLeft = k > 0;
+            const bool refresh = full_interval_ > 0 && row % full_interval_ == 0;
+            const bool hasTop = !refresh && k < static_cast<PCType>(Min(prevPos.size(), prevCodes.size()));
+            const bool full = (!hasLeft && !hasTop) || (refresh && k % full_interval_ == 0);
+
+            if (full)
+            {
+                codes[k] = refBlock.BlockMatchingMulti(src, range_, step_, thMSE_, excludeCurPos_, match_size_, sorted_);
+                continue;
+            }
+
+            // Search window on the grid of step
+            const PCType l = refBlock.SearchBoundary(PCType(0), range_, step_, false);
+            const PCType r = refBlock.SearchBoundary(src.Width() - BlockWidth_, range_, step_, false);
+            const PCType t = refBlock.SearchBoundary(PCType(0), range_, step_, true);
+            const PCType b = refBlock.SearchBoundary(src.Height() - BlockHeight_, range_, step_, true);
+            const PCType cols = (r - l) / step_ + 1;
+            const PCType rows = (b - t) / step_ + 1;
+
+            std::fill(mask_.begin(), mask_.begin() + rows * cols, uint8(0));
+
+            // Mark the small window around the predicted position, snapped to the grid
+            auto predict = [&](PosType pos)
+            {
+                const PCType cy = Clip((pos.y - t + step_ / 2) / step_, PCType(0), rows - 1);
+                const PCType cx = Clip((pos.x - l + step_ / 2) / step_, PCType(0), cols - 1);
+                const PCType yl = Max(PCType(0), cy - pred_range_);
+                const PCType yu = Min(rows - 1, cy + pred_range_);
+                const PCType xl = Max(PCType(0), cx - pred_range_);
+                const PCType xu = Min(cols - 1, cx + pred_range_);
+
+                for (PCType y = yl; y <= yu; ++y)
+                {
+                    std::fill(mask_.begin() + y * cols + xl, mask_.begin() + y * cols + xu + 1, uint8(1));
+                }
+            };
+
+            auto predictFrom = [&](const PosPairCode &code, PosType pos)
+            {
+                const PCType dy = rowPos[k].y - pos.y;
+                const PCType dx = rowPos[k].x - pos.x;
+                const PCType count = Min(pred_num_, static_cast<PCType>(code.size()));
+
+                for (PCType n = 0; n < count; ++n)
+                {
+                    predict(PosType(code[n].second.y + dy, code[n].second.x + dx));
+                }
+            };
+
+            predict(rowPos[k]);
+            if (hasLeft) predictFrom(codes[k - 1], rowPos[k - 1]);
+            if (hasTop) predictFrom(prevCodes[k], prevPos[k]);
+
+            search_pos_.clear();
+
+            for (PCType y = 0; y < rows; ++y)
+            {
+                for (PCType x = 0; x < cols; ++x)
+                {
+                    const PosType pos(t + y * step_, l + x * step_);
+
+                    if (mask_[y * cols + x] == 0 || (excludeCurPos_ > 0 && pos.y == rowPos[k].y && pos.x == rowPos[k].x))
+                    {
+                        continue;
+                    }
+
+                    search_pos_.push_back(pos);
+                }
+            }
+
+            PosPairCode &code = codes[k];
+            code.clear();
+            if (excludeCurPos_ == 1) code.push_back(PosPair(static_cast<KeyType>(0), rowPos[k]));
+
+            // When match_size > 0, it's the upper limit of the number of matched blocks
+            if (match_size_ > 0)
+            {
+                refBlock.BlockMatchingTopK(code, src, search_pos_, thMSE_, match_size_, sorted_);
+            }
+            else
+            {
+                refBlock.BlockMatchingMulti(code, src, search_pos_, thMSE_);
+                if (sorted_) std::stable_sort(code.begin(), code.end());
+            }
+        }
+    }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef BUFFER_POOL_H_
+#define BUFFER_POOL_H_
+
+
+#include <mutex>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "Type.h"
+#include "Helper.h"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Thread-safe pool of aligned memory blocks, used for the pixel buffers of Plane and Plane_FL
+// Requests are rounded up to size buckets, and released blocks are kept idle for later requests of the same bucket,
+// thus processing a sequence of frames of the same size doesn't allocate any memory after the first frame.
+// The total size of the idle blocks is limited by Capacity(), a released block exceeding it is freed immediately.
+class BufferPool
+{
+public:
+    typedef BufferPool _Myt;
+
+    static const size_t DefaultCapacity = size_t(1) << 30;
+
+    struct Stats
+    {
+        size_t acquires = 0; // Number of requests
+        size_t hits = 0; // Requests served by idle blocks
+        size_t misses = 0; // Requests served by new allocations
+        size_t drops = 0; // Released blocks freed since the idle blocks reach the capacity
+        size_t used_bytes = 0; // Size of the blocks in use
+        size_t retained_bytes = 0; // Size of the idle blocks
+        size_t peak_bytes = 0; // Peak of used_bytes + retained_bytes
+    };
+
+private:
+    mutable std::mutex mutex_;
+    size_t capacity_;
+    std::map<size_t, std::vector<void *>> idle_;
+    std::unordered_map<void *, size_t> used_;
+    Stats stats_;
+
+    void TrimLocked(size_t retained);
+
+public:
+    explicit BufferPool(size_t _Capacity = DefaultCapacity)
+        : capacity_(_Capacity)
+    {}
+
+    BufferPool(const _Myt &src) = delete;
+    _Myt &operator=(const _Myt &src) = delete;
+
+    ~BufferPool();
+
+    // Return a block of at least bytes, aligned to MEMORY_ALIGNMENT
+    void *Acquire(size_t bytes);
+
+    // Return a block from Acquire() to the pool, nullptr is ignored
+    void Release(void *memory);
+
+    size_t Capacity() const;
+
+    // Set the limit of the idle blocks, 0 to free every block on release, the exceeding idle blocks are freed
+    void SetCapacity(size_t _Capacity);
+
+    // Free the idle blocks until their total size is not larger than retained
+    void Trim(size_t retained = 0);
+
+    Stats GetStats() const;
+    void ResetStats();
+
+    // Size of the bucket serving a request of bytes, the waste is less than 1/8 for large requests
+    static size_t BucketSize(size_t bytes);
+
+    // Process-wide pool shared by all the planes, it's never destroyed to outlive static planes
+    static _Myt &Default();
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#endif
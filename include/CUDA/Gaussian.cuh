@@ -34,10 +34,16 @@ public:
     typedef Gaussian2D_IO _Mybase;
 
 protected:
+    std::unique_ptr<CUDA_Gaussian2D> cuda_filter;
+
+    virtual void prepare()
+    {
+        cuda_filter.reset(new CUDA_Gaussian2D(para));
+    }
+
     virtual Frame process(const Frame &src)
     {
-        CUDA_Gaussian2D filter(para);
-        return filter(src);
+        return (*cuda_filter)(src);
     }
 
 public:
@@ -82,16 +82,22 @@ public:
     typedef Haze_Removal_Retinex_IO _Mybase;
 
 protected:
+    std::unique_ptr<CUDA_Haze_Removal_Retinex> cuda_filter;
+
     virtual void arguments_process()
     {
         para = CUDA_Haze_Removal_Default;
         _Mybase::arguments_process();
     }
 
+    virtual void prepare()
+    {
+        cuda_filter.reset(new CUDA_Haze_Removal_Retinex(para));
+    }
+
     virtual Frame process(const Frame &src)
     {
-        CUDA_Haze_Removal_Retinex filter(para);
-        return filter(src);
+        return (*cuda_filter)(src);
     }
 
 public:
@@ -81,6 +81,53 @@ void GetMinMax(const _St1 &srcR, const _St1 &srcG, const _St1 &srcB, typename _S
 }
 
 
+// Mean squared error between 2 images of the same size, in the scale of their value range
+template < typename _St1, typename _St2 >
+double GetMSE(const _St1 &src1, const _St2 &src2)
+{
+    double sum = 0;
+
+    LOOP_VH(src1.Height(), src1.Width(), src1.Stride(), src2.Stride(), [&](PCType i0, PCType i1)
+    {
+        double diff = static_cast<double>(src1[i0]) - static_cast<double>(src2[i1]);
+        sum += diff * diff;
+    });
+
+    return sum / (static_cast<double>(src1.Height()) * src1.Width());
+}
+
+inline double GetMSE(const Frame &src1, const Frame &src2)
+{
+    double sum = 0;
+
+    for (Frame::PlaneCountType i = 0; i < src1.PlaneCount(); i++)
+    {
+        sum += GetMSE(src1.P(i), src2.P(i));
+    }
+
+    return sum / src1.PlaneCount();
+}
+
+
+// Peak signal-to-noise ratio in dB, the peak is the value range of src1, infinity for identical images
+template < typename _St1, typename _St2 >
+double GetPSNR(const _St1 &src1, const _St2 &src2)
+{
+    double MSE = GetMSE(src1, src2);
+    double peak = static_cast<double>(src1.ValueRange());
+
+    return MSE > 0 ? 10 * log10(peak * peak / MSE) : std::numeric_limits<double>::infinity();
+}
+
+inline double GetPSNR(const Frame &src1, const Frame &src2)
+{
+    double MSE = GetMSE(src1, src2);
+    double peak = static_cast<double>(src1.P(0).ValueRange());
+
+    return MSE > 0 ? 10 * log10(peak * peak / MSE) : std::numeric_limits<double>::infinity();
+}
+
+
 template < typename _St1 >
 void ValidRange(const _St1 &src, typename _St1::reference min, typename _St1::reference max,
     double lower_thr = 0., double upper_thr = 0., int HistBins = 1024, bool protect = false)
@@ -195,7 +242,7 @@ void RangeConvert(_Dt1 *dst, const _St1 *src,
 
                 LOOP_VH_PPL(height, width, dst_stride, src_stride, [&](PCType i0, PCType i1)
                 {
-                    dst[i0] = static_cast<dstType>(Clip(src[i1] + offset, lowerL, upperL));
+                    dst[i0] = static_cast<dstType>(Clip(static_cast<srcType>(src[i1] + offset), lowerL, upperL));
                 });
             }
             else
@@ -843,11 +890,10 @@ void MatrixConvert(_Dt1 &dst, const _St1 &src, ColorMatrix _ColorMatrix = ColorM
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-template < typename _Dt1 >
-void TransferConvert(_Dt1 &dst, const Plane &src, TransferChar dstTransferChar, TransferChar srcTransferChar)
+template < typename _Dt1, typename _St1 >
+void TransferConvert(_Dt1 &dst, const Plane_Int<_St1> &src, TransferChar dstTransferChar, TransferChar srcTransferChar)
 {
-    typedef Plane _St1;
-    typedef typename _St1::value_type srcType;
+    typedef _St1 srcType;
     typedef typename _Dt1::value_type dstType;
 
     const bool dstFloat = isFloat(dstType);
@@ -997,11 +1043,10 @@ void TransferConvert(_Dt1 &dst, const _St1 &src)
     TransferConvert(dst, src, dst.GetTransferChar(), src.GetTransferChar());
 }
 
-template < typename _Dt1 >
-void TransferConvert(_Dt1 &dstR, _Dt1 &dstG, _Dt1 &dstB, const Plane &srcR, const Plane &srcG, const Plane &srcB, TransferChar dstTransferChar, TransferChar srcTransferChar)
+template < typename _Dt1, typename _St1 >
+void TransferConvert(_Dt1 &dstR, _Dt1 &dstG, _Dt1 &dstB, const Plane_Int<_St1> &srcR, const Plane_Int<_St1> &srcG, const Plane_Int<_St1> &srcB, TransferChar dstTransferChar, TransferChar srcTransferChar)
 {
-    typedef Plane _St1;
-    typedef typename _St1::value_type srcType;
+    typedef _St1 srcType;
     typedef typename _Dt1::value_type dstType;
 
     const bool dstFloat = isFloat(dstType);
@@ -1115,26 +1160,27 @@ void TransferConvert(_Dt1 &dstR, _Dt1 &dstG, _Dt1 &dstB, const Plane_FL &srcR, c
 
     const PCType height = dstR.Height();
     const PCType width = dstR.Width();
-    const PCType stride = dstR.Stride();
+    const PCType dst_stride = dstR.Stride();
+    const PCType src_stride = srcR.Stride();
 
     if (srcR.Floor() == 0 && srcR.ValueRange() == 1)
     {
         if (dstFloat && dstR.Floor() == 0 && dstR.ValueRange() == 1)
         {
-            LOOP_VH_PPL(height, width, stride, [&](PCType i)
+            LOOP_VH_PPL(height, width, dst_stride, src_stride, [&](PCType i0, PCType i1)
             {
-                dstR[i] = static_cast<dstType>(ConvFilter(static_cast<FLType>(srcR[i])));
-                dstG[i] = static_cast<dstType>(ConvFilter(static_cast<FLType>(srcG[i])));
-                dstB[i] = static_cast<dstType>(ConvFilter(static_cast<FLType>(srcB[i])));
+                dstR[i0] = static_cast<dstType>(ConvFilter(static_cast<FLType>(srcR[i1])));
+                dstG[i0] = static_cast<dstType>(ConvFilter(static_cast<FLType>(srcG[i1])));
+                dstB[i0] = static_cast<dstType>(ConvFilter(static_cast<FLType>(srcB[i1])));
             });
         }
         else
         {
-            LOOP_VH_PPL(height, width, stride, [&](PCType i)
+            LOOP_VH_PPL(height, width, dst_stride, src_stride, [&](PCType i0, PCType i1)
             {
-                dstR[i] = FloatTo(ConvFilter(static_cast<FLType>(srcR[i])));
-                dstG[i] = FloatTo(ConvFilter(static_cast<FLType>(srcG[i])));
-                dstB[i] = FloatTo(ConvFilter(static_cast<FLType>(srcB[i])));
+                dstR[i0] = FloatTo(ConvFilter(static_cast<FLType>(srcR[i1])));
+                dstG[i0] = FloatTo(ConvFilter(static_cast<FLType>(srcG[i1])));
+                dstB[i0] = FloatTo(ConvFilter(static_cast<FLType>(srcB[i1])));
             });
         }
     }
@@ -1142,20 +1188,20 @@ void TransferConvert(_Dt1 &dstR, _Dt1 &dstG, _Dt1 &dstB, const Plane_FL &srcR, c
     {
         if (dstFloat && dstR.Floor() == 0 && dstR.ValueRange() == 1)
         {
-            LOOP_VH_PPL(height, width, stride, [&](PCType i)
+            LOOP_VH_PPL(height, width, dst_stride, src_stride, [&](PCType i0, PCType i1)
             {
-                dstR[i] = static_cast<dstType>(ConvFilter(ToFloat(srcR[i])));
-                dstG[i] = static_cast<dstType>(ConvFilter(ToFloat(srcG[i])));
-                dstB[i] = static_cast<dstType>(ConvFilter(ToFloat(srcB[i])));
+                dstR[i0] = static_cast<dstType>(ConvFilter(ToFloat(srcR[i1])));
+                dstG[i0] = static_cast<dstType>(ConvFilter(ToFloat(srcG[i1])));
+                dstB[i0] = static_cast<dstType>(ConvFilter(ToFloat(srcB[i1])));
             });
         }
         else
         {
-            LOOP_VH_PPL(height, width, stride, [&](PCType i)
+            LOOP_VH_PPL(height, width, dst_stride, src_stride, [&](PCType i0, PCType i1)
             {
-                dstR[i] = FloatTo(ConvFilter(ToFloat(srcR[i])));
-                dstG[i] = FloatTo(ConvFilter(ToFloat(srcG[i])));
-                dstB[i] = FloatTo(ConvFilter(ToFloat(srcB[i])));
+                dstR[i0] = FloatTo(ConvFilter(ToFloat(srcR[i1])));
+                dstG[i0] = FloatTo(ConvFilter(ToFloat(srcG[i1])));
+                dstB[i0] = FloatTo(ConvFilter(ToFloat(srcB[i1])));
             });
         }
     }
@@ -22,34 +22,38 @@ const struct EdgeDetect_Para
 } ED_Default;
 
 
-Plane & Convolution3V(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, bool norm = true);
-Plane & Convolution3H(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, bool norm = true);
-Plane & Convolution3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm = true);
-Plane & FirstOrderDerivative3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, FLType K6, FLType K7, FLType K8, bool norm = true);
-Plane & EdgeDetect(Plane &dst, const Plane &src, EdgeKernel Kernel = ED_Default.Kernel);
+template < typename _Ty > Plane_Int<_Ty> & Convolution3V(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm = true);
+template < typename _Ty > Plane_Int<_Ty> & Convolution3H(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm = true);
+template < typename _Ty > Plane_Int<_Ty> & Convolution3(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm = true);
+template < typename _Ty > Plane_Int<_Ty> & FirstOrderDerivative3(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K6, FLType K7, FLType K8, bool norm = true);
+template < typename _Ty > Plane_Int<_Ty> & EdgeDetect(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, EdgeKernel Kernel = ED_Default.Kernel);
 
 
-inline Plane Convolution3V(const Plane &src, FLType K0, FLType K1, FLType K2, bool norm = true)
+template < typename _Ty > inline
+Plane_Int<_Ty> Convolution3V(const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm = true)
 {
-    Plane dst(src, false);
+    Plane_Int<_Ty> dst(src, false);
     return Convolution3V(dst, src, K0, K1, K2, norm);
 }
 
-inline Plane Convolution3H(const Plane &src, FLType K0, FLType K1, FLType K2, bool norm = true)
+template < typename _Ty > inline
+Plane_Int<_Ty> Convolution3H(const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm = true)
 {
-    Plane dst(src, false);
+    Plane_Int<_Ty> dst(src, false);
     return Convolution3H(dst, src, K0, K1, K2, norm);
 }
 
-inline Plane Convolution3(const Plane &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm = true)
+template < typename _Ty > inline
+Plane_Int<_Ty> Convolution3(const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm = true)
 {
-    Plane dst(src, false);
+    Plane_Int<_Ty> dst(src, false);
     return Convolution3(dst, src, K0, K1, K2, K3, K4, K5, K6, K7, K8, norm);
 }
 
-inline Plane EdgeDetect(const Plane &src, EdgeKernel Kernel = ED_Default.Kernel)
+template < typename _Ty > inline
+Plane_Int<_Ty> EdgeDetect(const Plane_Int<_Ty> &src, EdgeKernel Kernel = ED_Default.Kernel)
 {
-    Plane dst(src, false);
+    Plane_Int<_Ty> dst(src, false);
     return EdgeDetect(dst, src, Kernel);
 }
 
@@ -3,8 +3,13 @@
 
 
 #include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <io.h>
 #include "Args.h"
 #include "ImageIO.h"
+#include "Thread_Pool.h"
 
 
 template < typename _Ty = FLType >
@@ -126,10 +131,22 @@ public:
         return process_Frame(dst, src);
     }
 
-    template < typename _St1 >
-    _St1 operator()(const _St1 &src)
+    // The result owns its memory, views are accepted through the base class
+    Plane_FL operator()(const Plane_FL &src)
+    {
+        Plane_FL dst(src, false);
+        return process(dst, src);
+    }
+
+    Plane operator()(const Plane &src)
+    {
+        Plane dst(src, false);
+        return process(dst, src);
+    }
+
+    Frame operator()(const Frame &src)
     {
-        _St1 dst(src, false);
+        Frame dst(src, false);
         return process(dst, src);
     }
 };
@@ -186,10 +203,22 @@ public:
         return process_Frame(dst, src, ref);
     }
 
-    template < typename _St1 >
-    _St1 operator()(const _St1 &src, const _St1 &ref)
+    // The result owns its memory, views are accepted through the base class
+    Plane_FL operator()(const Plane_FL &src, const Plane_FL &ref)
+    {
+        Plane_FL dst(src, false);
+        return process(dst, src, ref);
+    }
+
+    Plane operator()(const Plane &src, const Plane &ref)
+    {
+        Plane dst(src, false);
+        return process(dst, src, ref);
+    }
+
+    Frame operator()(const Frame &src, const Frame &ref)
     {
-        _St1 dst(src, false);
+        Frame dst(src, false);
         return process(dst, src, ref);
     }
 
@@ -208,10 +237,22 @@ public:
         return process_Frame(dst, src, src);
     }
 
-    template < typename _St1 >
-    _St1 operator()(const _St1 &src)
+    // The result owns its memory, views are accepted through the base class
+    Plane_FL operator()(const Plane_FL &src)
+    {
+        Plane_FL dst(src, false);
+        return process(dst, src);
+    }
+
+    Plane operator()(const Plane &src)
+    {
+        Plane dst(src, false);
+        return process(dst, src);
+    }
+
+    Frame operator()(const Frame &src)
     {
-        _St1 dst(src, false);
+        Frame dst(src, false);
         return process(dst, src);
     }
 };
@@ -227,29 +268,166 @@ private:
     static const int PATHLEN = 256;
     static const int EXTLEN = 64;
 
-    std::string IPath;
-    std::string OPath;
+    std::vector<std::string> IPaths;
     std::string Tag;
     std::string Format = ".png";
+    std::string ListPath;
+    int QueueSize = 2;
 
-    void generate_OPath()
+    std::string generate_OPath(const std::string &IPath) const
     {
         char Drive[DRIVELEN];
         char Dir[PATHLEN];
         char FileName[PATHLEN];
         char Ext[EXTLEN];
 
-        _splitpath_s(IPath.c_str(), Drive, PATHLEN, Dir, PATHLEN, FileName, PATHLEN, Ext, PATHLEN);
-        OPath = std::string(Drive) + std::string(Dir) + std::string(FileName) + Tag + Format;
+        _splitpath_s(IPath.c_str(), Drive, DRIVELEN, Dir, PATHLEN, FileName, PATHLEN, Ext, EXTLEN);
+        return std::string(Drive) + std::string(Dir) + std::string(FileName) + Tag + Format;
     }
 
-    void processIO()
+    static bool is_image_file(const std::string &filename)
+    {
+        static const char *const exts[] = { ".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".ppm", ".webp", ".jp2" };
+
+        std::string ext;
+        size_t dot = filename.find_last_of('.');
+        if (dot == std::string::npos) return false;
+
+        ext = filename.substr(dot);
+        std::transform(ext.begin(), ext.end(), ext.begin(), tolower);
+
+        for (auto e : exts)
+        {
+            if (ext == e) return true;
+        }
+
+        return false;
+    }
+
+    // Add the input path, a directory is expanded to the image files inside it (not recursive)
+    // Files produced by this filter (ending with Tag + Format) are skipped when expanding directories
+    void add_IPath(const std::string &path)
+    {
+        _finddata_t info;
+        intptr_t handle = _findfirst(path.c_str(), &info);
+
+        if (handle == -1 || !(info.attrib & _A_SUBDIR))
+        {
+            if (handle != -1) _findclose(handle);
+            IPaths.push_back(path);
+            return;
+        }
+
+        _findclose(handle);
+
+        std::string dir = path;
+        if (dir.back() != '\\' && dir.back() != '/') dir += '\\';
+
+        std::vector<std::string> files;
+        const std::string suffix = Tag + Format;
+        handle = _findfirst((dir + "*").c_str(), &info);
+
+        if (handle != -1)
+        {
+            do
+            {
+                std::string name = info.name;
+
+                if (!(info.attrib & _A_SUBDIR) && is_image_file(name) && (name.size() < suffix.size()
+                    || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0))
+                {
+                    files.push_back(dir + name);
+                }
+            } while (_findnext(handle, &info) == 0);
+
+            _findclose(handle);
+        }
+
+        std::sort(files.begin(), files.end());
+        IPaths.insert(IPaths.end(), files.begin(), files.end());
+    }
+
+    // Each line of the list file is an input path, empty lines are ignored
+    void add_ListPath(const std::string &path)
+    {
+        std::ifstream list(path);
+
+        if (!list)
+        {
+            std::cerr << "FilterIO: Could not open the list file: " << path << std::endl;
+            return;
+        }
+
+        std::string line;
+
+        while (std::getline(list, line))
+        {
+            while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) line.pop_back();
+            if (!line.empty()) add_IPath(line);
+        }
+    }
+
+    void processIO(const std::string &IPath, const std::string &OPath)
     {
         const Frame src = ImageReader(IPath);
         Frame dst = process(src);
+        if (Delay() > 0) dst = flush();
         ImageWriter(dst, OPath);
     }
 
+    // Decode, filter and encode run on 3 threads connected by bounded queues,
+    // thus different files overlap in different stages while the memory usage is limited by QueueSize.
+    // The filter itself is only called from the current thread, one image at a time.
+    // The outputs of a filter with Delay() > 0 are matched to the inputs Delay() images earlier.
+    void processBatch()
+    {
+        typedef std::pair<size_t, Frame> item_type;
+
+        BoundedQueue<item_type> decoded(QueueSize);
+        BoundedQueue<item_type> filtered(QueueSize);
+
+        std::thread reader([&]()
+        {
+            for (size_t n = 0; n < IPaths.size(); ++n)
+            {
+                if (!decoded.push(item_type(n, ImageReader(IPaths[n])))) break;
+            }
+
+            decoded.close();
+        });
+
+        std::thread writer([&]()
+        {
+            item_type item;
+
+            while (filtered.pop(item))
+            {
+                ImageWriter(item.second, generate_OPath(IPaths[item.first]));
+            }
+        });
+
+        const size_t delay = static_cast<size_t>(Delay());
+        size_t count = 0;
+        item_type item;
+
+        while (decoded.pop(item))
+        {
+            std::cout << "[" << item.first + 1 << "/" << IPaths.size() << "] " << IPaths[item.first] << std::endl;
+            Frame dst = process(item.second);
+            if (++count > delay) filtered.push(item_type(count - 1 - delay, std::move(dst)));
+        }
+
+        for (size_t n = count > delay ? count - delay : 0; n < count; ++n)
+        {
+            filtered.push(item_type(n, flush()));
+        }
+
+        filtered.close();
+
+        reader.join();
+        writer.join();
+    }
+
 protected:
     int argc = 0;
     std::vector<std::string> args;
@@ -258,6 +436,8 @@ protected:
     {
         Args ArgsObj(argc, args);
 
+        IPaths.clear();
+
         for (int i = 0; i < argc; i++)
         {
             if (args[i] == "-T" || args[i] == "--tag")
@@ -270,20 +450,55 @@ protected:
                 ArgsObj.GetPara(i, Format);
                 continue;
             }
+            if (args[i] == "-L" || args[i] == "--list")
+            {
+                ArgsObj.GetPara(i, ListPath);
+                continue;
+            }
+            if (args[i] == "-Q" || args[i] == "--queue")
+            {
+                ArgsObj.GetPara(i, QueueSize);
+                continue;
+            }
+            if (args[i] == "-NT" || args[i] == "--threads")
+            {
+                int threads;
+                ArgsObj.GetPara(i, threads);
+                PPL_SetThreads(threads);
+                continue;
+            }
             if (args[i][0] == '-')
             {
                 i++;
                 continue;
             }
 
-            IPath = args[i];
+            add_IPath(args[i]);
         }
 
         ArgsObj.Check();
+
+        if (ListPath.size() > 0)
+        {
+            add_ListPath(ListPath);
+        }
     }
 
+    // Called once after arguments_process() and before processing any image,
+    // filters which don't depend on the input image should be constructed here and shared by all the inputs
+    virtual void prepare() {}
+
+    // Called once after all the images are processed
+    virtual void finish() {}
+
     virtual Frame process(const Frame &src) = 0;
 
+    // Called after the last image for each of the remaining Delay() outputs, in order
+    virtual Frame flush()
+    {
+        return Frame();
+    }
+
 public:
     FilterIO(std::string _Tag = "")
         : Tag(std::move(_Tag))
@@ -291,6 +506,13 @@ public:
 
     virtual ~FilterIO() {}
 
+    // Number of images the output of process() lags behind its input, for filters taking the following images,
+    // the first Delay() results of process() are discarded and the last Delay() outputs are obtained from flush()
+    virtual int Delay() const
+    {
+        return 0;
+    }
+
     void SetArgs(int _argc, const std::vector<std::string> &_args)
     {
         argc = _argc;
@@ -302,13 +524,49 @@ public:
         Tag = std::move(_Tag);
     }
 
+    const std::string &GetTag() const
+    {
+        return Tag;
+    }
+
+    // Parse the arguments and prepare the filter without any image I/O,
+    // then Filter() can be called on in-memory frames, which is used to chain several FilterIO objects
+    void Init()
+    {
+        arguments_process();
+        prepare();
+    }
+
+    Frame Filter(const Frame &src)
+    {
+        return process(src);
+    }
+
+    // Input paths can be image files, directories and list files (--list), multiple inputs are processed in batch mode.
+    // _OPath is only used when there's a single input.
     void operator()(std::string _IPath = "", std::string _OPath = "")
     {
         arguments_process();
-        if(_IPath != "") IPath = std::move(_IPath);
-        if(_OPath != "") OPath = std::move(_OPath);
-        else generate_OPath();
-        processIO();
+        if (_IPath != "") IPaths.assign(1, std::move(_IPath));
+
+        if (IPaths.size() == 0)
+        {
+            std::cerr << "FilterIO: No input file specified!\n";
+            return;
+        }
+
+        prepare();
+
+        if (IPaths.size() == 1)
+        {
+            processIO(IPaths[0], _OPath != "" ? _OPath : generate_OPath(IPaths[0]));
+        }
+        else
+        {
+            processBatch();
+        }
+
+        finish();
     }
 
     FilterIO(const _Myt &src) = default;
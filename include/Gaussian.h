@@ -52,6 +52,8 @@ public:
 protected:
     Gaussian2D_Para para = Gaussian2D_Default;
 
+    std::unique_ptr<Gaussian2D> filter;
+
     virtual void arguments_process()
     {
         _Mybase::arguments_process();
@@ -75,10 +77,14 @@ protected:
         ArgsObj.Check();
     }
 
+    virtual void prepare()
+    {
+        filter.reset(new Gaussian2D(para));
+    }
+
     virtual Frame process(const Frame &src)
     {
-        Gaussian2D filter(para);
-        return filter(src);
+        return (*filter)(src);
     }
 
 public:
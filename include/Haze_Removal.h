@@ -202,6 +202,8 @@ public:
     typedef Haze_Removal_IO _Mybase;
 
 protected:
+    std::unique_ptr<Haze_Removal_Retinex> filter;
+
     virtual void arguments_process()
     {
         _Mybase::arguments_process();
@@ -238,10 +240,14 @@ protected:
         }
     }
 
+    virtual void prepare()
+    {
+        filter.reset(new Haze_Removal_Retinex(para));
+    }
+
     virtual Frame process(const Frame &src)
     {
-        Haze_Removal_Retinex filter(para);
-        return filter(src);
+        return (*filter)(src);
     }
 
 public:
@@ -12,6 +12,7 @@
 #include "Specification.h"
 #include "LUT.h"
 #include "Histogram.h"
+#include "Conversion.hpp"
 #include "Block.h"
 #include "ImageIO.h"
 #include "Filter.h"
@@ -27,7 +28,9 @@
 #include "AWB.h"
 #include "NLMeans.h"
 #include "BM3D.h"
+#include "VBM3D.h"
 #include "Haze_Removal.h"
+#include "Pipeline.h"
 
 #ifdef _CUDA_
 #include "Transform.cuh"
@@ -43,5 +46,8 @@ typedef Haze_Removal_Retinex_IO _Haze_Removal_Retinex_IO;
 
 int Filtering(const int argc, char ** argv);
 
+// Create the FilterIO object from the filter name of the command line, return nullptr if unrecognized
+FilterIO *CreateFilterIO(const std::string &FilterName);
+
 
 #endif
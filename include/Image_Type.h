@@ -4,11 +4,13 @@
 
 #include <iostream>
 #include <vector>
+#include <limits>
 #include <cassert>
 #include <crtdefs.h>
 #include "Type.h"
 #include "Helper.h"
 #include "Specification.h"
+#include "Buffer_Pool.h"
 
 
 const DType MaxBitDepth = sizeof(DType) * 8 * 3 / 4;
@@ -43,18 +45,85 @@ enum class QuantRange
 };
 
 
-class Plane;
+// Memory layout of the rows of Plane_Int and Plane_FL
+// Each row is padded to a multiple of the alignment (in bytes), thus every row starts at an aligned address,
+// and an apron of pixels can be reserved around the plane for branch-free border handling, filled by ExtendBorder().
+// Padding and apron are not part of the image, pixel (j, i) is always at data()[j * Stride() + i].
+// Newly created planes take the process-wide default,
+// planes created from another plane keep its apron, and its stride when their value types are of the same size.
+// The default alignment is 64 bytes, while the CUDA build keeps continuous rows,
+// since the CUDA filters copy a plane as a whole block of memory.
+size_t Plane_Alignment();
+void Plane_SetAlignment(size_t alignment); // 0 for continuous rows, that is Stride() == Width() without apron
+PCType Plane_Apron();
+void Plane_SetApron(PCType apron);
+
+// Allocate the memory of a plane with the current alignment, Data points to pixel (0, 0) inside Alloc
+// The memory is drawn from BufferPool::Default() and should be returned by Plane_Free
+// StrideHint is the stride to keep if it fits the row, thus pixels of both planes share the same index
+template < typename _Ty >
+void Plane_Alloc(_Ty *&Alloc, _Ty *&Data, PCType &Stride, PCType Width, PCType Height, PCType Apron, PCType StrideHint = 0)
+{
+    const size_t Alignment = Plane_Alignment();
+    const PCType AlignCount = Alignment > sizeof(_Ty) ? static_cast<PCType>(Alignment / sizeof(_Ty)) : 1;
+    const PCType ApronH = (Apron + AlignCount - 1) / AlignCount * AlignCount;
+
+    Stride = (ApronH + Width + Apron + AlignCount - 1) / AlignCount * AlignCount;
+
+    if (StrideHint >= ApronH + Width + Apron)
+    {
+        Stride = StrideHint;
+    }
+
+    if (Width <= 0 || Height <= 0)
+    {
+        Alloc = Data = nullptr;
+        return;
+    }
+
+    Alloc = static_cast<_Ty *>(BufferPool::Default().Acquire(sizeof(_Ty) * static_cast<size_t>(Height + Apron * 2) * Stride));
+    Data = Alloc + Apron * Stride + ApronH;
+}
+
+template < typename _Ty > inline
+void Plane_Free(_Ty *&Alloc)
+{
+    BufferPool::Default().Release(Alloc);
+    Alloc = nullptr;
+}
+
+
+// Stride of src to be kept by a plane of value type _Ty created from it, 0 if the value types are of different size
+template < typename _Ty, typename _St1 > inline
+PCType Plane_StrideHint(const _St1 &src)
+{
+    return sizeof(_Ty) == sizeof(typename _St1::value_type) ? src.Stride() : 0;
+}
+
+
+// Integer plane, the storage type of pixels is a template parameter
+// Plane (DType) is used by Frame and most of the filters, while Plane_8 (uint8) and Plane_16 (uint16)
+// take 1/4 and 1/2 of the memory and bandwidth for 8-bit and 16-bit data.
+// The quantization parameters (BitDepth, Floor, Neutral, Ceil) are always stored as DType,
+// and they should fit in the range of the storage type.
+template < typename _Ty = DType > class Plane_Int;
 class Plane_FL;
 class Frame;
 
+template < typename _Ex > struct PlaneExpr;
 
-class Plane
+typedef Plane_Int<DType> Plane;
+typedef Plane_Int<uint8> Plane_8;
+typedef Plane_Int<uint16> Plane_16;
+
+
+template < typename _Ty >
+class Plane_Int
 {
 public:
-    typedef DType _Ty;
-
-    typedef Plane _Myt;
+    typedef Plane_Int<_Ty> _Myt;
     typedef _Ty value_type;
+    typedef DType para_type;
     typedef size_t size_type;
     typedef ptrdiff_t difference_type;
     typedef _Ty *pointer;
@@ -65,44 +134,58 @@ public:
     typedef pointer iterator;
     typedef const_pointer const_iterator;
 
+    static const para_type DefaultBitDepth = sizeof(_Ty) < 2 ? 8 : 16;
+
 public:
-    const value_type value_type_MIN = IntMin(value_type);
-    const value_type value_type_MAX = IntMax(value_type);
-    
+    const value_type value_type_MIN = std::numeric_limits<value_type>::min();
+    const value_type value_type_MAX = std::numeric_limits<value_type>::max();
+
 private:
     PCType Width_ = 0;
     PCType Height_ = 0;
     PCType PixelCount_ = 0;
-    value_type BitDepth_;
-    value_type Floor_;
-    value_type Neutral_;
-    value_type Ceil_;
+    PCType Stride_ = 0;
+    PCType Apron_ = 0;
+    para_type BitDepth_;
+    para_type Floor_;
+    para_type Neutral_;
+    para_type Ceil_;
     TransferChar TransferChar_;
     pointer Data_ = nullptr;
+    pointer Alloc_ = nullptr;
+
+    void Alloc(PCType _Apron, PCType _StrideHint = 0);
+    void Free();
+
+    friend class Frame;
 
 protected:
-    void DefaultPara(bool Chroma, value_type _BitDepth = 16, QuantRange _QuantRange = QuantRange::PC);
+    void Borrow(pointer _Data, PCType _Width, PCType _Height, PCType _Stride);
+    void DefaultPara(bool Chroma, para_type _BitDepth = DefaultBitDepth, QuantRange _QuantRange = QuantRange::PC);
     void CopyParaFrom(const _Myt &src);
 
 public:
     void InitValue(value_type Value, bool Init = true);
 
-    Plane() {} // Default constructor
-    explicit Plane(value_type Value, PCType _Width = 1920, PCType _Height = 1080, value_type _BitDepth = 16, bool Init = true); // Convertor/Constructor from value_type
-    Plane(value_type Value, PCType _Width, PCType _Height, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar, bool Init = true);
+    Plane_Int() {} // Default constructor
+    explicit Plane_Int(value_type Value, PCType _Width = 1920, PCType _Height = 1080, para_type _BitDepth = DefaultBitDepth, bool Init = true); // Convertor/Constructor from value_type
+    Plane_Int(value_type Value, PCType _Width, PCType _Height, para_type _BitDepth, para_type _Floor, para_type _Neutral, para_type _Ceil, TransferChar _TransferChar, bool Init = true);
 
-    Plane(const _Myt &src); // Copy constructor
-    Plane(const _Myt &src, bool Init, value_type Value = 0);
-    Plane(_Myt &&src); // Move constructor
-    explicit Plane(const Plane_FL &src, value_type _BitDepth = 16); // Convertor/Constructor from Plane_FL
-    Plane(const Plane_FL &src, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil);
-    Plane(const Plane_FL &src, bool Init, value_type Value = 0, value_type _BitDepth = 16);
-    Plane(const Plane_FL &src, bool Init, value_type Value, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil);
+    Plane_Int(const _Myt &src); // Copy constructor
+    Plane_Int(const _Myt &src, bool Init, value_type Value = 0);
+    Plane_Int(_Myt &&src); // Move constructor
+    explicit Plane_Int(const Plane_FL &src, para_type _BitDepth = DefaultBitDepth); // Convertor/Constructor from Plane_FL
+    Plane_Int(const Plane_FL &src, para_type _BitDepth, para_type _Floor, para_type _Neutral, para_type _Ceil);
+    Plane_Int(const Plane_FL &src, bool Init, value_type Value = 0, para_type _BitDepth = DefaultBitDepth);
+    Plane_Int(const Plane_FL &src, bool Init, value_type Value, para_type _BitDepth, para_type _Floor, para_type _Neutral, para_type _Ceil);
+    template < typename _St1 > explicit Plane_Int(const Plane_Int<_St1> &src); // Convertor/Constructor from other storage type
+    template < typename _St1 > Plane_Int(const Plane_Int<_St1> &src, bool Init, value_type Value = 0);
 
-    ~Plane(); // Destructor
+    ~Plane_Int(); // Destructor
 
     _Myt &operator=(const _Myt &src); // Copy assignment operator
     _Myt &operator=(_Myt &&src); // Move assignment operator
+    template < typename _Ex > _Myt &operator=(const PlaneExpr<_Ex> &expr); // Evaluate a pixel-wise expression in one pass
     bool operator==(const _Myt &b) const;
     bool operator!=(const _Myt &b) const { return !(*this == b); }
     reference operator[](PCType i) { return Data_[i]; }
@@ -110,10 +193,11 @@ public:
     reference operator()(PCType j, PCType i) { return Data_[j * Stride() + i]; }
     const_reference operator()(PCType j, PCType i) const { return Data_[j * Stride() + i]; }
 
+    // Iterators over the memory of all the rows, including the padding at the end of each row
     iterator begin() { return Data_; }
     const_iterator begin() const { return Data_; }
-    iterator end() { return Data_ + PixelCount_; }
-    const_iterator end() const { return Data_ + PixelCount_; }
+    iterator end() { return Data_ + Height_ * Stride_; }
+    const_iterator end() const { return Data_ + Height_ * Stride_; }
     size_type size() const { return PixelCount_; }
     pointer data() { return Data_; }
     const_pointer data() const { return Data_; }
@@ -122,13 +206,15 @@ public:
 
     PCType Height() const { return Height_; }
     PCType Width() const { return Width_; }
-    PCType Stride() const { return Width_; }
+    PCType Stride() const { return Stride_; }
+    PCType Apron() const { return Apron_; }
     PCType PixelCount() const { return PixelCount_; }
-    value_type BitDepth() const { return BitDepth_; }
-    value_type Floor() const { return Floor_; }
-    value_type Neutral() const { return Neutral_; }
-    value_type Ceil() const { return Ceil_; }
-    value_type ValueRange() const { return Ceil_ - Floor_; }
+    bool isView() const { return Data_ != nullptr && Alloc_ == nullptr; } // The memory is borrowed from another plane
+    para_type BitDepth() const { return BitDepth_; }
+    para_type Floor() const { return Floor_; }
+    para_type Neutral() const { return Neutral_; }
+    para_type Ceil() const { return Ceil_; }
+    para_type ValueRange() const { return Ceil_ - Floor_; }
     TransferChar GetTransferChar() const { return TransferChar_; }
 
     pointer Data() { return Data_; }
@@ -146,9 +232,11 @@ public:
     _Myt &Width(PCType _Width) { return ReSize(_Width, Height()); }
     _Myt &Height(PCType _Height) { return ReSize(Width(), _Height); }
     _Myt &ReSize(PCType _Width, PCType _Height);
+    _Myt &SetApron(PCType _Apron); // Re-allocate with the apron of _Apron pixels, the image is preserved
+    void ExtendBorder(); // Fill the apron by replicating the edge pixels
     void ReSetChroma(bool Chroma = false);
-    _Myt &ReQuantize(value_type _BitDepth = 16, QuantRange _QuantRange = QuantRange::PC, bool scale = true, bool clip = false);
-    _Myt &ReQuantize(value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, bool scale = true, bool clip = false);
+    _Myt &ReQuantize(para_type _BitDepth = DefaultBitDepth, QuantRange _QuantRange = QuantRange::PC, bool scale = true, bool clip = false);
+    _Myt &ReQuantize(para_type _BitDepth, para_type _Floor, para_type _Neutral, para_type _Ceil, bool scale = true, bool clip = false);
     _Myt &SetTransferChar(TransferChar _TransferChar) { TransferChar_ = _TransferChar; return *this; }
 
     FLType GetFL(value_type input) const { return static_cast<FLType>(input - Neutral()) / ValueRange(); }
@@ -156,8 +244,8 @@ public:
     value_type GetD(FLType input) const { return static_cast<value_type>(input * ValueRange() + Neutral_ + FLType(0.5)); }
     value_type GetD_PCChroma(FLType input) const { return static_cast<value_type>(input * ValueRange() + Neutral_ + FLType(0.499999)); }
 
-    _Myt &Binarize(const _Myt &src, value_type lower_thrD, value_type upper_thrD);
-    _Myt &Binarize(value_type lower_thrD, value_type upper_thrD) { return Binarize(*this, lower_thrD, upper_thrD); }
+    _Myt &Binarize(const _Myt &src, para_type lower_thrD, para_type upper_thrD);
+    _Myt &Binarize(para_type lower_thrD, para_type upper_thrD) { return Binarize(*this, lower_thrD, upper_thrD); }
     _Myt &Binarize_ratio(const _Myt &src, double lower_thr = 0., double upper_thr = 1.);
     _Myt &Binarize_ratio(double lower_thr = 0., double upper_thr = 1.) { return Binarize_ratio(*this, lower_thr, upper_thr); }
 
@@ -200,13 +288,20 @@ private:
     PCType Width_ = 0;
     PCType Height_ = 0;
     PCType PixelCount_ = 0;
+    PCType Stride_ = 0;
+    PCType Apron_ = 0;
     value_type Floor_ = 0;
     value_type Neutral_ = 0;
     value_type Ceil_ = 1;
     TransferChar TransferChar_;
     pointer Data_ = nullptr;
+    pointer Alloc_ = nullptr;
+
+    void Alloc(PCType _Apron, PCType _StrideHint = 0);
+    void Free();
 
 protected:
+    void Borrow(pointer _Data, PCType _Width, PCType _Height, PCType _Stride);
     void DefaultPara(bool Chroma, value_type range = 1);
     void CopyParaFrom(const _Myt &src);
 
@@ -220,13 +315,14 @@ public:
     Plane_FL(const _Myt &src); // Copy constructor
     Plane_FL(const _Myt &src, bool Init, value_type Value = 0);
     Plane_FL(_Myt &&src); // Move constructor
-    explicit Plane_FL(const Plane &src, value_type range = 1.); // Convertor/Constructor from Plane
-    Plane_FL(const Plane &src, bool Init, value_type Value = 0, value_type range = 1.);
+    template < typename _St1 > explicit Plane_FL(const Plane_Int<_St1> &src, value_type range = 1.); // Convertor/Constructor from Plane
+    template < typename _St1 > Plane_FL(const Plane_Int<_St1> &src, bool Init, value_type Value = 0, value_type range = 1.);
 
     ~Plane_FL(); // Destructor
 
     _Myt &operator=(const _Myt &src); // Copy assignment operator
     _Myt &operator=(_Myt &&src); // Move assignment operator
+    template < typename _Ex > _Myt &operator=(const PlaneExpr<_Ex> &expr); // Evaluate a pixel-wise expression in one pass
     bool operator==(const _Myt &b) const;
     bool operator!=(const _Myt &b) const { return !(*this == b); }
     reference operator[](PCType i) { return Data_[i]; }
@@ -234,10 +330,11 @@ public:
     reference operator()(PCType j, PCType i) { return Data_[j * Stride() + i]; }
     const_reference operator()(PCType j, PCType i) const { return Data_[j * Stride() + i]; }
 
+    // Iterators over the memory of all the rows, including the padding at the end of each row
     iterator begin() { return Data_; }
     const_iterator begin() const { return Data_; }
-    iterator end() { return Data_ + PixelCount_; }
-    const_iterator end() const { return Data_ + PixelCount_; }
+    iterator end() { return Data_ + Height_ * Stride_; }
+    const_iterator end() const { return Data_ + Height_ * Stride_; }
     size_type size() const { return PixelCount_; }
     pointer data() { return Data_; }
     const_pointer data() const { return Data_; }
@@ -246,8 +343,10 @@ public:
 
     PCType Height() const { return Height_; }
     PCType Width() const { return Width_; }
-    PCType Stride() const { return Width_; }
+    PCType Stride() const { return Stride_; }
+    PCType Apron() const { return Apron_; }
     PCType PixelCount() const { return PixelCount_; }
+    bool isView() const { return Data_ != nullptr && Alloc_ == nullptr; } // The memory is borrowed from another plane
     value_type Floor() const { return Floor_; }
     value_type Neutral() const { return Neutral_; }
     value_type Ceil() const { return Ceil_; }
@@ -269,6 +368,8 @@ public:
     _Myt &Width(PCType _Width) { return ReSize(_Width, Height()); }
     _Myt &Height(PCType _Height) { return ReSize(Width(), _Height); }
     _Myt &ReSize(PCType _Width, PCType _Height);
+    _Myt &SetApron(PCType _Apron); // Re-allocate with the apron of _Apron pixels, the image is preserved
+    void ExtendBorder(); // Fill the apron by replicating the edge pixels
     void ReSetChroma(bool Chroma = false);
     _Myt &ReQuantize(value_type _Floor, value_type _Neutral, value_type _Ceil, bool scale = true, bool clip = false);
     _Myt &SetTransferChar(TransferChar _TransferChar) { TransferChar_ = _TransferChar; return *this; }
@@ -339,6 +440,7 @@ protected:
     void InitPlanes(PCType _Width = 1920, PCType _Height = 1080, value_type _BitDepth = 16, bool Init = true);
     void CopyPlanes(const _Myt &src, bool Copy = true, bool Init = false);
     void MovePlanes(_Myt &src);
+    void ViewPlanes(const _Myt &src, PCType top, PCType left, PCType height, PCType width);
     void FreePlanes();
 
 public:
@@ -394,6 +496,7 @@ public:
     PCType Stride() const { return P_[0]->Stride(); }
     PCType PixelCount() const { return P_[0]->PixelCount(); }
     value_type BitDepth() const { return P_[0]->BitDepth(); }
+    bool isView() const { return PlaneCount_ > 0 && P_[0]->isView(); }
 
     _Myt &SetQuantRange(QuantRange _QuantRange) { QuantRange_ = _QuantRange; return *this; }
     _Myt &SetChromaPlacement(ChromaPlacement _ChromaPlacement) { ChromaPlacement_ = _ChromaPlacement; return *this; }
@@ -403,13 +506,127 @@ public:
 };
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Non-owning views of a rectangle in existing planes and frames, nothing is copied on construction
+// A view is a plane (frame) with borrowed memory, thus it can be passed to any function taking a plane (frame),
+// and its Stride() is the stride of the parent plane.
+// Copying or moving a view into a view makes another view of the same memory,
+// while copying or moving it into a plane (frame) copies the pixels into new memory.
+// Planes created from a view keep the stride of its parent as planes created from any other plane,
+// thus they share the same pixel index, and a tile of a wide plane takes the full row width of memory.
+// Assigning a plane to a view writes the pixels through the view, the size should be the same.
+// A view can't be resized, and it must not outlive the memory it refers to.
+// The constructors taking a const parent don't prevent writing through the view, declare the view const in that case.
+template < typename _Ty = DType > class PlaneView_Int;
+class PlaneView_FL;
+class FrameView;
+
+typedef PlaneView_Int<DType> PlaneView;
+typedef PlaneView_Int<uint8> PlaneView_8;
+typedef PlaneView_Int<uint16> PlaneView_16;
+
+
+template < typename _Ty >
+class PlaneView_Int
+    : public Plane_Int<_Ty>
+{
+public:
+    typedef PlaneView_Int<_Ty> _Myt;
+    typedef Plane_Int<_Ty> _Mybase;
+    typedef typename _Mybase::value_type value_type;
+    typedef typename _Mybase::para_type para_type;
+    typedef typename _Mybase::pointer pointer;
+
+public:
+    // View of the rectangle [top, top + height) x [left, left + width) in src
+    PlaneView_Int(const _Mybase &src, PCType top, PCType left, PCType height, PCType width);
+    explicit PlaneView_Int(const _Mybase &src)
+        : _Myt(src, 0, 0, src.Height(), src.Width())
+    {}
+    // View of external memory
+    PlaneView_Int(pointer _Data, PCType _Width, PCType _Height, PCType _Stride, para_type _BitDepth,
+        para_type _Floor, para_type _Neutral, para_type _Ceil, TransferChar _TransferChar);
+
+    PlaneView_Int(const _Myt &src)
+        : _Myt(src, 0, 0, src.Height(), src.Width())
+    {}
+    PlaneView_Int(_Myt &&src)
+        : _Myt(static_cast<const _Myt &>(src))
+    {}
+
+    using _Mybase::operator=;
+    _Myt &operator=(const _Myt &src) { _Mybase::operator=(src); return *this; }
+};
+
+
+class PlaneView_FL
+    : public Plane_FL
+{
+public:
+    typedef PlaneView_FL _Myt;
+    typedef Plane_FL _Mybase;
+
+public:
+    // View of the rectangle [top, top + height) x [left, left + width) in src
+    PlaneView_FL(const _Mybase &src, PCType top, PCType left, PCType height, PCType width);
+    explicit PlaneView_FL(const _Mybase &src)
+        : _Myt(src, 0, 0, src.Height(), src.Width())
+    {}
+    // View of external memory
+    PlaneView_FL(pointer _Data, PCType _Width, PCType _Height, PCType _Stride,
+        value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar);
+
+    PlaneView_FL(const _Myt &src)
+        : _Myt(src, 0, 0, src.Height(), src.Width())
+    {}
+    PlaneView_FL(_Myt &&src)
+        : _Myt(static_cast<const _Myt &>(src))
+    {}
+
+    using _Mybase::operator=;
+    _Myt &operator=(const _Myt &src) { _Mybase::operator=(src); return *this; }
+};
+
+
+// The rectangle is in the coordinates of the first plane, and it's scaled for the sub-sampled chroma planes
+class FrameView
+    : public Frame
+{
+public:
+    typedef FrameView _Myt;
+    typedef Frame _Mybase;
+
+public:
+    FrameView(const _Mybase &src, PCType top, PCType left, PCType height, PCType width)
+    {
+        ViewPlanes(src, top, left, height, width);
+    }
+    explicit FrameView(const _Mybase &src)
+        : _Myt(src, 0, 0, src.Height(), src.Width())
+    {}
+
+    FrameView(const _Myt &src)
+        : _Myt(src, 0, 0, src.Height(), src.Width())
+    {}
+    FrameView(_Myt &&src)
+        : _Myt(static_cast<const _Myt &>(src))
+    {}
+
+    using _Mybase::operator=;
+    _Myt &operator=(const _Myt &src) { _Mybase::operator=(src); return *this; }
+};
+
+
 #include "Image_Type.hpp"
+#include "Plane_Expr.hpp"
 
 
-// Inline functions for class Plane
-inline bool Plane::isChroma() const { return ::isChroma(Floor(), Neutral()); }
-inline bool Plane::isPCChroma() const { return ::isPCChroma(Floor(), Neutral(), Ceil()); }
-inline void Plane::ReSetChroma(bool Chroma) { ::ReSetChroma(Floor_, Neutral_, Ceil_, Chroma); }
+// Inline functions for class Plane_Int
+template < typename _Ty > inline bool Plane_Int<_Ty>::isChroma() const { return ::isChroma(Floor(), Neutral()); }
+template < typename _Ty > inline bool Plane_Int<_Ty>::isPCChroma() const { return ::isPCChroma(Floor(), Neutral(), Ceil()); }
+template < typename _Ty > inline void Plane_Int<_Ty>::ReSetChroma(bool Chroma) { ::ReSetChroma(Floor_, Neutral_, Ceil_, Chroma); }
 
 
 // Inline functions for class Plane_FL
@@ -418,65 +635,127 @@ inline bool Plane_FL::isPCChroma() const { return ::isPCChroma(Floor(), Neutral(
 inline void Plane_FL::ReSetChroma(bool Chroma) { ::ReSetChroma(Floor_, Neutral_, Ceil_, Chroma); }
 
 
-// Template functions for class Plane
+// Template functions for class Plane_Int
+template < typename _Ty >
+template < typename _St1 >
+Plane_Int<_Ty>::Plane_Int(const Plane_Int<_St1> &src)
+    : Width_(src.Width()), Height_(src.Height()), PixelCount_(src.PixelCount()), BitDepth_(src.BitDepth()),
+    Floor_(src.Floor()), Neutral_(src.Neutral()), Ceil_(src.Ceil()), TransferChar_(src.GetTransferChar())
+{
+    if (Floor_ < value_type_MIN || Ceil_ > value_type_MAX)
+    {
+        DEBUG_FAIL("Plane_Int: value range of src exceeds the range of the storage type!");
+    }
+
+    Alloc(src.Apron(), Plane_StrideHint<value_type>(src));
+
+    TRANSFORM(*this, src, [](_St1 x)
+    {
+        return static_cast<value_type>(x);
+    });
+}
+
+template < typename _Ty >
+template < typename _St1 >
+Plane_Int<_Ty>::Plane_Int(const Plane_Int<_St1> &src, bool Init, value_type Value)
+    : Width_(src.Width()), Height_(src.Height()), PixelCount_(src.PixelCount()), BitDepth_(src.BitDepth()),
+    Floor_(src.Floor()), Neutral_(src.Neutral()), Ceil_(src.Ceil()), TransferChar_(src.GetTransferChar())
+{
+    if (Floor_ < value_type_MIN || Ceil_ > value_type_MAX)
+    {
+        DEBUG_FAIL("Plane_Int: value range of src exceeds the range of the storage type!");
+    }
+
+    Alloc(src.Apron(), Plane_StrideHint<value_type>(src));
+
+    InitValue(Value, Init);
+}
+
+
+template < typename _Ty >
+template < typename _Ex > inline
+Plane_Int<_Ty> &Plane_Int<_Ty>::operator=(const PlaneExpr<_Ex> &expr)
+{
+    ASSIGN(*this, expr);
+    return *this;
+}
+
+
+template < typename _Ty >
 template < typename T > inline
-Plane::value_type Plane::Quantize(T input) const
+typename Plane_Int<_Ty>::value_type Plane_Int<_Ty>::Quantize(T input) const
 {
     T input_up = input + T(0.5);
-    return input <= Floor_ ? Floor_ : input_up >= Ceil_ ? Ceil_ : static_cast<Plane::value_type>(input_up);
+    return input <= Floor_ ? static_cast<value_type>(Floor_) : input_up >= Ceil_ ? static_cast<value_type>(Ceil_) : static_cast<value_type>(input_up);
 }
 
 
+template < typename _Ty >
 template < typename _Fn1 > inline
-void Plane::for_each(_Fn1 _Func) const
+void Plane_Int<_Ty>::for_each(_Fn1 _Func) const
 {
     FOR_EACH(*this, _Func);
 }
 
+template < typename _Ty >
 template < typename _Fn1 > inline
-void Plane::for_each(_Fn1 _Func)
+void Plane_Int<_Ty>::for_each(_Fn1 _Func)
 {
     FOR_EACH(*this, _Func);
 }
 
+template < typename _Ty >
 template < typename _Fn1 > inline
-void Plane::transform(_Fn1 _Func)
+void Plane_Int<_Ty>::transform(_Fn1 _Func)
 {
     TRANSFORM(*this, _Func);
 }
 
+template < typename _Ty >
 template < typename _St1, typename _Fn1 > inline
-void Plane::transform(const _St1 &src, _Fn1 _Func)
+void Plane_Int<_Ty>::transform(const _St1 &src, _Fn1 _Func)
 {
     TRANSFORM(*this, src, _Func);
 }
 
+template < typename _Ty >
 template < typename _St1, typename _St2, typename _Fn1 > inline
-void Plane::transform(const _St1 &src1, const _St2 &src2, _Fn1 _Func)
+void Plane_Int<_Ty>::transform(const _St1 &src1, const _St2 &src2, _Fn1 _Func)
 {
     TRANSFORM(*this, src1, src2, _Func);
 }
 
+template < typename _Ty >
 template < typename _St1, typename _St2, typename _St3, typename _Fn1 > inline
-void Plane::transform(const _St1 &src1, const _St2 &src2, const _St3 &src3, _Fn1 _Func)
+void Plane_Int<_Ty>::transform(const _St1 &src1, const _St2 &src2, const _St3 &src3, _Fn1 _Func)
 {
     TRANSFORM(*this, src1, src2, src3, _Func);
 }
 
+template < typename _Ty >
 template < typename _St1, typename _St2, typename _St3, typename _St4, typename _Fn1 > inline
-void Plane::transform(const _St1 &src1, const _St2 &src2, const _St3 &src3, const _St4 &src4, _Fn1 _Func)
+void Plane_Int<_Ty>::transform(const _St1 &src1, const _St2 &src2, const _St3 &src3, const _St4 &src4, _Fn1 _Func)
 {
     TRANSFORM(*this, src1, src2, src3, src4, _Func);
 }
 
+template < typename _Ty >
 template < PCType VRad, PCType HRad, typename _St1, typename _Fn1 > inline
-void Plane::convolute(const _St1 &src, _Fn1 _Func)
+void Plane_Int<_Ty>::convolute(const _St1 &src, _Fn1 _Func)
 {
     CONVOLUTE<VRad, HRad>(*this, src, _Func);
 }
 
 
 // Template functions for class Plane_FL
+template < typename _Ex > inline
+Plane_FL &Plane_FL::operator=(const PlaneExpr<_Ex> &expr)
+{
+    ASSIGN(*this, expr);
+    return *this;
+}
+
+
 template < typename T > inline
 Plane_FL::value_type Plane_FL::Quantize(T input) const
 {
@@ -13,6 +13,15 @@
 // Define it in the source file before #include "Image_Type.h" for fast compiling
 //#define ENABLE_PPL
 
+// Backend of the *_PPL parallel loops, define one of them in the project settings to override the default
+// PPL_CONCRT: Microsoft Concurrency Runtime (concurrency::parallel_for), default for MSVC
+// PPL_THREAD_POOL: portable std::thread pool (ThreadPool::Default()), default for other compilers
+// PPL_OPENMP: OpenMP, requires OpenMP enabled in the compiler (/openmp, -fopenmp)
+// The number of threads can be set at runtime by PPL_SetThreads() in Thread_Pool.h
+//#define PPL_CONCRT
+//#define PPL_THREAD_POOL
+//#define PPL_OPENMP
+
 // Enable C++ AMP Support
 // Define it in the source file before #include "Image_Type.h" for fast compiling
 //#define ENABLE_AMP
@@ -27,8 +36,20 @@
 #define CONVOLUTE _Convolute
 
 #ifdef ENABLE_PPL
+#if !defined(PPL_CONCRT) && !defined(PPL_THREAD_POOL) && !defined(PPL_OPENMP)
+#ifdef _MSC_VER
+#define PPL_CONCRT
+#else
+#define PPL_THREAD_POOL
+#endif
+#endif
+#if defined(PPL_CONCRT)
 #include <ppl.h>
 #include <ppltasks.h>
+#elif defined(PPL_OPENMP)
+#include <omp.h>
+#endif
+#include "Thread_Pool.h"
 #define LOOP_V_PPL _Loop_V_PPL
 #define LOOP_H_PPL _Loop_H_PPL
 #define LOOP_Hinv_PPL _Loop_Hinv_PPL
@@ -36,8 +57,9 @@
 #define FOR_EACH_PPL _For_each_PPL
 #define TRANSFORM_PPL _Transform_PPL
 #define CONVOLUTE_PPL _Convolute_PPL
-const PCType PPL_HP = 256; // Height piece size for PPL
-const PCType PPL_WP = 256; // Width piece size for PPL
+const PCType PPL_HP = 256; // Max height piece size for PPL
+const PCType PPL_WP = 256; // Max width piece size for PPL
+const PCType PPL_WP_MIN = 64; // Min width piece size for PPL, to keep the rows of each piece cache friendly
 #else
 #define LOOP_V_PPL LOOP_V
 #define LOOP_H_PPL LOOP_H
@@ -309,9 +331,15 @@ void _Transform(_Dt1 &dst, const _St1 &src, _Fn1 &&_Func)
         DEBUG_FAIL("_Transform: Width() and Height() of dst and src must be the same.");
     }
 
-    LOOP_VH(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    LOOP_V(dst.Height(), [&](PCType j)
     {
-        dst[i] = _Func(src[i]);
+        auto dstp = dst.data() + j * dst.Stride();
+        auto srcp = src.data() + j * src.Stride();
+
+        for (PCType i = 0; i < dst.Width(); ++i)
+        {
+            dstp[i] = _Func(srcp[i]);
+        }
     });
 }
 
@@ -324,9 +352,16 @@ void _Transform(_Dt1 &dst, const _St1 &src1, const _St2 &src2, _Fn1 &&_Func)
         DEBUG_FAIL("_Transform: Width() and Height() of dst, src1 and src2 must be the same.");
     }
 
-    LOOP_VH(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    LOOP_V(dst.Height(), [&](PCType j)
     {
-        dst[i] = _Func(src1[i], src2[i]);
+        auto dstp = dst.data() + j * dst.Stride();
+        auto src1p = src1.data() + j * src1.Stride();
+        auto src2p = src2.data() + j * src2.Stride();
+
+        for (PCType i = 0; i < dst.Width(); ++i)
+        {
+            dstp[i] = _Func(src1p[i], src2p[i]);
+        }
     });
 }
 
@@ -340,9 +375,17 @@ void _Transform(_Dt1 &dst, const _St1 &src1, const _St2 &src2, const _St3 &src3,
         DEBUG_FAIL("_Transform: Width() and Height() of dst, src1, src2 and src3 must be the same.");
     }
 
-    LOOP_VH(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    LOOP_V(dst.Height(), [&](PCType j)
     {
-        dst[i] = _Func(src1[i], src2[i], src3[i]);
+        auto dstp = dst.data() + j * dst.Stride();
+        auto src1p = src1.data() + j * src1.Stride();
+        auto src2p = src2.data() + j * src2.Stride();
+        auto src3p = src3.data() + j * src3.Stride();
+
+        for (PCType i = 0; i < dst.Width(); ++i)
+        {
+            dstp[i] = _Func(src1p[i], src2p[i], src3p[i]);
+        }
     });
 }
 
@@ -357,9 +400,18 @@ void _Transform(_Dt1 &dst, const _St1 &src1, const _St2 &src2, const _St3 &src3,
         DEBUG_FAIL("_Transform: Width() and Height() of dst, src1, src2, src3 and src4 must be the same.");
     }
 
-    LOOP_VH(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    LOOP_V(dst.Height(), [&](PCType j)
     {
-        dst[i] = _Func(src1[i], src2[i], src3[i], src4[i]);
+        auto dstp = dst.data() + j * dst.Stride();
+        auto src1p = src1.data() + j * src1.Stride();
+        auto src2p = src2.data() + j * src2.Stride();
+        auto src3p = src3.data() + j * src3.Stride();
+        auto src4p = src4.data() + j * src4.Stride();
+
+        for (PCType i = 0; i < dst.Width(); ++i)
+        {
+            dstp[i] = _Func(src1p[i], src2p[i], src3p[i], src4p[i]);
+        }
     });
 }
 
@@ -430,17 +482,129 @@ void _Convolute(_Dt1 &dst, const _St1 &src, _Fn1 &&_Func)
 }
 
 
+// Template functions of plane layout
+// Copy the pixels of src to dst of the same size and value type, the rows may have different stride
+template < typename _Dt1, typename _St1 >
+void CopyData(_Dt1 &dst, const _St1 &src)
+{
+    static_assert(sizeof(typename _Dt1::value_type) == sizeof(typename _St1::value_type), "CopyData: value type of dst and src must be the same!");
+
+    if (dst.Width() != src.Width() || dst.Height() != src.Height())
+    {
+        DEBUG_FAIL("CopyData: Width() and Height() of dst and src must be the same.");
+    }
+
+    const PCType height = dst.Height();
+    const PCType width = dst.Width();
+
+    if (height <= 0 || width <= 0)
+    {
+        return;
+    }
+
+    // The padding of a view is the pixels of its parent, thus it's copied row by row
+    if (dst.Stride() == src.Stride() && !dst.isView())
+    {
+        memcpy(dst.data(), src.data(), sizeof(typename _Dt1::value_type) * ((height - 1) * dst.Stride() + width));
+    }
+    else
+    {
+        for (PCType j = 0; j < height; ++j)
+        {
+            memcpy(dst.data() + j * dst.Stride(), src.data() + j * src.Stride(), sizeof(typename _Dt1::value_type) * width);
+        }
+    }
+}
+
+// Fill the apron around the image by replicating the edge pixels, the corners take the value of the corner pixels
+template < typename _St1 >
+void ExtendBorder(_St1 &data)
+{
+    typedef typename _St1::value_type srcType;
+
+    const PCType apron = data.Apron();
+    const PCType height = data.Height();
+    const PCType width = data.Width();
+    const PCType stride = data.Stride();
+
+    if (apron <= 0 || height <= 0 || width <= 0)
+    {
+        return;
+    }
+
+    for (PCType j = 0; j < height; ++j)
+    {
+        srcType *rowp = data.data() + j * stride;
+        const srcType left = rowp[0];
+        const srcType right = rowp[width - 1];
+
+        for (PCType x = 1; x <= apron; ++x)
+        {
+            rowp[-x] = left;
+            rowp[width - 1 + x] = right;
+        }
+    }
+
+    const srcType *topp = data.data() - apron;
+    const srcType *bottomp = data.data() + (height - 1) * stride - apron;
+    const size_t rowSize = sizeof(srcType) * (width + apron * 2);
+
+    for (PCType y = 1; y <= apron; ++y)
+    {
+        memcpy(data.data() - y * stride - apron, topp, rowSize);
+        memcpy(data.data() + (height - 1 + y) * stride - apron, bottomp, rowSize);
+    }
+}
+
+
 // Template functions of algorithm with PPL
 #ifdef ENABLE_PPL
+// Call _Func(p) for each p in [lower, upper) in parallel with the selected backend
+template < typename _Fn1 >
+void _Parallel_for_PPL(const PCType lower, const PCType upper, _Fn1 &&_Func)
+{
+    const int threads = PPL_Threads();
+
+    if (threads == 1 || upper - lower <= 1)
+    {
+        for (PCType p = lower; p < upper; ++p)
+        {
+            _Func(p);
+        }
+
+        return;
+    }
+
+#if defined(PPL_CONCRT)
+    concurrency::parallel_for(lower, upper, _Func);
+#elif defined(PPL_OPENMP)
+#pragma omp parallel for schedule(dynamic) num_threads(threads > 0 ? threads : omp_get_max_threads())
+    for (PCType p = lower; p < upper; ++p)
+    {
+        _Func(p);
+    }
+#else
+    ThreadPool::Default().parallel_for(lower, upper, _Func, threads);
+#endif
+}
+
+// Split length into pieces no larger than max_piece, and enough pieces to balance the load of all the threads
+inline PCType _Piece_Size_PPL(const PCType length, const PCType max_piece, const PCType min_piece = 1)
+{
+    const PCType pieces = static_cast<PCType>(PPL_Concurrency()) * 4;
+    return Max(min_piece, Min(max_piece, (length + pieces - 1) / pieces));
+}
+
 template < typename _Fn1 >
 void _Loop_V_PPL(const PCType height, _Fn1 &&_Func)
 {
-    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
+    const PCType piece = _Piece_Size_PPL(height, PPL_HP);
+    const PCType pNum = (height + piece - 1) / piece;
 
-    concurrency::parallel_for(PCType(0), pNum, [&](PCType p)
+    _Parallel_for_PPL(PCType(0), pNum, [&](PCType p)
     {
-        const PCType lower = p * PPL_HP;
-        const PCType upper = Min(height, lower + PPL_HP);
+        const PCType lower = p * piece;
+        const PCType upper = Min(height, lower + piece);
 
         for (PCType j = lower; j < upper; ++j)
         {
@@ -452,12 +616,13 @@ void _Loop_V_PPL(const PCType height, _Fn1 &&_Func)
 template < typename _Fn1 >
 void _Loop_H_PPL(const PCType height, const PCType width, const PCType stride, _Fn1 &&_Func)
 {
-    const PCType pNum = (width + PPL_WP - 1) / PPL_WP;
+    const PCType piece = _Piece_Size_PPL(width, PPL_WP, PPL_WP_MIN);
+    const PCType pNum = (width + piece - 1) / piece;
 
-    concurrency::parallel_for(PCType(0), pNum, [&](PCType p)
+    _Parallel_for_PPL(PCType(0), pNum, [&](PCType p)
     {
-        const PCType offset = p * PPL_WP;
-        const PCType range = Min(width - offset, PPL_WP);
+        const PCType offset = p * piece;
+        const PCType range = Min(width - offset, piece);
 
         for (PCType j = 0; j < height; ++j)
         {
@@ -472,12 +637,13 @@ void _Loop_H_PPL(const PCType height, const PCType width, const PCType stride, _
 template < typename _Fn1 >
 void _Loop_Hinv_PPL(const PCType height, const PCType width, const PCType stride, _Fn1 &&_Func)
 {
-    const PCType pNum = (width + PPL_WP - 1) / PPL_WP;
+    const PCType piece = _Piece_Size_PPL(width, PPL_WP, PPL_WP_MIN);
+    const PCType pNum = (width + piece - 1) / piece;
 
-    concurrency::parallel_for(PCType(0), pNum, [&](PCType p)
+    _Parallel_for_PPL(PCType(0), pNum, [&](PCType p)
     {
-        const PCType offset = p * PPL_WP;
-        const PCType range = Min(width - offset, PPL_WP);
+        const PCType offset = p * piece;
+        const PCType range = Min(width - offset, piece);
 
         for (PCType j = height - 1; j >= 0; --j)
         {
@@ -492,12 +658,13 @@ void _Loop_Hinv_PPL(const PCType height, const PCType width, const PCType stride
 template < typename _Fn1 >
 void _Loop_VH_PPL(const PCType height, const PCType width, const PCType stride, _Fn1 &&_Func)
 {
-    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
+    const PCType piece = _Piece_Size_PPL(height, PPL_HP);
+    const PCType pNum = (height + piece - 1) / piece;
 
-    concurrency::parallel_for(PCType(0), pNum, [&](PCType p)
+    _Parallel_for_PPL(PCType(0), pNum, [&](PCType p)
     {
-        const PCType lower = p * PPL_HP;
-        const PCType upper = Min(height, lower + PPL_HP);
+        const PCType lower = p * piece;
+        const PCType upper = Min(height, lower + piece);
 
         for (PCType j = lower; j < upper; ++j)
         {
@@ -514,12 +681,13 @@ void _Loop_VH_PPL(const PCType height, const PCType width, const PCType stride,
 template < typename _Fn1 >
 void _Loop_VH_PPL(const PCType height, const PCType width, const PCType dst_stride, const PCType src_stride, _Fn1 &&_Func)
 {
-    const PCType pNum = (height + PPL_HP - 1) / PPL_HP;
+    const PCType piece = _Piece_Size_PPL(height, PPL_HP);
+    const PCType pNum = (height + piece - 1) / piece;
 
-    concurrency::parallel_for(PCType(0), pNum, [&](PCType p)
+    _Parallel_for_PPL(PCType(0), pNum, [&](PCType p)
     {
-        const PCType lower = p * PPL_HP;
-        const PCType upper = Min(height, lower + PPL_HP);
+        const PCType lower = p * piece;
+        const PCType upper = Min(height, lower + piece);
 
         for (PCType j = lower; j < upper; ++j)
         {
@@ -561,9 +729,15 @@ void _Transform_PPL(_Dt1 &dst, const _St1 &src, _Fn1 &&_Func)
         DEBUG_FAIL("_Transform_PPL: Width() and Height() of dst and src must be the same.");
     }
 
-    LOOP_VH_PPL(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    LOOP_V_PPL(dst.Height(), [&](PCType j)
     {
-        dst[i] = _Func(src[i]);
+        auto dstp = dst.data() + j * dst.Stride();
+        auto srcp = src.data() + j * src.Stride();
+
+        for (PCType i = 0; i < dst.Width(); ++i)
+        {
+            dstp[i] = _Func(srcp[i]);
+        }
     });
 }
 
@@ -575,9 +749,16 @@ void _Transform_PPL(_Dt1 &dst, const _St1 &src1, const _St2 &src2, _Fn1 &&_Func)
         DEBUG_FAIL("_Transform_PPL: Width() and Height() of dst, src1 and src2 must be the same.");
     }
 
-    LOOP_VH_PPL(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    LOOP_V_PPL(dst.Height(), [&](PCType j)
     {
-        dst[i] = _Func(src1[i], src2[i]);
+        auto dstp = dst.data() + j * dst.Stride();
+        auto src1p = src1.data() + j * src1.Stride();
+        auto src2p = src2.data() + j * src2.Stride();
+
+        for (PCType i = 0; i < dst.Width(); ++i)
+        {
+            dstp[i] = _Func(src1p[i], src2p[i]);
+        }
     });
 }
 
@@ -591,9 +772,17 @@ void _Transform_PPL(_Dt1 &dst, const _St1 &src1, const _St2 &src2, const _St3 &s
         DEBUG_FAIL("_Transform_PPL: Width() and Height() of dst, src1, src2 and src3 must be the same.");
     }
 
-    LOOP_VH_PPL(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    LOOP_V_PPL(dst.Height(), [&](PCType j)
     {
-        dst[i] = _Func(src1[i], src2[i], src3[i]);
+        auto dstp = dst.data() + j * dst.Stride();
+        auto src1p = src1.data() + j * src1.Stride();
+        auto src2p = src2.data() + j * src2.Stride();
+        auto src3p = src3.data() + j * src3.Stride();
+
+        for (PCType i = 0; i < dst.Width(); ++i)
+        {
+            dstp[i] = _Func(src1p[i], src2p[i], src3p[i]);
+        }
     });
 }
 
@@ -608,9 +797,18 @@ void _Transform_PPL(_Dt1 &dst, const _St1 &src1, const _St2 &src2, const _St3 &s
         DEBUG_FAIL("_Transform_PPL: Width() and Height() of dst, src1, src2, src3 and src4 must be the same.");
     }
 
-    LOOP_VH_PPL(dst.Height(), dst.Width(), dst.Stride(), [&](PCType i)
+    LOOP_V_PPL(dst.Height(), [&](PCType j)
     {
-        dst[i] = _Func(src1[i], src2[i], src3[i], src4[i]);
+        auto dstp = dst.data() + j * dst.Stride();
+        auto src1p = src1.data() + j * src1.Stride();
+        auto src2p = src2.data() + j * src2.Stride();
+        auto src3p = src3.data() + j * src3.Stride();
+        auto src4p = src4.data() + j * src4.Stride();
+
+        for (PCType i = 0; i < dst.Width(); ++i)
+        {
+            dstp[i] = _Func(src1p[i], src2p[i], src3p[i], src4p[i]);
+        }
     });
 }
 
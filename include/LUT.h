@@ -32,7 +32,7 @@ public:
     LUT(const _Myt &src); // Copy constructor
     LUT(_Myt &&src); // Move constructor
     explicit LUT(LevelType Levels); // Convertor/Constructor from LevelType
-    explicit LUT(const Plane &src); // Convertor/Constructor from Plane
+    template < typename _St1 > explicit LUT(const Plane_Int<_St1> &src); // Convertor/Constructor from Plane
     ~LUT(); // Destructor
 
     _Myt &operator=(const _Myt &src); // Copy assignment operator
@@ -44,13 +44,13 @@ public:
     pointer Table() { return Table_; }
     const_pointer Table() const { return Table_; }
 
-    void Set(const Plane &src, LevelType i, T o);
-    void SetRange(const Plane &src, T o = 0) { return SetRange(src, o, src.Floor(), src.Ceil()); }
-    void SetRange(const Plane &src, T o, LevelType start, LevelType end);
+    template < typename _St1 > void Set(const Plane_Int<_St1> &src, LevelType i, T o);
+    template < typename _St1 > void SetRange(const Plane_Int<_St1> &src, T o = 0) { return SetRange(src, o, src.Floor(), src.Ceil()); }
+    template < typename _St1 > void SetRange(const Plane_Int<_St1> &src, T o, LevelType start, LevelType end);
     template < typename _St1, typename _Fn1 > void Set(const _St1 &src, _Fn1 &&_Func);
 
-    T Lookup(const Plane &src, LevelType Value) const { return Table_[Value - src.Floor()]; }
-    template < typename _Dt1 > void Lookup(_Dt1 &dst, const Plane &src) const;
+    template < typename _St1 > T Lookup(const Plane_Int<_St1> &src, LevelType Value) const { return Table_[Value - src.Floor()]; }
+    template < typename _Dt1, typename _St1 > void Lookup(_Dt1 &dst, const Plane_Int<_St1> &src) const;
     template < typename _Dt1 > void Lookup(_Dt1 &dst, const Plane_FL &src) const;
 
     template < typename _Dt1, typename _St1, typename _Rt1 > void Lookup_Gain(_Dt1 &dst, const _St1 &src, const _Rt1 &ref) const;
@@ -30,7 +30,8 @@ LUT<T>::LUT(LevelType Levels)
 }
 
 template < typename T >
-LUT<T>::LUT(const Plane &src)
+template < typename _St1 >
+LUT<T>::LUT(const Plane_Int<_St1> &src)
     : Levels_(src.ValueRange() + 1)
 {
     Table_ = new T[Levels_];
@@ -81,7 +82,8 @@ LUT<T> &LUT<T>::operator=(_Myt &&src)
 
 
 template < typename T >
-void LUT<T>::Set(const Plane &src, LevelType i, T o)
+template < typename _St1 >
+void LUT<T>::Set(const Plane_Int<_St1> &src, LevelType i, T o)
 {
     if (i >= src.Floor() && i <= src.Ceil())
     {
@@ -94,7 +96,8 @@ void LUT<T>::Set(const Plane &src, LevelType i, T o)
 }
 
 template < typename T >
-void LUT<T>::SetRange(const Plane &src, T o, LevelType start, LevelType end)
+template < typename _St1 >
+void LUT<T>::SetRange(const Plane_Int<_St1> &src, T o, LevelType start, LevelType end)
 {
     sint64 length = static_cast<sint64>(end) - static_cast<sint64>(start) + 1;
     start = Max(LevelType(0), start - src.Floor());
@@ -121,11 +124,10 @@ void LUT<T>::Set(const _St1 &src, _Fn1 &&_Func)
 
 
 template < typename T >
-template < typename _Dt1 >
-void LUT<T>::Lookup(_Dt1 &dst, const Plane &src) const
+template < typename _Dt1, typename _St1 >
+void LUT<T>::Lookup(_Dt1 &dst, const Plane_Int<_St1> &src) const
 {
-    typedef Plane _St1;
-    typedef typename _St1::value_type srcType;
+    typedef _St1 srcType;
     typedef typename _Dt1::value_type dstType;
 
     TRANSFORM_PPL(dst, src, [&](srcType x)
@@ -165,8 +167,8 @@ void LUT<T>::Lookup_Gain(_Dt1 &dst, const _St1 &src, const _Rt1 &ref) const
 {
     TRANSFORM_PPL(dst, src, ref, [&](typename _St1::value_type s, typename _Rt1::value_type r)
     {
-        return Clip(static_cast<typename _Dt1::value_type>((s - src.Neutral()) * Table_[r - ref.Floor()] + dst.Neutral()),
-            dst.Floor(), dst.Ceil());
+        return static_cast<typename _Dt1::value_type>(Clip(static_cast<FLType>((s - src.Neutral()) * Table_[r - ref.Floor()] + dst.Neutral()),
+            static_cast<FLType>(dst.Floor()), static_cast<FLType>(dst.Ceil())));
     });
 }
 
@@ -174,10 +176,9 @@ template < typename T >
 template < typename _Rt1 >
 void LUT<T>::Lookup_Gain(Frame &dst, const Frame &src, const _Rt1 &ref) const
 {
-    PCType i, j, upper;
+    PCType r, s, d, j, upper;
     PCType height = ref.Height();
     PCType width = ref.Width();
-    PCType stride = ref.Width();
     DType rFloor = ref.Floor();
 
     FLType gain, offset;
@@ -206,17 +207,19 @@ void LUT<T>::Lookup_Gain(Frame &dst, const Frame &src, const _Rt1 &ref) const
 
         for (j = 0; j < height; j++)
         {
-            i = stride * j;
-            for (upper = i + width; i < upper; i++)
+            r = ref.Stride() * j;
+            s = src.Stride() * j;
+            d = dst.Stride() * j;
+            for (upper = s + width; s < upper; r++, s++, d++)
             {
-                Yval = srcY[i] - sFloor;
-                Uval = srcU[i] - sNeutral;
-                Vval = srcV[i] - sNeutral;
-                gain = Table_[ref[i] - rFloor];
+                Yval = srcY[s] - sFloor;
+                Uval = srcU[s] - sNeutral;
+                Vval = srcV[s] - sNeutral;
+                gain = Table_[ref[r] - rFloor];
                 gain = Min(sRangeFL / Yval, Min(sRangeC2FL / Max(Abs(Uval), Abs(Vval)), gain));
-                dstY[i] = static_cast<DType>(Yval * gain + offsetY);
-                dstU[i] = static_cast<DType>(Uval * gain + offset);
-                dstV[i] = static_cast<DType>(Vval * gain + offset);
+                dstY[d] = static_cast<DType>(Yval * gain + offsetY);
+                dstU[d] = static_cast<DType>(Uval * gain + offset);
+                dstV[d] = static_cast<DType>(Vval * gain + offset);
             }
         }
     }
@@ -237,17 +240,19 @@ void LUT<T>::Lookup_Gain(Frame &dst, const Frame &src, const _Rt1 &ref) const
 
         for (j = 0; j < height; j++)
         {
-            i = stride * j;
-            for (upper = i + width; i < upper; i++)
+            r = ref.Stride() * j;
+            s = src.Stride() * j;
+            d = dst.Stride() * j;
+            for (upper = s + width; s < upper; r++, s++, d++)
             {
-                Rval = srcR[i] - sFloor;
-                Gval = srcG[i] - sFloor;
-                Bval = srcB[i] - sFloor;
-                gain = Table_[ref[i] - rFloor];
+                Rval = srcR[s] - sFloor;
+                Gval = srcG[s] - sFloor;
+                Bval = srcB[s] - sFloor;
+                gain = Table_[ref[r] - rFloor];
                 gain = Min(sRangeFL / Max(Rval, Max(Gval, Bval)), gain);
-                dstR[i] = static_cast<DType>(Rval * gain + offset);
-                dstG[i] = static_cast<DType>(Gval * gain + offset);
-                dstB[i] = static_cast<DType>(Bval * gain + offset);
+                dstR[d] = static_cast<DType>(Rval * gain + offset);
+                dstG[d] = static_cast<DType>(Gval * gain + offset);
+                dstB[d] = static_cast<DType>(Bval * gain + offset);
             }
         }
     }
@@ -2,10 +2,14 @@
 #define NLMEANS_H_
 
 
+#include <deque>
 #include "Filter.h"
 #include "Image_Type.h"
 #include "Helper.h"
 #include "Block.h"
+#include "Block_Matching.h"
+#include "LUT.h"
+#include "Thread_Pool.h"
 
 
 const struct NLMeans_Para
@@ -19,6 +23,13 @@ const struct NLMeans_Para
     PCType BMrange = 24;
     PCType BMstep = 3;
     double thMSE = correction ? sigma * 50 : sigma * 25;
+    int BMalgorithm = 0; // 0 for direct SSD of each candidate, 1 for incremental sliding-window SSD, 2 for predictive search
+    PCType PSrange = 2; // Predictive search: radius of the window around each predicted position, in BMstep
+    PCType PSnum = 8; // Predictive search: number of the best matches of each neighbour taken as predictions
+    PCType PSfull = 4; // Predictive search: interval of the reference blocks and rows refreshed by a full search, 0 for never
+    int threads = 0; // 0 for all the hardware threads, 1 for serial processing
+    PCType radius = 0; // Temporal radius of the sequences filtered by NLMeans::Push() in block-wise mode, groups take blocks from the 2 * radius + 1 frames around the current frame
+    int mode = 0; // 0 for block-wise weighted average of the GroupSize best matches, 1 for pixel-wise weighted average of all the pixels in the search window
 } NLMeans_Default;
 
 
@@ -37,14 +48,77 @@ public:
     typedef block_type::KeyCode KeyCode;
     typedef block_type::PosCode PosCode;
     typedef block_type::PosPairCode PosPairCode;
+    typedef Pos3 Pos3Type;
+    typedef KeyPair<KeyType, Pos3Type> Pos3Pair;
+    typedef std::vector<Pos3Pair> Pos3PairCode;
+
+protected:
+    // Scratch blocks reused by all the reference blocks filtered by the same task
+    struct Scratch
+    {
+        block_type srcBlock;
+        block_type sumX1;
+        block_type sumX2;
+    };
+
+    // A frame of the sequence and its plane for block matching
+    struct Slot
+    {
+        Plane_FL ref;
+        Frame src;
+    };
 
 protected:
     NLMeans_Para para;
 
+    // exp(-t) sampled in 1 / WeightLUT_Scale, t is the distance (MSE in 8bit-scale) normalized by strength^2
+    static const int WeightLUT_Scale = 256;
+    LUT<FLType> WeightLUT;
+    FLType WeightLUT_Mul = 0; // converts the distance to the index of WeightLUT
+
+    // Frames of the sequence within radius of the current frame are kept in a ring buffer of 2 * radius + 1 frames
+    std::vector<Slot> ring;
+    std::deque<Frame> output;
+
+    PCType pushed = 0;
+    PCType done = 0;
+    bool finished = false;
+
 public:
     NLMeans(const NLMeans_Para &_para = NLMeans_Default)
         : para(_para)
-    {}
+    {
+        para.radius = Max(PCType(0), para.radius);
+        ring.resize(para.radius * 2 + 1);
+
+        WeightLUT_Init();
+    }
+
+    using _Mybase::operator();
+
+    // Temporal filtering of a sequence of frames, the current frame is matched as process_Frame(),
+    // then the matches are followed to the previous and the next frames within radius,
+    // each adjacent frame is searched around the best matches in the frame next to it toward the current frame.
+    // Frames are pushed in order, the filtered frames are popped in the same order with a delay of radius frames.
+    void Push(const Frame &src);
+
+    // Mark the end of the sequence, the remaining frames are filtered with the frames available
+    void Finish();
+
+    // Get the next filtered frame, return false if it's not available yet
+    bool Pop(Frame &dst);
+
+    // Start a new sequence
+    void Reset();
+
+    // Filter a whole sequence at once
+    std::vector<Frame> operator()(const std::vector<Frame> &src);
+
+    // Frame delay between Push() and Pop() before Finish() is called
+    PCType Delay() const
+    {
+        return para.radius;
+    }
 
 protected:
     virtual Plane_FL &process_Plane_FL(Plane_FL &dst, const Plane_FL &src, const Plane_FL &ref);
@@ -52,13 +126,81 @@ protected:
     virtual Frame &process_Frame(Frame &dst, const Frame &src, const Frame &ref);
 
 protected:
+    // Block matching of all the reference blocks, codes[row][k] is the match code of refPos[row][k]
+    // The rows are matched in parallel by chunks independent of the number of threads,
+    // each chunk of rows is matched with its own BlockMatching_Sliding or BlockMatching_Predictive,
+    // thus the matches are the same for any number of threads
+    void BlockMatching(std::vector<std::vector<PosPairCode>> &codes, const Plane_FL &ref,
+        const std::vector<PosCode> &refPos, int threads) const;
+
+    // Follow the matches matchCode of the reference block at (j, i) of frame center to the other frames of ref,
+    // the best matches of all the frames up to GroupSize are returned with the reference block first
+    Pos3PairCode BlockMatching(const std::vector<const Plane_FL *> &ref, PCType center,
+        const PosPairCode &matchCode, PCType j, PCType i) const;
+
+    // Filter the reference blocks of refPos in src[0] to src[planes - 1] and aggregate the filtered blocks,
+    // filter(dstBlock, plane, row, k, scratch) gets the filtered block of refPos[row][k] in plane.
+    // The filtered blocks of each band of rows are computed in parallel and aggregated in the scan order,
+    // thus the result is the same for any number of threads
+    template < typename _Fn1 >
+    void Kernel(Plane_FL *const ResNum[], Plane_FL &ResDen, int planes,
+        const std::vector<PosCode> &refPos, _Fn1 &&filter, int threads);
+
+    Slot &GetSlot(PCType n)
+    {
+        return ring[n % ring.size()];
+    }
+
+    void Advance();
+
+    // Filter the 3 planes of frame n with the frames within radius, and push it to output
+    void ProcessFrame(PCType n);
+
+    // Pixel-wise fast NL-means, each pixel is the weighted average of all the pixels within BMrange in BMstep,
+    // weighted by the MSE of the BlockSize x BlockSize patches centered at them in ref.
+    // The patch distances of each displacement are computed for all the pixels by an integral image of squared differences,
+    // thus the cost per pixel is independent of BlockSize (J. Darbon et al., "Fast nonlocal filtering applied to electron cryomicroscopy").
+    // src[0] to src[planes - 1] are filtered into dst[0] to dst[planes - 1] by the same weights.
+    template < typename _St1 >
+    void PixelWise(Plane_FL *const dst[], const _St1 *const src[], int planes, const Plane_FL &ref, int threads);
+
+    void WeightLUT_Init();
+
+    // Weight exp(-dist / strength^2) of a matched block or patch, looked up from WeightLUT with linear interpolation
+    FLType Weight(KeyType dist) const
+    {
+        const FLType pos = static_cast<FLType>(dist) * WeightLUT_Mul;
+        const LUT<FLType>::LevelType upper = WeightLUT.Levels() - 1;
+
+        if (pos <= 0) return WeightLUT[0];
+        if (pos >= upper) return WeightLUT[upper];
+
+        const LUT<FLType>::LevelType i = static_cast<LUT<FLType>::LevelType>(pos);
+        return WeightLUT[i] + (WeightLUT[i + 1] - WeightLUT[i]) * (pos - i);
+    }
+
+    // Soft threshold optimal correction of pixel X by testing staionarity,
+    // EX and VarX are the weighted mean and variance of the averaged pixels, VarN is the noise variance
+    static FLType Correction(FLType X, FLType EX, FLType VarX, FLType VarN)
+    {
+        // estimated_Y = EX + max(0, 1 - VarN / VarX) * (X - EX);
+        return VarX > VarN ? X - (VarN / VarX) * (X - EX) : EX;
+    }
+
+    // sumX1 and sumX2 are the scratch blocks of the weighted sums, with the same size as refBlock
     template < typename _St1 >
     void WeightedAverage(block_type &dstBlock, const block_type &refBlock, const _St1 &src,
-        const PosPairCode &code);
+        const PosPairCode &code, block_type &sumX1);
 
     template < typename _St1 >
     void WeightedAverage_Correction(block_type &dstBlock, const block_type &refBlock, const _St1 &src,
-        const PosPairCode &code);
+        const PosPairCode &code, block_type &sumX1, block_type &sumX2);
+
+    // Weighted averaging of the matched blocks in the frames of a sequence, src[z] is the plane of frame z,
+    // with the soft threshold optimal correction if para.correction is true
+    template < typename _St1 >
+    void WeightedAverage(block_type &dstBlock, const block_type &refBlock, const std::vector<const _St1 *> &src,
+        const Pos3PairCode &code, block_type &sumX1, block_type &sumX2);
 };
 
 
@@ -73,6 +215,9 @@ protected:
     NLMeans_Para para;
     std::string RPath;
 
+    std::unique_ptr<NLMeans> filter;
+    Frame ref;
+
     virtual void arguments_process()
     {
         _Mybase::arguments_process();
@@ -136,6 +281,41 @@ protected:
                 thMSE_def = true;
                 continue;
             }
+            if (args[i] == "-MA" || args[i] == "--BMalgorithm")
+            {
+                ArgsObj.GetPara(i, para.BMalgorithm);
+                continue;
+            }
+            if (args[i] == "-PR" || args[i] == "--PSrange")
+            {
+                ArgsObj.GetPara(i, para.PSrange);
+                continue;
+            }
+            if (args[i] == "-PN" || args[i] == "--PSnum")
+            {
+                ArgsObj.GetPara(i, para.PSnum);
+                continue;
+            }
+            if (args[i] == "-PF" || args[i] == "--PSfull")
+            {
+                ArgsObj.GetPara(i, para.PSfull);
+                continue;
+            }
+            if (args[i] == "-NT" || args[i] == "--threads")
+            {
+                ArgsObj.GetPara(i, para.threads);
+                continue;
+            }
+            if (args[i] == "-M" || args[i] == "--mode")
+            {
+                ArgsObj.GetPara(i, para.mode);
+                continue;
+            }
+            if (args[i] == "-TR" || args[i] == "--radius")
+            {
+                ArgsObj.GetPara(i, para.radius);
+                continue;
+            }
             if (args[i][0] == '-')
             {
                 i++;
@@ -147,26 +327,56 @@ protected:
 
         if (!strength_def) para.strength = para.correction ? para.sigma * 5 : para.sigma * 1.5;
         if (!thMSE_def) para.thMSE = para.correction ? para.sigma * 50 : para.sigma * 25;
+        para.radius = Max(PCType(0), para.radius);
+    }
+
+    virtual void prepare()
+    {
+        filter.reset(new NLMeans(para));
+
+        if (RPath.size() > 0)
+        {
+            ref = ImageReader(RPath);
+        }
     }
 
     virtual Frame process(const Frame &src)
     {
-        NLMeans filter(para);
+        // The images are filtered as a sequence, ref isn't used
+        if (para.radius > 0)
+        {
+            Frame dst;
+            filter->Push(src);
+            filter->Pop(dst);
+            return dst;
+        }
 
         if (RPath.size() == 0)
         {
-            return filter(src);
+            return (*filter)(src);
         }
         else
         {
-            const Frame ref = ImageReader(RPath);
-            return filter(src, ref);
+            return (*filter)(src, ref);
         }
     }
 
+    virtual Frame flush()
+    {
+        Frame dst;
+        filter->Finish();
+        filter->Pop(dst);
+        return dst;
+    }
+
 public:
     NLMeans_IO(std::string _Tag = ".NLMeans")
         : _Mybase(std::move(_Tag)) {}
+
+    virtual int Delay() const
+    {
+        return static_cast<int>(para.radius);
+    }
 };
 
 
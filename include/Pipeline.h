@@ -0,0 +1,46 @@
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+
+#include "Filter.h"
+
+
+// Chain several filters on in-memory frames, only the final result is written
+// Command line: ISP_MW --pipeline [pipeline options] --Filter1 [options of Filter1] --Filter2 [options of Filter2] ... input
+// Options before the first filter (--tag, --format, --list, --queue) belong to the pipeline itself,
+// options after a filter name belong to that filter.
+// The intermediate frames stay in 16-bit, instead of being quantized to 8-bit by the image files between processes.
+// The output tag defaults to the concatenation of the tags of all the stages.
+class Pipeline_IO
+    : public FilterIO
+{
+public:
+    typedef Pipeline_IO _Myt;
+    typedef FilterIO _Mybase;
+
+    // Create the FilterIO object from the filter name (e.g. "--BM3D"), return nullptr if unrecognized
+    typedef FilterIO *(*factory_type)(const std::string &FilterName);
+
+protected:
+    factory_type factory;
+
+    std::vector<std::string> names;
+    std::vector<std::unique_ptr<FilterIO>> stages;
+
+    // Accumulated processing time of each stage in seconds
+    std::vector<double> elapsed;
+    size_t frames = 0;
+
+    virtual void arguments_process() override;
+    virtual void prepare() override;
+    virtual void finish() override;
+    virtual Frame process(const Frame &src) override;
+
+public:
+    explicit Pipeline_IO(factory_type _factory, std::string _Tag = "")
+        : _Mybase(std::move(_Tag)), factory(_factory)
+    {}
+};
+
+
+#endif
@@ -0,0 +1,553 @@
+#ifndef PLANE_EXPR_HPP_
+#define PLANE_EXPR_HPP_
+
+
+#include <cmath>
+#include <type_traits>
+#include <utility>
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Lazy pixel-wise expressions of planes
+// The arithmetic operators and the Expr_* functions on planes, views and scalars only build an expression tree,
+// which is evaluated in a single pass when it's assigned to a plane, e.g.
+//     dst = (a - AL) / Expr_Max(tMapMin, tMapMax - b * mul) + AL;
+// reads a and b once and writes dst once, instead of a full pass over the planes for each operation.
+// Expr_Map applies any pixel-wise function object to 1-3 operands, for the operations not covered by the operators.
+// The operands are evaluated row by row with their own strides, thus planes of different layouts can be mixed,
+// and dst can also be an operand since each pixel only depends on the operand pixels at the same position.
+// The arithmetic follows the C++ rules of the operand types, and the result is converted to the value type of dst by static_cast.
+// Use ASSIGN_PPL(dst, expr) to evaluate it with the parallel loop.
+template < typename _Ex >
+struct PlaneExpr
+{
+    const _Ex &derived() const { return static_cast<const _Ex &>(*this); }
+};
+
+
+// Leaf of a plane, it refers to the memory of the plane
+template < typename _St1 >
+class PlaneExpr_Plane
+    : public PlaneExpr<PlaneExpr_Plane<_St1>>
+{
+public:
+    typedef typename _St1::value_type value_type;
+    typedef const value_type *row_type;
+
+private:
+    const value_type *data_;
+    PCType height_;
+    PCType width_;
+    PCType stride_;
+
+public:
+    explicit PlaneExpr_Plane(const _St1 &src)
+        : data_(src.data()), height_(src.Height()), width_(src.Width()), stride_(src.Stride())
+    {}
+
+    PCType Height() const { return height_; }
+    PCType Width() const { return width_; }
+    row_type Row(PCType j) const { return data_ + j * stride_; }
+};
+
+
+// Leaf of a scalar, its size is 0 which fits any plane
+template < typename _Ty >
+class PlaneExpr_Scalar
+    : public PlaneExpr<PlaneExpr_Scalar<_Ty>>
+{
+public:
+    typedef _Ty value_type;
+
+    struct row_type
+    {
+        value_type value;
+        value_type operator[](PCType) const { return value; }
+    };
+
+private:
+    value_type value_;
+
+public:
+    explicit PlaneExpr_Scalar(value_type _Value)
+        : value_(_Value)
+    {}
+
+    PCType Height() const { return 0; }
+    PCType Width() const { return 0; }
+    row_type Row(PCType) const { row_type row = { value_ }; return row; }
+};
+
+
+// Size of the non-scalar operands should be the same
+template < typename _E1, typename _E2 >
+void PlaneExpr_CheckSize(const _E1 &e1, const _E2 &e2)
+{
+    if (e1.Height() > 0 && e2.Height() > 0 && (e1.Height() != e2.Height() || e1.Width() != e2.Width()))
+    {
+        DEBUG_FAIL("PlaneExpr: Width() and Height() of the operands must be the same.");
+    }
+}
+
+
+template < typename _Fn1, typename _E1 >
+class PlaneExpr_Unary
+    : public PlaneExpr<PlaneExpr_Unary<_Fn1, _E1>>
+{
+public:
+    typedef typename std::decay<decltype(std::declval<const _Fn1 &>()(std::declval<typename _E1::value_type>()))>::type value_type;
+
+    struct row_type
+    {
+        _Fn1 func;
+        typename _E1::row_type row1;
+
+        value_type operator[](PCType i) const { return func(row1[i]); }
+    };
+
+private:
+    _Fn1 func_;
+    _E1 e1_;
+
+public:
+    PlaneExpr_Unary(const _Fn1 &_Func, const _E1 &e1)
+        : func_(_Func), e1_(e1)
+    {}
+
+    PCType Height() const { return e1_.Height(); }
+    PCType Width() const { return e1_.Width(); }
+    row_type Row(PCType j) const { row_type row = { func_, e1_.Row(j) }; return row; }
+};
+
+
+template < typename _Fn1, typename _E1, typename _E2 >
+class PlaneExpr_Binary
+    : public PlaneExpr<PlaneExpr_Binary<_Fn1, _E1, _E2>>
+{
+public:
+    typedef typename std::decay<decltype(std::declval<const _Fn1 &>()(std::declval<typename _E1::value_type>(),
+        std::declval<typename _E2::value_type>()))>::type value_type;
+
+    struct row_type
+    {
+        _Fn1 func;
+        typename _E1::row_type row1;
+        typename _E2::row_type row2;
+
+        value_type operator[](PCType i) const { return func(row1[i], row2[i]); }
+    };
+
+private:
+    _Fn1 func_;
+    _E1 e1_;
+    _E2 e2_;
+
+public:
+    PlaneExpr_Binary(const _Fn1 &_Func, const _E1 &e1, const _E2 &e2)
+        : func_(_Func), e1_(e1), e2_(e2)
+    {
+        PlaneExpr_CheckSize(e1_, e2_);
+    }
+
+    PCType Height() const { return e1_.Height() > 0 ? e1_.Height() : e2_.Height(); }
+    PCType Width() const { return e1_.Height() > 0 ? e1_.Width() : e2_.Width(); }
+    row_type Row(PCType j) const { row_type row = { func_, e1_.Row(j), e2_.Row(j) }; return row; }
+};
+
+
+template < typename _Fn1, typename _E1, typename _E2, typename _E3 >
+class PlaneExpr_Ternary
+    : public PlaneExpr<PlaneExpr_Ternary<_Fn1, _E1, _E2, _E3>>
+{
+public:
+    typedef typename std::decay<decltype(std::declval<const _Fn1 &>()(std::declval<typename _E1::value_type>(),
+        std::declval<typename _E2::value_type>(), std::declval<typename _E3::value_type>()))>::type value_type;
+
+    struct row_type
+    {
+        _Fn1 func;
+        typename _E1::row_type row1;
+        typename _E2::row_type row2;
+        typename _E3::row_type row3;
+
+        value_type operator[](PCType i) const { return func(row1[i], row2[i], row3[i]); }
+    };
+
+private:
+    _Fn1 func_;
+    _E1 e1_;
+    _E2 e2_;
+    _E3 e3_;
+
+public:
+    PlaneExpr_Ternary(const _Fn1 &_Func, const _E1 &e1, const _E2 &e2, const _E3 &e3)
+        : func_(_Func), e1_(e1), e2_(e2), e3_(e3)
+    {
+        PlaneExpr_CheckSize(e1_, e2_);
+        PlaneExpr_CheckSize(e1_, e3_);
+        PlaneExpr_CheckSize(e2_, e3_);
+    }
+
+    PCType Height() const { return e1_.Height() > 0 ? e1_.Height() : e2_.Height() > 0 ? e2_.Height() : e3_.Height(); }
+    PCType Width() const { return e1_.Height() > 0 ? e1_.Width() : e2_.Height() > 0 ? e2_.Width() : e3_.Width(); }
+    row_type Row(PCType j) const { row_type row = { func_, e1_.Row(j), e2_.Row(j), e3_.Row(j) }; return row; }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Operand kinds: 0 for not an operand, 1 for expression, 2 for plane, 3 for scalar
+template < typename _Ex > std::true_type _PlaneExpr_IsExpr(const PlaneExpr<_Ex> *);
+std::false_type _PlaneExpr_IsExpr(...);
+
+template < typename _Ty > std::true_type _PlaneExpr_IsPlane(const Plane_Int<_Ty> *);
+std::true_type _PlaneExpr_IsPlane(const Plane_FL *);
+std::false_type _PlaneExpr_IsPlane(...);
+
+template < typename _Ty >
+struct PlaneExpr_Kind
+{
+    typedef decltype(_PlaneExpr_IsExpr(static_cast<const _Ty *>(nullptr))) is_expr;
+    typedef decltype(_PlaneExpr_IsPlane(static_cast<const _Ty *>(nullptr))) is_plane;
+
+    static const int value = is_expr::value ? 1 : is_plane::value ? 2 : std::is_arithmetic<_Ty>::value ? 3 : 0;
+};
+
+
+template < typename _Ty, int _Kind = PlaneExpr_Kind<_Ty>::value >
+struct PlaneExpr_Wrap
+{};
+
+template < typename _Ty >
+struct PlaneExpr_Wrap<_Ty, 1>
+{
+    typedef _Ty type;
+    static const type &wrap(const _Ty &x) { return x; }
+};
+
+template < typename _Ex >
+struct PlaneExpr_Wrap<PlaneExpr<_Ex>, 1>
+{
+    typedef _Ex type;
+    static const type &wrap(const PlaneExpr<_Ex> &x) { return x.derived(); }
+};
+
+template < typename _Ty >
+struct PlaneExpr_Wrap<_Ty, 2>
+{
+    typedef PlaneExpr_Plane<_Ty> type;
+    static type wrap(const _Ty &x) { return type(x); }
+};
+
+template < typename _Ty >
+struct PlaneExpr_Wrap<_Ty, 3>
+{
+    typedef PlaneExpr_Scalar<_Ty> type;
+    static type wrap(const _Ty &x) { return type(x); }
+};
+
+
+// Expression types built from the operands, only defined when at least one operand is a plane or an expression
+template < typename _E1 >
+struct PlaneExpr_IsOperand
+{
+    static const bool value = PlaneExpr_Kind<_E1>::value == 1 || PlaneExpr_Kind<_E1>::value == 2;
+};
+
+template < typename _Fn1, typename _E1, bool = PlaneExpr_IsOperand<_E1>::value >
+struct PlaneExpr_UnaryOf
+{};
+
+template < typename _Fn1, typename _E1 >
+struct PlaneExpr_UnaryOf<_Fn1, _E1, true>
+{
+    typedef PlaneExpr_Unary<_Fn1, typename PlaneExpr_Wrap<_E1>::type> type;
+
+    static type make(const _Fn1 &_Func, const _E1 &e1)
+    {
+        return type(_Func, PlaneExpr_Wrap<_E1>::wrap(e1));
+    }
+};
+
+template < typename _Fn1, typename _E1, typename _E2,
+    bool = ((PlaneExpr_IsOperand<_E1>::value || PlaneExpr_IsOperand<_E2>::value)
+    && PlaneExpr_Kind<_E1>::value != 0 && PlaneExpr_Kind<_E2>::value != 0) >
+struct PlaneExpr_BinaryOf
+{};
+
+template < typename _Fn1, typename _E1, typename _E2 >
+struct PlaneExpr_BinaryOf<_Fn1, _E1, _E2, true>
+{
+    typedef PlaneExpr_Binary<_Fn1, typename PlaneExpr_Wrap<_E1>::type, typename PlaneExpr_Wrap<_E2>::type> type;
+
+    static type make(const _Fn1 &_Func, const _E1 &e1, const _E2 &e2)
+    {
+        return type(_Func, PlaneExpr_Wrap<_E1>::wrap(e1), PlaneExpr_Wrap<_E2>::wrap(e2));
+    }
+};
+
+template < typename _Fn1, typename _E1, typename _E2, typename _E3,
+    bool = ((PlaneExpr_IsOperand<_E1>::value || PlaneExpr_IsOperand<_E2>::value || PlaneExpr_IsOperand<_E3>::value)
+    && PlaneExpr_Kind<_E1>::value != 0 && PlaneExpr_Kind<_E2>::value != 0 && PlaneExpr_Kind<_E3>::value != 0) >
+struct PlaneExpr_TernaryOf
+{};
+
+template < typename _Fn1, typename _E1, typename _E2, typename _E3 >
+struct PlaneExpr_TernaryOf<_Fn1, _E1, _E2, _E3, true>
+{
+    typedef PlaneExpr_Ternary<_Fn1, typename PlaneExpr_Wrap<_E1>::type,
+        typename PlaneExpr_Wrap<_E2>::type, typename PlaneExpr_Wrap<_E3>::type> type;
+
+    static type make(const _Fn1 &_Func, const _E1 &e1, const _E2 &e2, const _E3 &e3)
+    {
+        return type(_Func, PlaneExpr_Wrap<_E1>::wrap(e1), PlaneExpr_Wrap<_E2>::wrap(e2), PlaneExpr_Wrap<_E3>::wrap(e3));
+    }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Function objects of the pixel-wise operations, the same as the scalar functions in Helper.h
+struct PlaneExpr_Neg
+{
+    template < typename _Ty >
+    auto operator()(const _Ty &x) const -> decltype(-x) { return -x; }
+};
+
+struct PlaneExpr_Add
+{
+    template < typename _Ty1, typename _Ty2 >
+    auto operator()(const _Ty1 &a, const _Ty2 &b) const -> decltype(a + b) { return a + b; }
+};
+
+struct PlaneExpr_Sub
+{
+    template < typename _Ty1, typename _Ty2 >
+    auto operator()(const _Ty1 &a, const _Ty2 &b) const -> decltype(a - b) { return a - b; }
+};
+
+struct PlaneExpr_Mul
+{
+    template < typename _Ty1, typename _Ty2 >
+    auto operator()(const _Ty1 &a, const _Ty2 &b) const -> decltype(a * b) { return a * b; }
+};
+
+struct PlaneExpr_Div
+{
+    template < typename _Ty1, typename _Ty2 >
+    auto operator()(const _Ty1 &a, const _Ty2 &b) const -> decltype(a / b) { return a / b; }
+};
+
+struct PlaneExpr_Min
+{
+    template < typename _Ty1, typename _Ty2 >
+    auto operator()(const _Ty1 &a, const _Ty2 &b) const -> typename std::decay<decltype(b < a ? b : a)>::type { return b < a ? b : a; }
+};
+
+struct PlaneExpr_Max
+{
+    template < typename _Ty1, typename _Ty2 >
+    auto operator()(const _Ty1 &a, const _Ty2 &b) const -> typename std::decay<decltype(b > a ? b : a)>::type { return b > a ? b : a; }
+};
+
+struct PlaneExpr_Clip
+{
+    template < typename _Ty1, typename _Ty2, typename _Ty3 >
+    auto operator()(const _Ty1 &x, const _Ty2 &lower, const _Ty3 &upper) const -> typename std::decay<decltype(x <= lower ? lower : x >= upper ? upper : x)>::type
+    {
+        return x <= lower ? lower : x >= upper ? upper : x;
+    }
+};
+
+struct PlaneExpr_Abs
+{
+    template < typename _Ty >
+    auto operator()(const _Ty &x) const -> decltype(x < 0 ? -x : x) { return x < 0 ? -x : x; }
+};
+
+struct PlaneExpr_Sqrt
+{
+    template < typename _Ty >
+    auto operator()(const _Ty &x) const -> decltype(sqrt(x)) { return sqrt(x); }
+};
+
+struct PlaneExpr_Log
+{
+    template < typename _Ty >
+    auto operator()(const _Ty &x) const -> decltype(log(x)) { return log(x); }
+};
+
+struct PlaneExpr_Exp
+{
+    template < typename _Ty >
+    auto operator()(const _Ty &x) const -> decltype(exp(x)) { return exp(x); }
+};
+
+struct PlaneExpr_Pow
+{
+    template < typename _Ty1, typename _Ty2 >
+    auto operator()(const _Ty1 &x, const _Ty2 &y) const -> decltype(pow(x, y)) { return pow(x, y); }
+};
+
+
+// Operators and functions building the expressions
+template < typename _E1 > inline
+typename PlaneExpr_UnaryOf<PlaneExpr_Neg, _E1>::type operator-(const _E1 &e1)
+{
+    return PlaneExpr_UnaryOf<PlaneExpr_Neg, _E1>::make(PlaneExpr_Neg(), e1);
+}
+
+template < typename _E1, typename _E2 > inline
+typename PlaneExpr_BinaryOf<PlaneExpr_Add, _E1, _E2>::type operator+(const _E1 &e1, const _E2 &e2)
+{
+    return PlaneExpr_BinaryOf<PlaneExpr_Add, _E1, _E2>::make(PlaneExpr_Add(), e1, e2);
+}
+
+template < typename _E1, typename _E2 > inline
+typename PlaneExpr_BinaryOf<PlaneExpr_Sub, _E1, _E2>::type operator-(const _E1 &e1, const _E2 &e2)
+{
+    return PlaneExpr_BinaryOf<PlaneExpr_Sub, _E1, _E2>::make(PlaneExpr_Sub(), e1, e2);
+}
+
+template < typename _E1, typename _E2 > inline
+typename PlaneExpr_BinaryOf<PlaneExpr_Mul, _E1, _E2>::type operator*(const _E1 &e1, const _E2 &e2)
+{
+    return PlaneExpr_BinaryOf<PlaneExpr_Mul, _E1, _E2>::make(PlaneExpr_Mul(), e1, e2);
+}
+
+template < typename _E1, typename _E2 > inline
+typename PlaneExpr_BinaryOf<PlaneExpr_Div, _E1, _E2>::type operator/(const _E1 &e1, const _E2 &e2)
+{
+    return PlaneExpr_BinaryOf<PlaneExpr_Div, _E1, _E2>::make(PlaneExpr_Div(), e1, e2);
+}
+
+template < typename _E1, typename _E2 > inline
+typename PlaneExpr_BinaryOf<PlaneExpr_Min, _E1, _E2>::type Expr_Min(const _E1 &e1, const _E2 &e2)
+{
+    return PlaneExpr_BinaryOf<PlaneExpr_Min, _E1, _E2>::make(PlaneExpr_Min(), e1, e2);
+}
+
+template < typename _E1, typename _E2 > inline
+typename PlaneExpr_BinaryOf<PlaneExpr_Max, _E1, _E2>::type Expr_Max(const _E1 &e1, const _E2 &e2)
+{
+    return PlaneExpr_BinaryOf<PlaneExpr_Max, _E1, _E2>::make(PlaneExpr_Max(), e1, e2);
+}
+
+template < typename _E1, typename _E2, typename _E3 > inline
+typename PlaneExpr_TernaryOf<PlaneExpr_Clip, _E1, _E2, _E3>::type Expr_Clip(const _E1 &e1, const _E2 &lower, const _E3 &upper)
+{
+    return PlaneExpr_TernaryOf<PlaneExpr_Clip, _E1, _E2, _E3>::make(PlaneExpr_Clip(), e1, lower, upper);
+}
+
+template < typename _E1 > inline
+typename PlaneExpr_UnaryOf<PlaneExpr_Abs, _E1>::type Expr_Abs(const _E1 &e1)
+{
+    return PlaneExpr_UnaryOf<PlaneExpr_Abs, _E1>::make(PlaneExpr_Abs(), e1);
+}
+
+template < typename _E1 > inline
+typename PlaneExpr_UnaryOf<PlaneExpr_Sqrt, _E1>::type Expr_Sqrt(const _E1 &e1)
+{
+    return PlaneExpr_UnaryOf<PlaneExpr_Sqrt, _E1>::make(PlaneExpr_Sqrt(), e1);
+}
+
+template < typename _E1 > inline
+typename PlaneExpr_UnaryOf<PlaneExpr_Log, _E1>::type Expr_Log(const _E1 &e1)
+{
+    return PlaneExpr_UnaryOf<PlaneExpr_Log, _E1>::make(PlaneExpr_Log(), e1);
+}
+
+template < typename _E1 > inline
+typename PlaneExpr_UnaryOf<PlaneExpr_Exp, _E1>::type Expr_Exp(const _E1 &e1)
+{
+    return PlaneExpr_UnaryOf<PlaneExpr_Exp, _E1>::make(PlaneExpr_Exp(), e1);
+}
+
+template < typename _E1, typename _E2 > inline
+typename PlaneExpr_BinaryOf<PlaneExpr_Pow, _E1, _E2>::type Expr_Pow(const _E1 &e1, const _E2 &e2)
+{
+    return PlaneExpr_BinaryOf<PlaneExpr_Pow, _E1, _E2>::make(PlaneExpr_Pow(), e1, e2);
+}
+
+template < typename _Fn1, typename _E1 > inline
+typename PlaneExpr_UnaryOf<_Fn1, _E1>::type Expr_Map(const _Fn1 &_Func, const _E1 &e1)
+{
+    return PlaneExpr_UnaryOf<_Fn1, _E1>::make(_Func, e1);
+}
+
+template < typename _Fn1, typename _E1, typename _E2 > inline
+typename PlaneExpr_BinaryOf<_Fn1, _E1, _E2>::type Expr_Map(const _Fn1 &_Func, const _E1 &e1, const _E2 &e2)
+{
+    return PlaneExpr_BinaryOf<_Fn1, _E1, _E2>::make(_Func, e1, e2);
+}
+
+template < typename _Fn1, typename _E1, typename _E2, typename _E3 > inline
+typename PlaneExpr_TernaryOf<_Fn1, _E1, _E2, _E3>::type Expr_Map(const _Fn1 &_Func, const _E1 &e1, const _E2 &e2, const _E3 &e3)
+{
+    return PlaneExpr_TernaryOf<_Fn1, _E1, _E2, _E3>::make(_Func, e1, e2, e3);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Evaluation of the expressions
+#define ASSIGN _Assign
+
+#ifdef ENABLE_PPL
+#define ASSIGN_PPL _Assign_PPL
+#else
+#define ASSIGN_PPL ASSIGN
+#endif
+
+
+template < typename _Dt1, typename _Ex >
+void _Assign_Row(_Dt1 &dst, const _Ex &expr, PCType j)
+{
+    typedef typename _Dt1::value_type value_type;
+
+    const PCType width = dst.Width();
+    value_type *dstp = dst.data() + j * dst.Stride();
+    const typename _Ex::row_type row = expr.Row(j);
+
+    for (PCType i = 0; i < width; ++i)
+    {
+        dstp[i] = static_cast<value_type>(row[i]);
+    }
+}
+
+template < typename _Dt1, typename _Ex >
+void _Assign(_Dt1 &dst, const PlaneExpr<_Ex> &expr)
+{
+    const _Ex &e = expr.derived();
+    PlaneExpr_CheckSize(PlaneExpr_Plane<_Dt1>(dst), e);
+
+    LOOP_V(dst.Height(), [&](PCType j)
+    {
+        _Assign_Row(dst, e, j);
+    });
+}
+
+#ifdef ENABLE_PPL
+template < typename _Dt1, typename _Ex >
+void _Assign_PPL(_Dt1 &dst, const PlaneExpr<_Ex> &expr)
+{
+    const _Ex &e = expr.derived();
+    PlaneExpr_CheckSize(PlaneExpr_Plane<_Dt1>(dst), e);
+
+    LOOP_V_PPL(dst.Height(), [&](PCType j)
+    {
+        _Assign_Row(dst, e, j);
+    });
+}
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#endif
@@ -230,6 +230,8 @@ public:
     typedef Retinex_MSR_IO _Mybase;
 
 protected:
+    std::unique_ptr<Retinex_MSRCP> filter;
+
     virtual void arguments_process()
     {
         _Mybase::arguments_process();
@@ -253,10 +255,14 @@ protected:
         ArgsObj.Check();
     }
 
+    virtual void prepare()
+    {
+        filter.reset(new Retinex_MSRCP(para));
+    }
+
     virtual Frame process(const Frame &src)
     {
-        Retinex_MSRCP filter(para);
-        return filter(src);
+        return (*filter)(src);
     }
 
 public:
@@ -273,6 +279,8 @@ public:
     typedef Retinex_MSR_IO _Mybase;
 
 protected:
+    std::unique_ptr<Retinex_MSRCR> filter;
+
     virtual void arguments_process()
     {
         _Mybase::arguments_process();
@@ -296,10 +304,14 @@ protected:
         ArgsObj.Check();
     }
 
+    virtual void prepare()
+    {
+        filter.reset(new Retinex_MSRCR(para));
+    }
+
     virtual Frame process(const Frame &src)
     {
-        Retinex_MSRCR filter(para);
-        return filter(src);
+        return (*filter)(src);
     }
 
 public:
@@ -316,6 +328,8 @@ public:
     typedef Retinex_MSR_IO _Mybase;
 
 protected:
+    std::unique_ptr<Retinex_MSRCR_GIMP> filter;
+
     virtual void arguments_process()
     {
         _Mybase::arguments_process();
@@ -339,10 +353,14 @@ protected:
         ArgsObj.Check();
     }
 
+    virtual void prepare()
+    {
+        filter.reset(new Retinex_MSRCR_GIMP(para));
+    }
+
     virtual Frame process(const Frame &src)
     {
-        Retinex_MSRCR_GIMP filter(para);
-        return filter(src);
+        return (*filter)(src);
     }
 
 public:
@@ -0,0 +1,208 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include "Type.h"
+#include "Helper.h"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Portable thread pool based on std::thread
+// The calling thread always takes part in the work, thus a pool with N worker threads runs up to N + 1 tasks concurrently
+class ThreadPool
+{
+public:
+    typedef ThreadPool _Myt;
+    typedef std::function<void()> task_type;
+
+private:
+    std::vector<std::thread> workers_;
+    std::deque<task_type> tasks_;
+    std::mutex mutex_;
+    std::condition_variable task_cond_;
+    std::condition_variable done_cond_;
+    bool stop_ = false;
+
+    void WorkerLoop();
+
+    // Run queued tasks in the calling thread until pending reaches 0
+    void Wait(const std::atomic<int> &pending);
+
+public:
+    // _Threads is the total number of concurrent threads including the calling thread, 0 for hardware concurrency
+    explicit ThreadPool(int _Threads = 0);
+
+    ThreadPool(const _Myt &src) = delete;
+    ThreadPool(_Myt &&src) = delete;
+    _Myt &operator=(const _Myt &src) = delete;
+    _Myt &operator=(_Myt &&src) = delete;
+
+    ~ThreadPool();
+
+    int Threads() const { return static_cast<int>(workers_.size()) + 1; }
+
+    void Submit(task_type task);
+
+    // Call _Func(p) for each p in [lower, upper), return after all the calls are finished
+    // threads limits the number of concurrent threads, 0 for all the threads of the pool
+    template < typename _Fn1 >
+    void parallel_for(PCType lower, PCType upper, _Fn1 &&_Func, int threads = 0);
+
+    static int HardwareThreads();
+
+    // Process-wide pool shared by all the filters
+    static _Myt &Default();
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Number of threads used by the *_PPL loop helpers in Image_Type.hpp, 0 for all the hardware threads
+// With the thread pool backend, it's limited by the size of ThreadPool::Default()
+int PPL_Threads();
+void PPL_SetThreads(int threads);
+
+// Actual number of concurrent threads of the *_PPL loop helpers
+int PPL_Concurrency();
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+template < typename _Fn1 >
+void ThreadPool::parallel_for(PCType lower, PCType upper, _Fn1 &&_Func, int threads)
+{
+    if (upper <= lower)
+    {
+        return;
+    }
+
+    int tasks = threads <= 0 ? Threads() : Min(threads, Threads());
+    tasks = static_cast<int>(Min(static_cast<PCType>(tasks), upper - lower));
+
+    if (tasks <= 1)
+    {
+        for (PCType p = lower; p < upper; ++p)
+        {
+            _Func(p);
+        }
+
+        return;
+    }
+
+    std::atomic<PCType> next(lower);
+    std::atomic<int> pending(tasks - 1);
+
+    auto run = [&]()
+    {
+        for (PCType p = next++; p < upper; p = next++)
+        {
+            _Func(p);
+        }
+    };
+
+    for (int t = 1; t < tasks; ++t)
+    {
+        Submit([&]()
+        {
+            run();
+            --pending;
+        });
+    }
+
+    run();
+    Wait(pending);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Blocking FIFO queue with bounded capacity, used to pass items between producer and consumer threads
+// push() blocks while the queue is full, pop() blocks while the queue is empty and not closed
+template < typename _Ty >
+class BoundedQueue
+{
+public:
+    typedef BoundedQueue<_Ty> _Myt;
+    typedef _Ty value_type;
+
+private:
+    size_t capacity_;
+    std::deque<value_type> items_;
+    std::mutex mutex_;
+    std::condition_variable push_cond_;
+    std::condition_variable pop_cond_;
+    bool closed_ = false;
+
+public:
+    explicit BoundedQueue(size_t _Capacity = 1)
+        : capacity_(_Capacity > 0 ? _Capacity : 1)
+    {}
+
+    BoundedQueue(const _Myt &src) = delete;
+    _Myt &operator=(const _Myt &src) = delete;
+
+    // Return false if the queue is closed, and the item is dropped
+    bool push(value_type item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        push_cond_.wait(lock, [this]() { return closed_ || items_.size() < capacity_; });
+
+        if (closed_)
+        {
+            return false;
+        }
+
+        items_.push_back(std::move(item));
+        lock.unlock();
+        pop_cond_.notify_one();
+        return true;
+    }
+
+    // Return false if the queue is closed and empty
+    bool pop(value_type &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        pop_cond_.wait(lock, [this]() { return closed_ || !items_.empty(); });
+
+        if (items_.empty())
+        {
+            return false;
+        }
+
+        item = std::move(items_.front());
+        items_.pop_front();
+        lock.unlock();
+        push_cond_.notify_one();
+        return true;
+    }
+
+    // No more items will be pushed, the remaining items can still be popped
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+
+        push_cond_.notify_all();
+        pop_cond_.notify_all();
+    }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef VBM3D_H_
+#define VBM3D_H_
+
+
+#include <deque>
+#include "BM3D.h"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+const struct VBM3D_Para
+    : public BM3D_Para
+{
+    typedef VBM3D_Para _Myt;
+    typedef BM3D_Para _Mybase;
+
+    PCType radius;
+
+    VBM3D_Para(std::string _profile = "fast")
+        : _Mybase(_profile)
+    {
+        radius = 2; // Temporal radius, each group takes blocks from the 2 * radius + 1 frames around the current frame
+    }
+} VBM3D_Default;
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Video BM3D: both the basic estimate and the final estimate of each frame are computed by temporal filtering
+// of the frames within radius, see BM3D_Base::Kernel(Plane_FL *const dst[], const PlaneSeq src[], ...).
+// Frames are pushed in order, the filtered frames are popped in the same order with a delay of 2 * radius frames.
+// The YUV planes of the source frames and the basic estimates are kept in a ring buffer of 3 * radius + 1 frames,
+// thus each frame is converted from RGB only once and filtered by each stage only once.
+class VBM3D
+{
+public:
+    typedef VBM3D _Myt;
+
+protected:
+    struct Slot
+    {
+        Plane_FL src[3];
+        Plane_FL basic[3];
+        Frame dst;
+    };
+
+    PCType radius;
+    BM3D_Basic basic;
+    BM3D_Final final;
+
+    std::vector<Slot> ring;
+    std::deque<Frame> output;
+
+    PCType pushed = 0;
+    PCType basicDone = 0;
+    PCType finalDone = 0;
+    bool finished = false;
+
+public:
+    VBM3D(const VBM3D_Para &_para = VBM3D_Default)
+        : radius(Max(PCType(0), _para.radius)), basic(_para.basic), final(_para.final),
+        ring(radius * 3 + 1)
+    {}
+
+    // Frame delay between Push() and Pop() before Finish() is called
+    PCType Delay() const
+    {
+        return radius * 2;
+    }
+
+    // Push the next RGB frame of the sequence, all the frames should have the same format
+    void Push(const Frame &src);
+
+    // Mark the end of the sequence, the remaining frames are filtered with the frames available
+    void Finish();
+
+    // Get the next filtered frame, return false if it's not available yet
+    bool Pop(Frame &dst);
+
+    // Start a new sequence
+    void Reset();
+
+    // Filter a whole sequence at once
+    std::vector<Frame> operator()(const std::vector<Frame> &src);
+
+protected:
+    Slot &GetSlot(PCType n)
+    {
+        return ring[n % ring.size()];
+    }
+
+    void Advance();
+    void ProcessBasic(PCType n);
+    void ProcessFinal(PCType n);
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+class VBM3D_IO
+    : public BM3D_IO
+{
+public:
+    typedef VBM3D_IO _Myt;
+    typedef BM3D_IO _Mybase;
+
+protected:
+    PCType radius = VBM3D_Default.radius;
+
+    std::unique_ptr<VBM3D> vfilter;
+
+    // Filtering time and number of the output frames, to report the throughput
+    double elapsed = 0;
+    size_t frames = 0;
+
+    virtual void arguments_process() override;
+    virtual void prepare() override;
+    virtual void finish() override;
+    virtual Frame process(const Frame &src) override;
+    virtual Frame flush() override;
+
+public:
+    VBM3D_IO(std::string _Tag = ".VBM3D")
+        : _Mybase(std::move(_Tag))
+    {}
+
+    virtual int Delay() const override
+    {
+        return static_cast<int>(radius * 2);
+    }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#endif
@@ -2,6 +2,13 @@
 #define FFTW3_HELPER_HPP_
 
 
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
 #include <fftw3.h>
 
 
@@ -1522,4 +1529,190 @@ typedef fftwh<float> fftwf;
 typedef fftwh<long double> fftwl;
 
 
+// Process-wide cache of FFTW plans keyed on (dimensions, kinds, flags)
+// Plans with the same shape are created only once and shared read-only,
+// they should be executed with the new-array execute functions, which are thread-safe.
+// Plans are created for in-place transform of arrays allocated by fftw_malloc (or with at least the same alignment).
+template < typename R = double >
+class fftwh_plan_cache
+{
+public:
+    typedef fftwh_plan_cache<R> _Myt;
+    typedef fftwh<R> fftw;
+    typedef typename fftw::plan plan;
+    typedef typename fftw::r2r_kind r2r_kind;
+    typedef std::shared_ptr<const plan> plan_ptr;
+
+private:
+    // plan type (0 for r2r, 1 for many_r2r_1d), dimensions (or n, howmany, stride, dist), kinds (or sign), flags
+    typedef std::tuple<int, std::vector<int>, std::vector<int>, unsigned> key_type;
+
+    std::mutex mutex_;
+    std::map<key_type, plan_ptr> plans_;
+
+    std::string wisdom_file_;
+    bool wisdom_dirty_ = false;
+
+    fftwh_plan_cache() {}
+
+public:
+    fftwh_plan_cache(const _Myt &right) = delete;
+    _Myt &operator=(const _Myt &right) = delete;
+
+    static _Myt &instance()
+    {
+        static _Myt cache;
+        return cache;
+    }
+
+    plan_ptr r2r(int rank, const int *n, const r2r_kind *kind, unsigned flags = FFTW_MEASURE)
+    {
+        key_type key(0, std::vector<int>(n, n + rank), std::vector<int>(kind, kind + rank), flags);
+
+        // FFTW planner is not thread-safe, thus planning is also guarded by the lock
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto iter = plans_.find(key);
+
+        if (iter != plans_.end())
+        {
+            return iter->second;
+        }
+
+        size_t count = 1;
+        for (int i = 0; i < rank; ++i) count *= n[i];
+
+        R *temp = nullptr;
+        fftw::malloc(temp, count);
+
+        std::shared_ptr<plan> p = std::make_shared<plan>();
+        p->r2r(rank, n, temp, temp, kind, flags);
+
+        fftw::free(temp);
+
+        plans_.emplace(key, p);
+        wisdom_dirty_ = true;
+        return p;
+    }
+
+    plan_ptr r2r_1d(int n, r2r_kind kind, unsigned flags = FFTW_MEASURE)
+    {
+        return r2r(1, &n, &kind, flags);
+    }
+
+    // howmany 1D transforms of size n, whose elements are stride apart and whose first elements are dist apart
+    plan_ptr many_r2r_1d(int n, int howmany, int stride, int dist, r2r_kind kind, unsigned flags = FFTW_MEASURE)
+    {
+        key_type key(1, std::vector<int>({ n, howmany, stride, dist }), std::vector<int>(1, kind), flags);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto iter = plans_.find(key);
+
+        if (iter != plans_.end())
+        {
+            return iter->second;
+        }
+
+        size_t count = static_cast<size_t>(n - 1) * stride + static_cast<size_t>(howmany - 1) * dist + 1;
+
+        R *temp = nullptr;
+        fftw::malloc(temp, count);
+
+        std::shared_ptr<plan> p = std::make_shared<plan>();
+        p->many_r2r(1, &n, howmany, temp, nullptr, stride, dist, temp, nullptr, stride, dist, &kind, flags);
+
+        fftw::free(temp);
+
+        plans_.emplace(key, p);
+        wisdom_dirty_ = true;
+        return p;
+    }
+
+    plan_ptr r2r_2d(int n0, int n1, r2r_kind kind0, r2r_kind kind1, unsigned flags = FFTW_MEASURE)
+    {
+        const int n[2] = { n0, n1 };
+        const r2r_kind kind[2] = { kind0, kind1 };
+        return r2r(2, n, kind, flags);
+    }
+
+    plan_ptr r2r_3d(int n0, int n1, int n2, r2r_kind kind0, r2r_kind kind1, r2r_kind kind2, unsigned flags = FFTW_MEASURE)
+    {
+        const int n[3] = { n0, n1, n2 };
+        const r2r_kind kind[3] = { kind0, kind1, kind2 };
+        return r2r(3, n, kind, flags);
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return plans_.size();
+    }
+
+    // Release the plans not referenced outside the cache
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        plans_.clear();
+    }
+
+    // Path of the wisdom file specified by the environment variable ISP_MW_FFTW_WISDOM, empty if not set
+    static std::string wisdom_env()
+    {
+        std::string filename;
+#ifdef _MSC_VER
+        char *value = nullptr;
+        size_t len = 0;
+
+        if (_dupenv_s(&value, &len, "ISP_MW_FFTW_WISDOM") == 0 && value)
+        {
+            filename = value;
+            ::free(value);
+        }
+#else
+        const char *value = std::getenv("ISP_MW_FFTW_WISDOM");
+        if (value) filename = value;
+#endif
+        return filename;
+    }
+
+    // Import the wisdom file and remember it as the target of save_wisdom()
+    // An empty filename falls back to wisdom_env(), returns true if any wisdom is imported
+    // A missing file is not an error, it will be created by save_wisdom()
+    bool load_wisdom(std::string filename = "")
+    {
+        if (filename.empty())
+        {
+            filename = wisdom_env();
+        }
+
+        if (filename.empty())
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        wisdom_file_ = filename;
+        return fftw::import_wisdom_from_filename(filename.c_str()) != 0;
+    }
+
+    // Export the accumulated wisdom to the file of load_wisdom()
+    // Only written when new plans are created since the last load or save, unless force is true
+    bool save_wisdom(bool force = false)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (wisdom_file_.empty() || (!force && !wisdom_dirty_))
+        {
+            return false;
+        }
+
+        fftw::export_wisdom_to_filename(wisdom_file_.c_str());
+        wisdom_dirty_ = false;
+        return true;
+    }
+};
+
+
 #endif
@@ -1,8 +1,6 @@
 cd /d "%~dp0"
 
-FOR %%i IN (%*) DO (
-    ISP_MW --BM3D --profile lc --sigma 10.0 %%i
-)
+ISP_MW --BM3D --profile lc --sigma 10.0 %*
 
 pause
 
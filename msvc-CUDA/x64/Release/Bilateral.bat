@@ -1,7 +1,5 @@
 cd /d "%~dp0"
 
-FOR %%i IN (%*) DO (
-    ISP_MW --Bilateral --sigmaS 3.0 --sigmaR 0.02 %%i
-)
+ISP_MW --Bilateral --sigmaS 3.0 --sigmaR 0.02 %*
 
 pause
\ No newline at end of file
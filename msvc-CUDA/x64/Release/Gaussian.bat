@@ -1,7 +1,5 @@
 cd /d "%~dp0"
 
-FOR %%i IN (%*) DO (
-    ISP_MW --Gaussian --sigma 3.0 %%i
-)
+ISP_MW --Gaussian --sigma 3.0 %*
 
 pause
\ No newline at end of file
@@ -1,7 +1,5 @@
 cd /d "%~dp0"
 
-FOR %%i IN (%*) DO (
-    ISP_MW --Retinex_MSRCP --sigma 15 --sigma 80 --lower_thr 0.01 --upper_thr 0.01 %%i
-)
+ISP_MW --Retinex_MSRCP --sigma 15 --sigma 80 --lower_thr 0.01 --upper_thr 0.01 %*
 
 pause
\ No newline at end of file
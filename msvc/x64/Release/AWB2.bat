@@ -1,7 +1,5 @@
 cd /d "%~dp0"
 
-FOR %%i IN (%*) DO (
-    ISP_MW --AWB2 %%i
-)
+ISP_MW --AWB2 %*
 
 pause
\ No newline at end of file
@@ -1,7 +1,5 @@
 cd /d "%~dp0"
 
-FOR %%i IN (%*) DO (
-    ISP_MW --AGTM %%i
-)
+ISP_MW --AGTM %*
 
 pause
\ No newline at end of file
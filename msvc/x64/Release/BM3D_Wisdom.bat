@@ -0,0 +1,7 @@
+cd /d "%~dp0"
+
+rem Plan all the BM3D profiles once and save the FFTW wisdom next to ISP_MW,
+rem later runs load it with "--wisdom BM3D.wisdom" or by setting ISP_MW_FFTW_WISDOM to its path
+ISP_MW --fftw_wisdom BM3D.wisdom
+
+pause
\ No newline at end of file
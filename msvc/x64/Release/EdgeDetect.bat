@@ -1,7 +1,5 @@
 cd /d "%~dp0"
 
-FOR %%i IN (%*) DO (
-    ISP_MW --EdgeDetect --kernel Sobel %%i
-)
+ISP_MW --EdgeDetect --kernel Sobel %*
 
 pause
\ No newline at end of file
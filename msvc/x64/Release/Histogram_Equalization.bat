@@ -1,7 +1,5 @@
 cd /d "%~dp0"
 
-FOR %%i IN (%*) DO (
-    ISP_MW --HE --strength 0.5 --separate false %%i
-)
+ISP_MW --HE --strength 0.5 --separate false %*
 
 pause
\ No newline at end of file
@@ -1,7 +1,5 @@
 cd /d "%~dp0"
 
-FOR %%i IN (%*) DO (
-    ISP_MW --HE --tag .HECB --strength 0.5 --separate true %%i
-)
+ISP_MW --HE --tag .HECB --strength 0.5 --separate true %*
 
 pause
\ No newline at end of file
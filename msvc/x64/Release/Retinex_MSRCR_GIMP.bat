@@ -1,7 +1,5 @@
 cd /d "%~dp0"
 
-FOR %%i IN (%*) DO (
-    ISP_MW --Retinex_MSRCR_GIMP --sigma 15 --sigma 250 --dynamic 10 %%i
-)
+ISP_MW --Retinex_MSRCR_GIMP --sigma 15 --sigma 250 --dynamic 10 %*
 
 pause
\ No newline at end of file
@@ -6,233 +6,1100 @@
 // Functions of struct BM3D_FilterData
 
 
-BM3D_FilterData::BM3D_FilterData(bool wiener, double sigma, PCType GroupSize, PCType BlockSize, double lambda)
-    : fp(GroupSize), bp(GroupSize), finalAMP(GroupSize), thrTable(wiener ? 0 : GroupSize),
+BM3D_FilterData::BM3D_FilterData(bool wiener, double sigma, PCType GroupSize, PCType BlockSize, double lambda,
+    bool separable, int GroupTransform)
+    : transform(GroupTransform), fp(transform == 0 && !separable ? GroupSize : 0), bp(transform == 0 ? GroupSize : 0),
+    fp1d(transform == 0 && separable ? GroupSize : 0), finalAMP(GroupSize), thrTable(wiener ? 0 : GroupSize),
     wienerSigmaSqr(wiener ? GroupSize : 0)
 {
     const unsigned int flags = FFTW_PATIENT;
     const fftw::r2r_kind fkind = FFTW_REDFT10;
     const fftw::r2r_kind bkind = FFTW_REDFT01;
 
-    FLType *temp = nullptr;
+    plan_cache &cache = plan_cache::instance();
+
+    // The separable transform is the same as the 3D transform, except for the rounding errors
+    // The 2D plans are executed on each block of a group, which may be not aligned for odd BlockSize
+    if (separable || transform != 0)
+    {
+        const unsigned int flags2d = BlockSize * BlockSize * sizeof(FLType) % 16 == 0 ? flags : flags | FFTW_UNALIGNED;
+
+        fp2d = cache.r2r_2d(BlockSize, BlockSize, fkind, fkind, flags2d);
+
+        if (transform != 0)
+        {
+            bp2d = cache.r2r_2d(BlockSize, BlockSize, bkind, bkind, flags2d);
+        }
+    }
 
     for (PCType i = 1; i <= GroupSize; ++i)
     {
-        AlignedMalloc(temp, i * BlockSize * BlockSize);
-        fp[i - 1].r2r_3d(i, BlockSize, BlockSize, temp, temp, fkind, fkind, fkind, flags);
-        bp[i - 1].r2r_3d(i, BlockSize, BlockSize, temp, temp, bkind, bkind, bkind, flags);
-        AlignedFree(temp);
+        if (transform == 0)
+        {
+            if (separable)
+            {
+                fp1d[i - 1] = cache.many_r2r_1d(i, BlockSize * BlockSize, BlockSize * BlockSize, 1, fkind, flags);
+            }
+            else
+            {
+                fp[i - 1] = cache.r2r_3d(i, BlockSize, BlockSize, fkind, fkind, fkind, flags);
+            }
+
+            bp[i - 1] = cache.r2r_3d(i, BlockSize, BlockSize, bkind, bkind, bkind, flags);
+        }
+
+        // The orthonormal Haar and Walsh-Hadamard transforms don't amplify the group
+        finalAMP[i - 1] = (transform == 0 ? 2 * i : 1) * 2 * BlockSize * 2 * BlockSize;
+        double forwardAMP = sqrt(finalAMP[i - 1]);
+
+        if (wiener)
+        {
+            wienerSigmaSqr[i - 1] = static_cast<FLType>(sigma * forwardAMP * sigma * forwardAMP);
+        }
+        else
+        {
+            double thrBase = sigma * lambda * forwardAMP;
+            std::vector<double> thr(4);
+
+            thr[0] = thrBase;
+            thr[1] = thrBase * sqrt(double(2));
+            thr[2] = thrBase * double(2);
+            thr[3] = thrBase * sqrt(double(8));
+
+            thrTable[i - 1] = std::vector<FLType>(i * BlockSize * BlockSize);
+            auto thr_d = thrTable[i - 1].data();
+
+            for (PCType z = 0; z < i; ++z)
+            {
+                for (PCType y = 0; y < BlockSize; ++y)
+                {
+                    for (PCType x = 0; x < BlockSize; ++x, ++thr_d)
+                    {
+                        int flag = 0;
+
+                        if (x == 0)
+                        {
+                            ++flag;
+                        }
+                        if (y == 0)
+                        {
+                            ++flag;
+                        }
+                        if (z == 0 && transform == 0)
+                        {
+                            ++flag;
+                        }
+
+                        *thr_d = static_cast<FLType>(thr[flag]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions of the 1D transforms along the group
+
+
+// Orthonormal butterfly of the blocks of size pixels at a and b
+static void Butterfly(FLType *a, FLType *b, PCType size)
+{
+    const FLType norm = static_cast<FLType>(1 / sqrt(2.0));
+
+    for (PCType i = 0; i < size; ++i)
+    {
+        const FLType x = a[i];
+        const FLType y = b[i];
+
+        a[i] = (x + y) * norm;
+        b[i] = (x - y) * norm;
+    }
+}
+
+
+// In-place orthonormal transforms along the group of count blocks of size pixels, count must be a power of 2
+// The coefficients are left in the order of the butterflies instead of the sequency order,
+// which doesn't matter since the filters treat each coefficient of the group alike.
+static void HaarForward(FLType *data, PCType count, PCType size)
+{
+    // Each level transforms the scaling coefficients of the previous level
+    for (PCType h = 1; h < count; h *= 2)
+    {
+        for (PCType z = 0; z < count; z += h * 2)
+        {
+            Butterfly(data + z * size, data + (z + h) * size, size);
+        }
+    }
+}
+
+static void HaarBackward(FLType *data, PCType count, PCType size)
+{
+    // The butterfly is its own inverse, thus the levels are applied in the reverse order
+    for (PCType h = count / 2; h >= 1; h /= 2)
+    {
+        for (PCType z = 0; z < count; z += h * 2)
+        {
+            Butterfly(data + z * size, data + (z + h) * size, size);
+        }
+    }
+}
+
+// The orthonormal Walsh-Hadamard transform is its own inverse
+static void WalshHadamard(FLType *data, PCType count, PCType size)
+{
+    for (PCType h = 1; h < count; h *= 2)
+    {
+        for (PCType z = 0; z < count; z += h * 2)
+        {
+            for (PCType k = z; k < z + h; ++k)
+            {
+                Butterfly(data + k * size, data + (k + h) * size, size);
+            }
+        }
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions for tiled processing
+
+
+// View of rect in the plane of the whole image
+static PlaneView TileView(const Plane &src, const BM3D_Base::TileRect &rect)
+{
+    return PlaneView(src, rect.top, rect.left, rect.Height(), rect.Width());
+}
+
+
+// Convert region of the YUV planes of tile to the RGB planes of dst
+static void StoreTile(Frame &dst, const Plane_FL &srcY, const Plane_FL &srcU, const Plane_FL &srcV,
+    const BM3D_Base::TileRect &tile, const BM3D_Base::TileRect &region)
+{
+    const PCType top = region.top - tile.top;
+    const PCType left = region.left - tile.left;
+
+    PlaneView dstR = TileView(dst.R(), region);
+    PlaneView dstG = TileView(dst.G(), region);
+    PlaneView dstB = TileView(dst.B(), region);
+
+    MatrixConvert_YUV2RGB(dstR, dstG, dstB,
+        PlaneView_FL(srcY, top, left, region.Height(), region.Width()),
+        PlaneView_FL(srcU, top, left, region.Height(), region.Width()),
+        PlaneView_FL(srcV, top, left, region.Height(), region.Width()),
+        ColorMatrix::OPP, true);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions of class BM3D_Base
+
+
+void BM3D_Base::Kernel(Plane_FL &dst, const Plane_FL &src, const Plane_FL &ref) const
+{
+    if (para.sigma[0] <= 0 || para.GroupSize == 0 || para.BlockSize <= 0
+        || para.BMrange <= 0 || para.BMrange < para.BMstep || para.thMSE <= 0)
+    {
+        dst = src;
+        return;
+    }
+
+    Plane_FL ResNum(src, true, 0);
+    Plane_FL ResDen(src, true, 0);
+
+    Plane_FL *const ResNumP[3] = { &ResNum, nullptr, nullptr };
+    Plane_FL *const ResDenP[3] = { &ResDen, nullptr, nullptr };
+    const Plane_FL *const srcP[3] = { &src, nullptr, nullptr };
+    const Plane_FL *const refP[3] = { &ref, nullptr, nullptr };
+
+    Kernel(1, ResNumP, ResDenP, srcP, refP, RefBlockPos(src.Height(), src.Width()));
+
+    // The filtered blocks are sumed and averaged to form the final filtered image
+    dst.ReSize(src.Width(), src.Height());
+
+    dst = ResNum / ResDen;
+}
+
+
+void BM3D_Base::Kernel(Plane_FL &dstY, Plane_FL &dstU, Plane_FL &dstV,
+    const Plane_FL &srcY, const Plane_FL &srcU, const Plane_FL &srcV,
+    const Plane_FL &refY, const Plane_FL &refU, const Plane_FL &refV) const
+{
+    Kernel(dstY, dstU, dstV, srcY, srcU, srcV, refY, refU, refV,
+        RefBlockPos(srcY.Height(), srcY.Width()));
+}
+
+
+void BM3D_Base::Kernel(Plane_FL &dstY, Plane_FL &dstU, Plane_FL &dstV,
+    const Plane_FL &srcY, const Plane_FL &srcU, const Plane_FL &srcV,
+    const Plane_FL &refY, const Plane_FL &refU, const Plane_FL &refV,
+    PCType height, PCType width, const TileRect &tile, const TileRect &region) const
+{
+    if (srcY.Height() != tile.Height() || srcY.Width() != tile.Width())
+    {
+        DEBUG_FAIL("BM3D_Base::Kernel: size of the planes must be the same as tile.");
+    }
+
+    Kernel(dstY, dstU, dstV, srcY, srcU, srcV, refY, refU, refV,
+        RefBlockPos(height, width, tile, region));
+}
+
+
+void BM3D_Base::Kernel(Plane_FL &dstY, Plane_FL &dstU, Plane_FL &dstV,
+    const Plane_FL &srcY, const Plane_FL &srcU, const Plane_FL &srcV,
+    const Plane_FL &refY, const Plane_FL &refU, const Plane_FL &refV,
+    const std::vector<PosCode> &refPos) const
+{
+    if (Skip())
+    {
+        dstY = srcY;
+        dstU = srcU;
+        dstV = srcV;
+        return;
+    }
+
+    Plane_FL ResNumY(srcY, true, 0);
+    Plane_FL ResDenY(srcY, true, 0);
+    Plane_FL ResNumU(srcU, true, 0);
+    Plane_FL ResDenU(srcU, true, 0);
+    Plane_FL ResNumV(srcV, true, 0);
+    Plane_FL ResDenV(srcV, true, 0);
+
+    Plane_FL *const ResNumP[3] = { &ResNumY, &ResNumU, &ResNumV };
+    Plane_FL *const ResDenP[3] = { &ResDenY, &ResDenU, &ResDenV };
+    const Plane_FL *const srcP[3] = { &srcY, &srcU, &srcV };
+    const Plane_FL *const refP[3] = { &refY, &refU, &refV };
+
+    int mask = 0;
+    if (para.sigma[0] > 0) mask |= 1;
+    if (para.sigma[1] > 0) mask |= 2;
+    if (para.sigma[2] > 0) mask |= 4;
+
+    Kernel(mask, ResNumP, ResDenP, srcP, refP, refPos);
+
+    // The filtered blocks are sumed and averaged to form the final filtered image
+    PCType height = srcY.Height();
+    PCType width = srcY.Width();
+
+    dstY.ReSize(width, height);
+    dstU.ReSize(width, height);
+    dstV.ReSize(width, height);
+
+    if (para.sigma[0] > 0) dstY = ResNumY / ResDenY;
+    if (para.sigma[1] > 0) dstU = ResNumU / ResDenU;
+    if (para.sigma[2] > 0) dstV = ResNumV / ResDenV;
+}
+
+
+std::vector<BM3D_Base::PosCode> BM3D_Base::RefBlockPos(PCType height, PCType width) const
+{
+    return BlockScanPos(height, width, para.BlockSize, para.BlockStep);
+}
+
+
+std::vector<BM3D_Base::PosCode> BM3D_Base::RefBlockPos(PCType height, PCType width,
+    const TileRect &tile, const TileRect &region) const
+{
+    // A block matched by the reference block at p lies in [p - BMrange, p + BMrange + BlockSize),
+    // thus the reference blocks in [region - BMrange - BlockSize + 1, region + BMrange) may cover the region
+    const PCType lower = para.BMrange + para.BlockSize - 1;
+    const PCType upper = para.BMrange;
+
+    auto select = [&](PCType length, PCType first, PCType last, PCType origin) -> std::vector<PCType>
+    {
+        std::vector<PCType> linePos;
+
+        for (auto p : BlockScanLine(length, para.BlockSize, para.BlockStep))
+        {
+            if (p >= first - lower && p < last + upper)
+            {
+                linePos.push_back(p - origin);
+            }
+        }
+
+        return linePos;
+    };
+
+    const std::vector<PCType> rows = select(height, region.top, region.bottom, tile.top);
+    const std::vector<PCType> cols = select(width, region.left, region.right, tile.left);
+
+    std::vector<PosCode> refPos(rows.size());
+
+    for (size_t r = 0; r < rows.size(); ++r)
+    {
+        refPos[r].reserve(cols.size());
+
+        for (auto i : cols)
+        {
+            refPos[r].push_back(PosType(rows[r], i));
+        }
+    }
+
+    return refPos;
+}
+
+
+PCType BM3D_Base::TileSize(PCType height, PCType width, PCType halo) const
+{
+    if (para.MemoryLimit == 0)
+    {
+        return 0;
+    }
+
+    const double pixels = static_cast<double>(para.MemoryLimit) * (1 << 20) / (TilePlanes * sizeof(FLType));
+
+    if (pixels >= static_cast<double>(height) * width)
+    {
+        return 0;
+    }
+
+    // The overlap dominates when the tile is smaller than the halo, thus a small limit may be exceeded
+    const PCType tileSize = Max(static_cast<PCType>(sqrt(pixels)) - halo * 2, halo);
+
+    return tileSize >= height && tileSize >= width ? 0 : tileSize;
+}
+
+
+void BM3D_Base::Kernel(int mask, Plane_FL *const ResNum[], Plane_FL *const ResDen[],
+    const Plane_FL *const src[], const Plane_FL *const ref[], const std::vector<PosCode> &refPos) const
+{
+    const int threads = para.threads > 0 ? para.threads : ThreadPool::Default().Threads();
+
+    // Match all the reference blocks in advance for incremental sliding-window SSD, predictive search,
+    // or on the quantized copy of ref, which is discarded after matching
+    std::vector<PosPairCode> matchCodes;
+
+    if (para.GroupSize != 1 && para.thMSE > 0)
+    {
+        if (para.BMdepth > 8)
+        {
+            BlockMatching(matchCodes, Plane_16(*ref[0], para.BMdepth), refPos, threads);
+        }
+        else if (para.BMdepth > 0)
+        {
+            BlockMatching(matchCodes, Plane_8(*ref[0], para.BMdepth), refPos, threads);
+        }
+        else if (para.BMalgorithm == 1 || para.BMalgorithm == 2)
+        {
+            BlockMatching(matchCodes, *ref[0], refPos, threads);
+        }
+    }
+
+    if (threads > 1 || para.TransformCache)
+    {
+        Kernel_Parallel(mask, ResNum, ResDen, src, ref, refPos, matchCodes, threads);
+    }
+    else
+    {
+        Kernel_Serial(mask, ResNum, ResDen, src, ref, refPos, matchCodes);
+    }
+}
+
+
+void BM3D_Base::Kernel_Serial(int mask, Plane_FL *const ResNum[], Plane_FL *const ResDen[],
+    const Plane_FL *const src[], const Plane_FL *const ref[],
+    const std::vector<PosCode> &refPos, const std::vector<PosPairCode> &matchCodes) const
+{
+    FilteredGroup filtered;
+    PosPairCode tempCode;
+    size_t index = 0;
+
+    for (const auto &rowPos : refPos)
+    {
+        for (auto pos : rowPos)
+        {
+            const PosPairCode &matchCode = matchCodes.empty()
+                ? (tempCode = BlockMatching(*ref[0], pos.y, pos.x)) : matchCodes[index];
+            ++index;
+
+            // Get the filtered result through collaborative filtering and aggregation of matched blocks
+            for (int plane = 0; plane < 3; ++plane)
+            {
+                if (mask & (1 << plane))
+                {
+                    CollaborativeFilter(plane, filtered, *src[plane], *ref[plane], matchCode, nullptr, nullptr);
+                    Aggregate(*ResNum[plane], *ResDen[plane], filtered);
+                }
+            }
+        }
+    }
+}
+
+
+void BM3D_Base::Kernel_Parallel(int mask, Plane_FL *const ResNum[], Plane_FL *const ResDen[],
+    const Plane_FL *const src[], const Plane_FL *const ref[],
+    const std::vector<PosCode> &refPos, const std::vector<PosPairCode> &matchCodes, int threads) const
+{
+    const PCType rowCount = static_cast<PCType>(refPos.size());
+
+    if (rowCount == 0)
+    {
+        return;
+    }
+
+    // Each band holds enough reference blocks to keep all the threads busy,
+    // while the memory of the buffered groups is bounded by the band size
+    const PCType rowBlocks = static_cast<PCType>(refPos[0].size());
+    const PCType bandRows = Max(PCType(1), (threads * 8 + rowBlocks - 1) / rowBlocks);
+
+    std::vector<PosType> bandPos;
+    std::vector<FilteredGroup> bandFiltered;
+    size_t bandIndex = 0;
+
+    // 2D transforms of the blocks of src and ref of each plane, ref shares the cache of src if they're the same
+    const bool cached = para.TransformCache;
+    std::vector<BlockTransforms> srcCache(cached ? 3 : 0);
+    std::vector<BlockTransforms> refCache(cached && TransformRef() ? 3 : 0);
+    const BlockTransforms *srcCacheP[3] = { nullptr, nullptr, nullptr };
+    const BlockTransforms *refCacheP[3] = { nullptr, nullptr, nullptr };
+
+    for (int plane = 0; cached && plane < 3; ++plane)
+    {
+        srcCacheP[plane] = &srcCache[plane];
+
+        if (TransformRef())
+        {
+            refCacheP[plane] = ref[plane] == src[plane] ? &srcCache[plane] : &refCache[plane];
+        }
+    }
+
+    std::vector<PosPairCode> bandCodes;
+    std::vector<const PosPairCode *> bandCodeP;
+
+    for (PCType row = 0; row < rowCount; row += bandRows)
+    {
+        const PCType rowUpper = Min(rowCount, row + bandRows);
+
+        bandIndex += bandPos.size();
+        bandPos.clear();
+
+        for (PCType r = row; r < rowUpper; ++r)
+        {
+            bandPos.insert(bandPos.end(), refPos[r].begin(), refPos[r].end());
+        }
+
+        const PCType bandCount = static_cast<PCType>(bandPos.size());
+
+        if (static_cast<PCType>(bandFiltered.size()) < bandCount * 3)
+        {
+            bandFiltered.resize(bandCount * 3);
+        }
+
+        // The whole band is matched before filtering to transform the blocks in its groups
+        if (cached)
+        {
+            if (matchCodes.empty())
+            {
+                bandCodes.resize(bandCount);
+
+                ThreadPool::Default().parallel_for(0, bandCount, [&](PCType n)
+                {
+                    bandCodes[n] = BlockMatching(*ref[0], bandPos[n].y, bandPos[n].x);
+                }, threads);
+            }
+
+            bandCodeP.resize(bandCount);
+
+            for (PCType n = 0; n < bandCount; ++n)
+            {
+                bandCodeP[n] = matchCodes.empty() ? &bandCodes[n] : &matchCodes[bandIndex + n];
+            }
+
+            // The matched blocks of this band and the following bands are within BMrange below the first row
+            const PCType top = Max(PCType(0), bandPos[0].y - para.BMrange);
+
+            for (int plane = 0; plane < 3; ++plane)
+            {
+                if (mask & (1 << plane))
+                {
+                    TransformBlocks(srcCache[plane], plane, *src[plane], bandCodeP, top, threads);
+
+                    if (refCacheP[plane] && refCacheP[plane] != srcCacheP[plane])
+                    {
+                        TransformBlocks(refCache[plane], plane, *ref[plane], bandCodeP, top, threads);
+                    }
+                }
+            }
+        }
+
+        // Block matching and collaborative filtering of each reference block in parallel
+        ThreadPool::Default().parallel_for(0, bandCount, [&](PCType n)
+        {
+            PosPairCode tempCode;
+            const PosPairCode &matchCode = cached ? *bandCodeP[n] : !matchCodes.empty() ? matchCodes[bandIndex + n]
+                : (tempCode = BlockMatching(*ref[0], bandPos[n].y, bandPos[n].x));
+
+            for (int plane = 0; plane < 3; ++plane)
+            {
+                if (mask & (1 << plane))
+                {
+                    CollaborativeFilter(plane, bandFiltered[n * 3 + plane], *src[plane], *ref[plane], matchCode,
+                        srcCacheP[plane], refCacheP[plane]);
+                }
+            }
+        }, threads);
+
+        // Aggregation in the scan order of reference blocks
+        for (PCType n = 0; n < bandCount; ++n)
+        {
+            for (int plane = 0; plane < 3; ++plane)
+            {
+                if (mask & (1 << plane))
+                {
+                    Aggregate(*ResNum[plane], *ResDen[plane], bandFiltered[n * 3 + plane]);
+                }
+            }
+        }
+    }
+}
+
+
+void BM3D_Base::Kernel(Plane_FL *const dst[], const PlaneSeq src[], const PlaneSeq ref[], PCType center) const
+{
+    if (Skip())
+    {
+        for (int plane = 0; plane < 3; ++plane)
+        {
+            *dst[plane] = *src[plane][center];
+        }
+
+        return;
+    }
+
+    const int threads = para.threads > 0 ? para.threads : ThreadPool::Default().Threads();
+    const PCType frames = static_cast<PCType>(src[0].size());
+    const PCType stride = src[0][center]->Stride();
+
+    int mask = 0;
+    std::vector<const FLType *> srcData[3];
+    std::vector<const FLType *> refData[3];
+    Plane_FL ResNum[3];
+    Plane_FL ResDen[3];
+    std::vector<FLType *> ResNumP[3];
+    std::vector<FLType *> ResDenP[3];
+
+    for (int plane = 0; plane < 3; ++plane)
+    {
+        if (para.sigma[plane] <= 0)
+        {
+            continue;
+        }
+
+        mask |= 1 << plane;
+
+        for (PCType z = 0; z < frames; ++z)
+        {
+            srcData[plane].push_back(src[plane][z]->data());
+            refData[plane].push_back(ref[plane][z]->data());
+        }
+
+        // Only the blocks in frame center are aggregated
+        ResNum[plane] = Plane_FL(*src[plane][center], true, 0);
+        ResDen[plane] = Plane_FL(*src[plane][center], true, 0);
+        ResNumP[plane].assign(frames, nullptr);
+        ResDenP[plane].assign(frames, nullptr);
+        ResNumP[plane][center] = ResNum[plane].data();
+        ResDenP[plane][center] = ResDen[plane].data();
+    }
+
+    // The quantized copies of the frames of ref used for block matching
+    std::vector<Plane_8> ref8;
+    std::vector<Plane_16> ref16;
+    std::vector<const Plane_8 *> ref8P;
+    std::vector<const Plane_16 *> ref16P;
+
+    if (para.BMdepth > 8)
+    {
+        ref16.reserve(frames);
+
+        for (PCType z = 0; z < frames; ++z)
+        {
+            ref16.push_back(Plane_16(*ref[0][z], para.BMdepth));
+            ref16P.push_back(&ref16.back());
+        }
+    }
+    else if (para.BMdepth > 0)
+    {
+        ref8.reserve(frames);
+
+        for (PCType z = 0; z < frames; ++z)
+        {
+            ref8.push_back(Plane_8(*ref[0][z], para.BMdepth));
+            ref8P.push_back(&ref8.back());
+        }
+    }
+
+    // Bands of reference blocks are processed in parallel and aggregated in order as Kernel_Parallel()
+    const std::vector<PosCode> refPos = RefBlockPos(src[0][center]->Height(), src[0][center]->Width());
+    const PCType rowCount = static_cast<PCType>(refPos.size());
+    const PCType rowBlocks = rowCount > 0 ? static_cast<PCType>(refPos[0].size()) : 1;
+    const PCType bandRows = Max(PCType(1), (threads * 8 + rowBlocks - 1) / rowBlocks);
+
+    std::vector<PosType> bandPos;
+    std::vector<FilteredGroup> bandFiltered;
+
+    for (PCType row = 0; row < rowCount; row += bandRows)
+    {
+        const PCType rowUpper = Min(rowCount, row + bandRows);
+
+        bandPos.clear();
+
+        for (PCType r = row; r < rowUpper; ++r)
+        {
+            bandPos.insert(bandPos.end(), refPos[r].begin(), refPos[r].end());
+        }
+
+        const PCType bandCount = static_cast<PCType>(bandPos.size());
+
+        if (static_cast<PCType>(bandFiltered.size()) < bandCount * 3)
+        {
+            bandFiltered.resize(bandCount * 3);
+        }
+
+        ThreadPool::Default().parallel_for(0, bandCount, [&](PCType n)
+        {
+            const PosType pos = bandPos[n];
+            const Pos3PairCode matchCode = para.BMdepth > 8 ? BlockMatching(ref16P, center, pos.y, pos.x)
+                : para.BMdepth > 0 ? BlockMatching(ref8P, center, pos.y, pos.x) : BlockMatching(ref[0], center, pos.y, pos.x);
+
+            for (int plane = 0; plane < 3; ++plane)
+            {
+                if (mask & (1 << plane))
+                {
+                    CollaborativeFilter(plane, bandFiltered[n * 3 + plane],
+                        srcData[plane], refData[plane], stride, matchCode);
+                }
+            }
+        }, threads);
+
+        for (PCType n = 0; n < bandCount; ++n)
+        {
+            for (int plane = 0; plane < 3; ++plane)
+            {
+                if (mask & (1 << plane))
+                {
+                    const FilteredGroup &filtered = bandFiltered[n * 3 + plane];
+
+                    filtered.group.AddTo(ResNumP[plane], stride, filtered.numWeight);
+                    filtered.group.CountTo(ResDenP[plane], stride, filtered.denWeight);
+                }
+            }
+        }
+    }
+
+    for (int plane = 0; plane < 3; ++plane)
+    {
+        if (mask & (1 << plane))
+        {
+            // The filtered blocks are sumed and averaged to form the final filtered image
+            *dst[plane] = Plane_FL(*src[plane][center], false);
+            *dst[plane] = ResNum[plane] / ResDen[plane];
+        }
+        else
+        {
+            *dst[plane] = *src[plane][center];
+        }
+    }
+}
+
+
+template < typename _St1 >
+BM3D_Base::PosPairCode BM3D_Base::BlockMatching(
+    const _St1 &ref, PCType j, PCType i) const
+{
+    // Skip block matching if GroupSize is 1 or thMSE is not positive,
+    // and take the reference block as the only element in the group
+    if (para.GroupSize == 1 || para.thMSE <= 0)
+    {
+        return PosPairCode(1, PosPair(KeyType(0), PosType(j, i)));
+    }
+
+    // Get reference block from the reference plane
+    Block<typename _St1::value_type, FLType> refBlock(ref, para.BlockSize, para.BlockSize, PosType(j, i));
+
+    // Block matching
+    return refBlock.BlockMatchingMulti(ref, para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true);
+}
+
+
+template < typename _St1 >
+void BM3D_Base::BlockMatching(std::vector<PosPairCode> &matchCodes, const _St1 &ref,
+    const std::vector<PosCode> &refPos, int threads) const
+{
+    typedef typename _St1::value_type value_type;
+
+    const PCType rowCount = static_cast<PCType>(refPos.size());
+    std::vector<size_t> rowIndex(rowCount + 1, 0);
+
+    for (PCType r = 0; r < rowCount; ++r)
+    {
+        rowIndex[r + 1] = rowIndex[r] + refPos[r].size();
+    }
+
+    matchCodes.resize(rowIndex[rowCount]);
+
+    if (para.BMalgorithm == 2)
+    {
+        // Each chunk of PSfull rows takes predictions only from its own rows
+        const PCType chunkRows = para.PSfull > 0 ? para.PSfull : Max(PCType(1), rowCount);
+        const PCType chunks = (rowCount + chunkRows - 1) / chunkRows;
+
+        ThreadPool::Default().parallel_for(0, chunks, [&](PCType c)
+        {
+            const PCType lower = chunkRows * c;
+            const PCType upper = Min(rowCount, lower + chunkRows);
+
+            BlockMatching_Predictive<value_type, FLType> matcher(para.BlockSize, para.BlockSize,
+                para.BMrange, para.BMstep, para.thMSE, para.PSrange, para.PSnum, para.PSfull, 1, para.GroupSize, true);
+            std::vector<PosPairCode> rowCodes;
+            std::vector<PosPairCode> prevCodes;
+
+            for (PCType r = lower; r < upper; ++r)
+            {
+                matcher(rowCodes, ref, refPos[r], refPos[r > lower ? r - 1 : r], prevCodes, r);
+                std::copy(rowCodes.begin(), rowCodes.end(), matchCodes.begin() + rowIndex[r]);
+                prevCodes.swap(rowCodes);
+            }
+        }, threads);
+
+        return;
+    }
+
+    if (para.BMalgorithm != 1)
+    {
+        ThreadPool::Default().parallel_for(0, rowCount, [&](PCType r)
+        {
+            for (size_t n = rowIndex[r]; n < rowIndex[r + 1]; ++n)
+            {
+                const PosType pos = refPos[r][n - rowIndex[r]];
+                matchCodes[n] = BlockMatching(ref, pos.y, pos.x);
+            }
+        }, threads);
+
+        return;
+    }
+
+    // Each chunk keeps its own column sums, which are updated incrementally from row to row
+    const PCType chunks = Max(PCType(1), Min(static_cast<PCType>(threads), rowCount));
+
+    ThreadPool::Default().parallel_for(0, chunks, [&](PCType c)
+    {
+        const PCType lower = rowCount * c / chunks;
+        const PCType upper = rowCount * (c + 1) / chunks;
+
+        BlockMatching_Sliding<value_type, FLType> matcher(para.BlockSize, para.BlockSize,
+            para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true);
+        std::vector<PosPairCode> rowCodes;
+
+        for (PCType r = lower; r < upper; ++r)
+        {
+            matcher(rowCodes, ref, refPos[r]);
+            std::move(rowCodes.begin(), rowCodes.end(), matchCodes.begin() + rowIndex[r]);
+        }
+    }, threads);
+}
+
+
+void BM3D_Base::TransformBlocks(BlockTransforms &dst, int plane, const Plane_FL &src,
+    const std::vector<const PosPairCode *> &codes, PCType top, int threads) const
+{
+    const PCType BlockSize = para.BlockSize;
+    const PCType BlockPixels = BlockSize * BlockSize;
+    const PCType rowCount = src.Height() - BlockSize + 1;
+    const PCType posCount = src.Width() - BlockSize + 1;
+
+    if (dst.blockSize != BlockSize || static_cast<PCType>(dst.rows.size()) != rowCount)
+    {
+        dst.blockSize = BlockSize;
+        dst.top = 0;
+        dst.rows.clear();
+        dst.rows.resize(rowCount);
+    }
+
+    // Release the rows not used by this band and the following bands
+    for (top = Min(top, rowCount); dst.top < top; ++dst.top)
+    {
+        dst.rows[dst.top] = BlockTransforms::Row();
+    }
 
-        finalAMP[i - 1] = 2 * i * 2 * BlockSize * 2 * BlockSize;
-        double forwardAMP = sqrt(finalAMP[i - 1]);
+    // Allocate the slots of the new positions
+    PosCode newPos;
 
-        if (wiener)
+    for (auto code : codes)
+    {
+        for (PCType z = 0, upper = GroupSize(code->size()); z < upper; ++z)
         {
-            wienerSigmaSqr[i - 1] = static_cast<FLType>(sigma * forwardAMP * sigma * forwardAMP);
+            const PosType pos = (*code)[z].second;
+            BlockTransforms::Row &row = dst.rows[pos.y];
+
+            if (row.slot.empty())
+            {
+                row.slot.resize(posCount, -1);
+            }
+
+            if (row.slot[pos.x] < 0)
+            {
+                row.slot[pos.x] = row.count++;
+                row.coefs.resize(row.count * BlockPixels);
+                newPos.push_back(pos);
+            }
         }
-        else
-        {
-            double thrBase = sigma * lambda * forwardAMP;
-            std::vector<double> thr(4);
+    }
 
-            thr[0] = thrBase;
-            thr[1] = thrBase * sqrt(double(2));
-            thr[2] = thrBase * double(2);
-            thr[3] = thrBase * sqrt(double(8));
+    // Apply forward 2D transform to the new positions in parallel
+    const PCType chunkSize = 64;
+    const PCType newCount = static_cast<PCType>(newPos.size());
 
-            thrTable[i - 1] = std::vector<FLType>(i * BlockSize * BlockSize);
-            auto thr_d = thrTable[i - 1].data();
+    ThreadPool::Default().parallel_for(0, (newCount + chunkSize - 1) / chunkSize, [&](PCType c)
+    {
+        // FFTW plans are executed on the aligned data of the block
+        block_type block(BlockSize, BlockSize, PosType(0, 0), false);
 
-            for (PCType z = 0; z < i; ++z)
-            {
-                for (PCType y = 0; y < BlockSize; ++y)
-                {
-                    for (PCType x = 0; x < BlockSize; ++x, ++thr_d)
-                    {
-                        int flag = 0;
+        for (PCType n = c * chunkSize, upper = Min(newCount, n + chunkSize); n < upper; ++n)
+        {
+            block.SetPos(newPos[n]);
+            block.From(src);
 
-                        if (x == 0)
-                        {
-                            ++flag;
-                        }
-                        if (y == 0)
-                        {
-                            ++flag;
-                        }
-                        if (z == 0)
-                        {
-                            ++flag;
-                        }
+            f[plane].fp2d->execute_r2r(block.data(), block.data());
 
-                        *thr_d = static_cast<FLType>(thr[flag]);
-                    }
-                }
-            }
+            memcpy(dst.Coefs(newPos[n]), block.data(), sizeof(FLType) * BlockPixels);
         }
-    }
+    }, threads);
 }
 
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Functions of class BM3D_Base
+void BM3D_Base::ForwardTransform(group_type &dst, int plane, const Plane_FL &src,
+    const PosPairCode &code, const BlockTransforms *cache) const
+{
+    const PCType GroupSize = this->GroupSize(code.size());
+    const PCType BlockPixels = para.BlockSize * para.BlockSize;
 
+    if (!cache)
+    {
+        dst = group_type(src, code, GroupSize, para.BlockSize, para.BlockSize);
+        ForwardTransform(dst, plane);
+        return;
+    }
 
-void BM3D_Base::Kernel(Plane_FL &dst, const Plane_FL &src, const Plane_FL &ref) const
+    // Gather the 2D transforms of the blocks
+    dst = group_type(code, GroupSize, para.BlockSize, para.BlockSize);
+
+    auto dstp = dst.data();
+
+    for (PCType z = 0; z < GroupSize; ++z, dstp += BlockPixels)
+    {
+        memcpy(dstp, cache->Coefs(dst.GetPos(z)), sizeof(FLType) * BlockPixels);
+    }
+
+    ForwardTransform1D(dst, plane);
+}
+
+
+void BM3D_Base::ForwardTransform(group_type &group, int plane) const
 {
-    if (para.sigma[0] <= 0 || para.GroupSize == 0 || para.BlockSize <= 0
-        || para.BMrange <= 0 || para.BMrange < para.BMstep || para.thMSE <= 0)
+    const BM3D_FilterData &filter = f[plane];
+    const PCType GroupSize = group.GroupSize();
+    const PCType BlockPixels = para.BlockSize * para.BlockSize;
+
+    // The 3D plans are not created for the transform cache
+    if (filter.transform == 0 && !filter.fp.empty())
     {
-        dst = src;
+        filter.fp[GroupSize - 1]->execute_r2r(group.data(), group.data());
         return;
     }
 
-    Plane_FL ResNum(dst, true, 0);
-    Plane_FL ResDen(dst, true, 0);
+    for (PCType z = 0; z < GroupSize; ++z)
+    {
+        filter.fp2d->execute_r2r(group.data() + z * BlockPixels, group.data() + z * BlockPixels);
+    }
+
+    ForwardTransform1D(group, plane);
+}
 
-    PCType height = src.Height();
-    PCType width = src.Width();
 
-    PCType BlockPosRight = width - para.BlockSize;
-    PCType BlockPosBottom = height - para.BlockSize;
+void BM3D_Base::ForwardTransform1D(group_type &group, int plane) const
+{
+    const BM3D_FilterData &filter = f[plane];
+    const PCType GroupSize = group.GroupSize();
+    const PCType BlockPixels = para.BlockSize * para.BlockSize;
 
-    for (PCType j = 0;; j += para.BlockStep)
+    if (filter.transform == 1)
     {
-        // Handle scan of reference block - vertical
-        if (j >= BlockPosBottom + para.BlockStep)
-        {
-            break;
-        }
-        else if (j > BlockPosBottom)
-        {
-            j = BlockPosBottom;
-        }
+        HaarForward(group.data(), GroupSize, BlockPixels);
+    }
+    else if (filter.transform == 2)
+    {
+        WalshHadamard(group.data(), GroupSize, BlockPixels);
+    }
+    else
+    {
+        filter.fp1d[GroupSize - 1]->execute_r2r(group.data(), group.data());
+    }
+}
 
-        for (PCType i = 0;; i += para.BlockStep)
-        {
-            // Handle scan of reference block - horizontal
-            if (i >= BlockPosRight + para.BlockStep)
-            {
-                break;
-            }
-            else if (i > BlockPosRight)
-            {
-                i = BlockPosRight;
-            }
 
-            PosPairCode matchCode = BlockMatching(ref, j, i);
+void BM3D_Base::CollaborativeFilter(int plane, FilteredGroup &dst,
+    const Plane_FL &src, const Plane_FL &ref, const PosPairCode &code,
+    const BlockTransforms *srcCache, const BlockTransforms *refCache) const
+{
+    // Construct source group guided by matched pos code, and apply forward 3D transform to it
+    ForwardTransform(dst.group, plane, src, code, srcCache);
 
-            // Get the filtered result through collaborative filtering and aggregation of matched blocks
-            CollaborativeFilter(0, ResNum, ResDen, src, ref, matchCode);
-        }
+    if (TransformRef())
+    {
+        // Construct reference group guided by matched pos code, and apply forward 3D transform to it
+        group_type refGroup;
+        ForwardTransform(refGroup, plane, ref, code, refCache);
+
+        FilterGroup(plane, dst, refGroup);
+    }
+    else
+    {
+        FilterGroup(plane, dst, dst.group);
     }
+}
 
-    // The filtered blocks are sumed and averaged to form the final filtered image
-    dst.ReSize(width, height);
 
-    _Transform(dst, ResNum, ResDen, [](FLType num, FLType den)
+void BM3D_Base::CollaborativeFilter(int plane, FilteredGroup &dst,
+    const std::vector<const FLType *> &src, const std::vector<const FLType *> &ref, PCType stride,
+    const Pos3PairCode &code) const
+{
+    const PCType GroupSize = this->GroupSize(code.size());
+
+    dst.group = group_type(src, stride, code, GroupSize, para.BlockSize, para.BlockSize);
+    ForwardTransform(dst.group, plane);
+
+    if (TransformRef())
     {
-        return num / den;
-    });
+        group_type refGroup(ref, stride, code, GroupSize, para.BlockSize, para.BlockSize);
+        ForwardTransform(refGroup, plane);
+
+        FilterGroup(plane, dst, refGroup);
+    }
+    else
+    {
+        FilterGroup(plane, dst, dst.group);
+    }
 }
 
 
-void BM3D_Base::Kernel(Plane_FL &dstY, Plane_FL &dstU, Plane_FL &dstV,
-    const Plane_FL &srcY, const Plane_FL &srcU, const Plane_FL &srcV,
-    const Plane_FL &refY, const Plane_FL &refU, const Plane_FL &refV) const
+void BM3D_Base::BackwardTransform(group_type &group, int plane) const
 {
-    if ((para.sigma[0] <= 0 && para.sigma[1] <= 0 && para.sigma[2] <= 0)
-        || para.GroupSize == 0 || para.BlockSize <= 0
-        || para.BMrange <= 0 || para.BMrange < para.BMstep || para.thMSE <= 0)
+    const BM3D_FilterData &filter = f[plane];
+    const PCType GroupSize = group.GroupSize();
+    const PCType BlockPixels = para.BlockSize * para.BlockSize;
+
+    if (filter.transform == 0)
     {
-        dstY = srcY;
-        dstU = srcU;
-        dstV = srcV;
+        filter.bp[GroupSize - 1]->execute_r2r(group.data(), group.data());
         return;
     }
 
-    Plane_FL ResNumY(srcY, true, 0);
-    Plane_FL ResDenY(srcY, true, 0);
-    Plane_FL ResNumU(srcU, true, 0);
-    Plane_FL ResDenU(srcU, true, 0);
-    Plane_FL ResNumV(srcV, true, 0);
-    Plane_FL ResDenV(srcV, true, 0);
+    if (filter.transform == 1)
+    {
+        HaarBackward(group.data(), GroupSize, BlockPixels);
+    }
+    else
+    {
+        WalshHadamard(group.data(), GroupSize, BlockPixels);
+    }
 
-    PCType height = srcY.Height();
-    PCType width = srcY.Width();
+    for (PCType z = 0; z < GroupSize; ++z)
+    {
+        filter.bp2d->execute_r2r(group.data() + z * BlockPixels, group.data() + z * BlockPixels);
+    }
+}
+
+
+template < typename _St1 >
+BM3D_Base::Pos3PairCode BM3D_Base::BlockMatching(const std::vector<const _St1 *> &ref, PCType center, PCType j, PCType i) const
+{
+    const _St1 &refCenter = *ref[center];
+    const PosPairCode matchCode = BlockMatching(refCenter, j, i);
 
-    PCType BlockPosRight = width - para.BlockSize;
-    PCType BlockPosBottom = height - para.BlockSize;
+    Pos3PairCode code;
 
-    for (PCType j = 0;; j += para.BlockStep)
+    for (const auto &match : matchCode)
     {
-        // Handle scan of reference block - vertical
-        if (j >= BlockPosBottom + para.BlockStep)
-        {
-            break;
-        }
-        else if (j > BlockPosBottom)
+        code.push_back(Pos3Pair(match.first, Pos3Type(center, match.second.y, match.second.x)));
+    }
+
+    if (para.GroupSize == 1 || para.thMSE <= 0)
+    {
+        return code;
+    }
+
+    const PCType frames = static_cast<PCType>(ref.size());
+    const PCType bottom = refCenter.Height() - para.BlockSize;
+    const PCType right = refCenter.Width() - para.BlockSize;
+    const PCType range = para.PSrange * para.BMstep;
+    const size_t predNum = static_cast<size_t>(Max(PCType(1), para.PSnum));
+
+    Block<typename _St1::value_type, FLType> refBlock(refCenter, para.BlockSize, para.BlockSize, PosType(j, i));
+    PosCode predPos;
+    PosCode searchPos;
+    PosPairCode frameCode;
+
+    // Follow the trajectories of the best matches frame by frame, backward and forward from frame center
+    for (PCType dir = -1; dir <= 1; dir += 2)
+    {
+        predPos.clear();
+
+        for (size_t k = 0; k < matchCode.size() && k < predNum; ++k)
         {
-            j = BlockPosBottom;
+            predPos.push_back(matchCode[k].second);
         }
 
-        for (PCType i = 0;; i += para.BlockStep)
+        for (PCType z = center + dir; z >= 0 && z < frames; z += dir)
         {
-            // Handle scan of reference block - horizontal
-            if (i >= BlockPosRight + para.BlockStep)
+            searchPos.clear();
+
+            for (auto pos : predPos)
             {
-                break;
+                for (PCType y = Max(PCType(0), pos.y - range); y <= Min(bottom, pos.y + range); y += para.BMstep)
+                {
+                    for (PCType x = Max(PCType(0), pos.x - range); x <= Min(right, pos.x + range); x += para.BMstep)
+                    {
+                        searchPos.push_back(PosType(y, x));
+                    }
+                }
             }
-            else if (i > BlockPosRight)
+
+            std::sort(searchPos.begin(), searchPos.end());
+            searchPos.erase(std::unique(searchPos.begin(), searchPos.end()), searchPos.end());
+
+            frameCode.clear();
+            refBlock.BlockMatchingTopK(frameCode, *ref[z], searchPos, para.thMSE, para.GroupSize, true);
+
+            // The trajectories are lost
+            if (frameCode.empty())
             {
-                i = BlockPosRight;
+                break;
             }
 
-            PosPairCode matchCode = BlockMatching(refY, j, i);
+            predPos.clear();
 
-            // Get the filtered result through collaborative filtering and aggregation of matched blocks
-            if (para.sigma[0] > 0) CollaborativeFilter(0, ResNumY, ResDenY, srcY, refY, matchCode);
-            if (para.sigma[1] > 0) CollaborativeFilter(1, ResNumU, ResDenU, srcU, refU, matchCode);
-            if (para.sigma[2] > 0) CollaborativeFilter(2, ResNumV, ResDenV, srcV, refV, matchCode);
+            for (size_t k = 0; k < frameCode.size(); ++k)
+            {
+                if (k < predNum) predPos.push_back(frameCode[k].second);
+                code.push_back(Pos3Pair(frameCode[k].first, Pos3Type(z, frameCode[k].second.y, frameCode[k].second.x)));
+            }
         }
     }
 
-    // The filtered blocks are sumed and averaged to form the final filtered image
-    dstY.ReSize(width, height);
-    dstU.ReSize(width, height);
-    dstV.ReSize(width, height);
-
-    if (para.sigma[0] > 0) _Transform(dstY, ResNumY, ResDenY, [](FLType num, FLType den)
-    {
-        return num / den;
-    });
-
-    if (para.sigma[1] > 0) _Transform(dstU, ResNumU, ResDenU, [](FLType num, FLType den)
-    {
-        return num / den;
-    });
-
-    if (para.sigma[2] > 0) _Transform(dstV, ResNumV, ResDenV, [](FLType num, FLType den)
+    // The best matches of all the frames, the reference block stays the first
+    std::stable_sort(code.begin() + 1, code.end(), [](const Pos3Pair &left, const Pos3Pair &right)
     {
-        return num / den;
+        return left.first < right.first;
     });
-}
 
-
-BM3D_Base::PosPairCode BM3D_Base::BlockMatching(
-    const Plane_FL &ref, PCType j, PCType i) const
-{
-    // Skip block matching if GroupSize is 1 or thMSE is not positive,
-    // and take the reference block as the only element in the group
-    if (para.GroupSize == 1 || para.thMSE <= 0)
+    if (para.GroupSize > 0 && static_cast<PCType>(code.size()) > para.GroupSize)
     {
-        return PosPairCode(1, PosPair(KeyType(0), PosType(j, i)));
+        code.resize(para.GroupSize);
     }
 
-    // Get reference block from the reference plane
-    block_type refBlock(ref, para.BlockSize, para.BlockSize, PosType(j, i));
-
-    // Block matching
-    return refBlock.BlockMatchingMulti(ref, para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true);
+    return code;
 }
 
 
@@ -289,6 +1156,13 @@ Frame &BM3D_Base::process_Frame(Frame &dst, const Frame &src, const Frame &ref)
         return dst;
     }
 
+    const PCType tileSize = TileSize(src.Height(), src.Width(), TileHalo());
+
+    if (tileSize > 0)
+    {
+        return process_Frame_Tiled(dst, src, ref, tileSize);
+    }
+
     Plane_FL srcY, srcU, srcV;
     Plane_FL refY, refU, refV;
 
@@ -313,6 +1187,46 @@ Frame &BM3D_Base::process_Frame(Frame &dst, const Frame &src, const Frame &ref)
 }
 
 
+Frame &BM3D_Base::process_Frame_Tiled(Frame &dst, const Frame &src, const Frame &ref, PCType tileSize) const
+{
+    const PCType height = src.Height();
+    const PCType width = src.Width();
+    const PCType halo = TileHalo();
+
+    for (PCType y = 0; y < height; y += tileSize)
+    {
+        for (PCType x = 0; x < width; x += tileSize)
+        {
+            const TileRect region(y, x, Min(height, y + tileSize), Min(width, x + tileSize));
+            const TileRect tile = region.Tile(halo, height, width, tileSize);
+
+            Plane_FL srcY, srcU, srcV;
+            Plane_FL refY, refU, refV;
+
+            // Convert the tile of source image and reference image from RGB to YUV
+            bool ref_equal_src = RGB2YUV(srcY, srcU, srcV, refY, refU, refV,
+                TileView(src.R(), tile), TileView(src.G(), tile), TileView(src.B(), tile),
+                TileView(ref.R(), tile), TileView(ref.G(), tile), TileView(ref.B(), tile));
+
+            // Execute kernel
+            if (ref_equal_src)
+            {
+                Kernel(srcY, srcU, srcV, srcY, srcU, srcV, srcY, srcU, srcV, height, width, tile, region);
+            }
+            else
+            {
+                Kernel(srcY, srcU, srcV, srcY, srcU, srcV, refY, refU, refV, height, width, tile, region);
+            }
+
+            // Convert the region of filtered image from YUV to RGB
+            StoreTile(dst, srcY, srcU, srcV, tile, region);
+        }
+    }
+
+    return dst;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Functions of class BM3D_Basic
 
@@ -336,27 +1250,14 @@ bool BM3D_Basic::RGB2YUV(Plane_FL &srcY, Plane_FL &srcU, Plane_FL &srcV,
 }
 
 
-void BM3D_Basic::CollaborativeFilter(int plane,
-    Plane_FL &ResNum, Plane_FL &ResDen,
-    const Plane_FL &src, const Plane_FL &ref,
-    const PosPairCode &code) const
+void BM3D_Basic::FilterGroup(int plane, FilteredGroup &dst, const group_type &refGroup) const
 {
-    PCType GroupSize = static_cast<PCType>(code.size());
-    // When para.GroupSize > 0, limit GroupSize up to para.GroupSize
-    if (para.GroupSize > 0 && GroupSize > para.GroupSize)
-    {
-        GroupSize = para.GroupSize;
-    }
-
-    // Construct source group guided by matched pos code
-    BlockGroup<FLType, FLType> srcGroup(src, code, GroupSize, para.BlockSize, para.BlockSize);
+    group_type &srcGroup = dst.group;
+    const PCType GroupSize = srcGroup.GroupSize();
 
     // Initialize retianed coefficients of hard threshold filtering
     int retainedCoefs = 0;
 
-    // Apply forward 3D transform to the source group
-    f[plane].fp[GroupSize - 1].execute_r2r(srcGroup.data(), srcGroup.data());
-
     // Apply hard-thresholding to the source group
     Block_For_each(srcGroup, f[plane].thrTable[GroupSize - 1], [&](FLType &x, FLType y)
     {
@@ -371,17 +1272,12 @@ void BM3D_Basic::CollaborativeFilter(int plane,
     });
 
     // Apply backward 3D transform to the filtered group
-    f[plane].bp[GroupSize - 1].execute_r2r(srcGroup.data(), srcGroup.data());
+    BackwardTransform(srcGroup, plane);
 
     // Calculate weight for the filtered group
     // Also include the normalization factor to compensate for the amplification introduced in 3D transform
-    FLType denWeight = retainedCoefs < 1 ? 1 : FLType(1) / static_cast<FLType>(retainedCoefs);
-    FLType numWeight = static_cast<FLType>(denWeight / f[plane].finalAMP[GroupSize - 1]);
-
-    // Store the weighted filtered group to the numerator part of the final estimation
-    // Store the weight to the denominator part of the final estimation
-    srcGroup.AddTo(ResNum, numWeight);
-    srcGroup.CountTo(ResDen, denWeight);
+    dst.denWeight = retainedCoefs < 1 ? 1 : FLType(1) / static_cast<FLType>(retainedCoefs);
+    dst.numWeight = static_cast<FLType>(dst.denWeight / f[plane].finalAMP[GroupSize - 1]);
 }
 
 
@@ -408,29 +1304,14 @@ bool BM3D_Final::RGB2YUV(Plane_FL &srcY, Plane_FL &srcU, Plane_FL &srcV,
 }
 
 
-void BM3D_Final::CollaborativeFilter(int plane,
-    Plane_FL &ResNum, Plane_FL &ResDen,
-    const Plane_FL &src, const Plane_FL &ref,
-    const PosPairCode &code) const
+void BM3D_Final::FilterGroup(int plane, FilteredGroup &dst, const group_type &refGroup) const
 {
-    PCType GroupSize = static_cast<PCType>(code.size());
-    // When para.GroupSize > 0, limit GroupSize up to para.GroupSize
-    if (para.GroupSize > 0 && GroupSize > para.GroupSize)
-    {
-        GroupSize = para.GroupSize;
-    }
-
-    // Construct source group and reference group guided by matched pos code
-    BlockGroup<FLType, FLType> srcGroup(src, code, GroupSize, para.BlockSize, para.BlockSize);
-    BlockGroup<FLType, FLType> refGroup(ref, code, GroupSize, para.BlockSize, para.BlockSize);
+    group_type &srcGroup = dst.group;
+    const PCType GroupSize = srcGroup.GroupSize();
 
     // Initialize L2-norm of Wiener coefficients
     FLType L2Wiener = 0;
 
-    // Apply forward 3D transform to the source group and the reference group
-    f[plane].fp[GroupSize - 1].execute_r2r(srcGroup.data(), srcGroup.data());
-    f[plane].fp[GroupSize - 1].execute_r2r(refGroup.data(), refGroup.data());
-
     // Apply empirical Wiener filtering to the source group guided by the reference group
     const FLType sigmaSquare = f[plane].wienerSigmaSqr[GroupSize - 1];
 
@@ -443,17 +1324,12 @@ void BM3D_Final::CollaborativeFilter(int plane,
     });
 
     // Apply backward 3D transform to the filtered group
-    f[plane].bp[GroupSize - 1].execute_r2r(srcGroup.data(), srcGroup.data());
+    BackwardTransform(srcGroup, plane);
 
     // Calculate weight for the filtered group
     // Also include the normalization factor to compensate for the amplification introduced in 3D transform
-    FLType denWeight = L2Wiener <= 0 ? 1 : FLType(1) / L2Wiener;
-    FLType numWeight = static_cast<FLType>(denWeight / f[plane].finalAMP[GroupSize - 1]);
-
-    // Store the weighted filtered group to the numerator part of the final estimation
-    // Store the weight to the denominator part of the final estimation
-    srcGroup.AddTo(ResNum, numWeight);
-    srcGroup.CountTo(ResDen, denWeight);
+    dst.denWeight = L2Wiener <= 0 ? 1 : FLType(1) / L2Wiener;
+    dst.numWeight = static_cast<FLType>(dst.denWeight / f[plane].finalAMP[GroupSize - 1]);
 }
 
 
@@ -500,6 +1376,13 @@ Plane &BM3D::process_Plane(Plane &dst, const Plane &src, const Plane &ref)
 
 Frame &BM3D::process_Frame(Frame &dst, const Frame &src, const Frame &ref)
 {
+    const PCType tileSize = basic.TileSize(src.Height(), src.Width(), basic.TileHalo() + final.TileHalo());
+
+    if (tileSize > 0)
+    {
+        return process_Frame_Tiled(dst, src, ref, tileSize);
+    }
+
     Plane_FL tmpY, tmpU, tmpV;
     Plane_FL srcY, srcU, srcV;
     Plane_FL refY, refU, refV;
@@ -525,3 +1408,89 @@ Frame &BM3D::process_Frame(Frame &dst, const Frame &src, const Frame &ref)
 
     return dst;
 }
+
+
+Frame &BM3D::process_Frame_Tiled(Frame &dst, const Frame &src, const Frame &ref, PCType tileSize) const
+{
+    typedef BM3D_Base::TileRect TileRect;
+
+    const PCType height = src.Height();
+    const PCType width = src.Width();
+
+    for (PCType y = 0; y < height; y += tileSize)
+    {
+        for (PCType x = 0; x < width; x += tileSize)
+        {
+            // The basic estimate should be exact in the halo of the final estimate
+            const TileRect region(y, x, Min(height, y + tileSize), Min(width, x + tileSize));
+            const TileRect basicRegion = region.Extend(final.TileHalo(), height, width);
+            const TileRect tile = region.Tile(final.TileHalo() + basic.TileHalo(), height, width, tileSize);
+
+            Plane_FL tmpY, tmpU, tmpV;
+            Plane_FL srcY, srcU, srcV;
+            Plane_FL refY, refU, refV;
+
+            // Convert the tile of source image and reference image from RGB to YUV
+            bool ref_equal_src = basic.RGB2YUV(srcY, srcU, srcV, refY, refU, refV,
+                TileView(src.R(), tile), TileView(src.G(), tile), TileView(src.B(), tile),
+                TileView(ref.R(), tile), TileView(ref.G(), tile), TileView(ref.B(), tile));
+
+            // Execute kernel
+            if (ref_equal_src)
+            {
+                basic.Kernel(tmpY, tmpU, tmpV, srcY, srcU, srcV, srcY, srcU, srcV, height, width, tile, basicRegion);
+            }
+            else
+            {
+                basic.Kernel(tmpY, tmpU, tmpV, srcY, srcU, srcV, refY, refU, refV, height, width, tile, basicRegion);
+            }
+
+            final.Kernel(srcY, srcU, srcV, srcY, srcU, srcV, tmpY, tmpU, tmpV, height, width, tile, region);
+
+            // Convert the region of filtered image from YUV to RGB
+            StoreTile(dst, srcY, srcU, srcV, tile, region);
+        }
+    }
+
+    return dst;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions for FFTW wisdom
+
+
+int BM3D_Warm_Wisdom(const std::string &filename)
+{
+    BM3D_FilterData::plan_cache &cache = BM3D_FilterData::plan_cache::instance();
+
+    cache.load_wisdom(filename);
+
+    const std::vector<std::string> profiles = { "fast", "lc", "np", "high", "vn" };
+
+    for (const auto &profile : profiles)
+    {
+        // Constructing the filter creates the FFTW plans of both the basic and the final estimate
+        BM3D_Para para(profile);
+        BM3D filter(para);
+
+        // The separable forward transforms of the transform cache
+        para.basic.TransformCache = true;
+        para.final.TransformCache = true;
+        BM3D filterCached(para);
+
+        // The 2D transforms of Haar and Walsh-Hadamard transforms along the group
+        para.basic.GroupTransform = 1;
+        para.final.GroupTransform = 1;
+        BM3D filterHaar(para);
+        std::cout << "BM3D_Warm_Wisdom: planned profile \"" << profile << "\", " << cache.size() << " plans in total\n";
+    }
+
+    if (!cache.save_wisdom(true))
+    {
+        std::cerr << "BM3D_Warm_Wisdom: no wisdom file specified, use \"--fftw_wisdom <path>\" or set ISP_MW_FFTW_WISDOM\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -41,43 +41,58 @@ Plane &Bilateral2D_0(Plane &dst, const Plane &src, const Plane &ref, const Bilat
     int radiusy = d.radius0[plane];
     int xUpper = radiusx + 1, yUpper = radiusy + 1;
 
-    int index0, i, j, index1, x, y;
+    int i, j, x, y;
     FLType Weight, WeightSum;
     FLType Sum;
 
     const LUT<FLType> &GS_LUT = d.GS_LUT[plane];
     const LUT<FLType> &GR_LUT = d.GR_LUT[plane];
 
-    index0 = radiusy*src.Width();
-    memcpy(dst.data(), src.data(), index0 * sizeof(DType));
-    for (j = radiusy; j < src.Height() - radiusy; ++j)
+    const int height = src.Height();
+    const int width = src.Width();
+    const int stride = src.Stride();
+    const int dst_stride = dst.Stride();
+    const int ref_stride = ref.Stride();
+
+    for (j = 0; j < height; ++j)
     {
-        for (i = 0; i < radiusx; ++i, ++index0)
+        auto dstp = dst.data() + j * dst_stride;
+        auto srcp = src.data() + j * stride;
+        auto refp = ref.data() + j * ref_stride;
+
+        // Rows within radiusy of the top and bottom border are copied from src
+        if (j < radiusy || j >= height - radiusy)
         {
-            dst[index0] = src[index0];
+            memcpy(dstp, srcp, width * sizeof(DType));
+            continue;
         }
-        for (; i < src.Width() - radiusx; ++i, ++index0)
+
+        for (i = 0; i < radiusx; ++i)
+        {
+            dstp[i] = srcp[i];
+        }
+        for (; i < width - radiusx; ++i)
         {
             WeightSum = 0;
             Sum = 0;
             for (y = -radiusy; y < yUpper; ++y)
             {
-                index1 = index0 + y*src.Width() - radiusx;
-                for (x = -radiusx; x < xUpper; ++x, ++index1)
+                auto srcp1 = srcp + y * stride;
+                auto refp1 = refp + y * ref_stride;
+                for (x = -radiusx; x < xUpper; ++x)
                 {
-                    Weight = Gaussian_Distribution2D_Spatial_LUT_Lookup(GS_LUT, xUpper, Abs(x), Abs(y)) * Gaussian_Distribution2D_Range_LUT_Lookup(GR_LUT, ref[index0], ref[index1]);
+                    Weight = Gaussian_Distribution2D_Spatial_LUT_Lookup(GS_LUT, xUpper, Abs(x), Abs(y)) * Gaussian_Distribution2D_Range_LUT_Lookup(GR_LUT, refp[i], refp1[i + x]);
                     WeightSum += Weight;
-                    Sum += src[index1] * Weight;
+                    Sum += srcp1[i + x] * Weight;
                 }
             }
-            dst[index0] = dst.Quantize(Sum / WeightSum);
+            dstp[i] = dst.Quantize(Sum / WeightSum);
         }
-        for (; i < src.Width(); ++i, ++index0)
+        for (; i < width; ++i)
         {
-            dst[index0] = src[index0];
+            dstp[i] = srcp[i];
         }
     }
-    memcpy(dst.data() + index0, src.data() + index0, radiusy*src.Width()*sizeof(DType));
 
     return dst;
 }
@@ -86,13 +101,11 @@ Plane &Bilateral2D_0(Plane &dst, const Plane &src, const Plane &ref, const Bilat
 // Implementation of O(1) cross/joint Bilateral filter algorithm from "Qingxiong Yang, Kar-Han Tan, Narendra Ahuja - Real-Time O(1) Bilateral Filtering"
 Plane &Bilateral2D_1(Plane &dst, const Plane &src, const Plane &ref, const Bilateral2D_Data &d, int plane)
 {
-    int i, j, upper;
+    int i, j;
     int k;
 
     int height = ref.Height();
     int width = ref.Width();
-    int stride = ref.Width();
-    int pcount = ref.PixelCount();
 
     double sigmaS = d.sigmaS[plane];
     double sigmaR = d.sigmaR[plane];
@@ -129,39 +142,42 @@ Plane &Bilateral2D_1(Plane &dst, const Plane &src, const Plane &ref, const Bilat
 
         for (j = 0; j < height; ++j)
         {
-            i = stride * j;
-            for (upper = i + width; i < upper; ++i)
+            auto refp = ref.data() + j * ref.Stride();
+            auto srcp = src.data() + j * src.Stride();
+            auto Wkp = Wk.data() + j * Wk.Stride();
+            auto Jkp = Jk.data() + j * Jk.Stride();
+
+            for (i = 0; i < width; ++i)
             {
-                Wk[i] = Gaussian_Distribution2D_Range_LUT_Lookup(GR_LUT, PBFICk[k], ref[i]);
-                Jk[i] = Wk[i] * src[i];
+                Wkp[i] = Gaussian_Distribution2D_Range_LUT_Lookup(GR_LUT, PBFICk[k], refp[i]);
+                Jkp[i] = Wkp[i] * srcp[i];
             }
         }
 
         GFilter.Filter(Wk);
         GFilter.Filter(Jk);
 
-        for (j = 0; j < height; ++j)
+        TRANSFORM(PBFIC[k], Wk, Jk, [](FLType w, FLType j)
         {
-            i = stride * j;
-            for (upper = i + width; i < upper; ++i)
-            {
-                PBFIC[k][i] = Wk[i] == 0 ? 0 : Jk[i] / Wk[i];
-            }
-        }
+            return w == 0 ? 0 : j / w;
+        });
     }
 
     // Generate filtered result from PBFICs using linear interpolation
     for (j = 0; j < height; ++j)
     {
-        i = stride * j;
-        for (upper = i + width; i < upper; ++i)
+        auto refp = ref.data() + j * ref.Stride();
+        auto dstp = dst.data() + j * dst.Stride();
+        const PCType pfj = j * PBFIC[0].Stride();
+
+        for (i = 0; i < width; ++i)
         {
             for (k = 0; k < PBFICnum - 2; ++k)
             {
-                if (ref[i] < PBFICk[k + 1] && ref[i] >= PBFICk[k]) break;
+                if (refp[i] < PBFICk[k + 1] && refp[i] >= PBFICk[k]) break;
             }
 
-            dst[i] = dst.Quantize(((PBFICk[k + 1] - ref[i])*PBFIC[k][i] + (ref[i] - PBFICk[k])*PBFIC[k + 1][i]) / (PBFICk[k + 1] - PBFICk[k]));
+            dstp[i] = dst.Quantize(((PBFICk[k + 1] - refp[i])*PBFIC[k][pfj + i] + (refp[i] - PBFICk[k])*PBFIC[k + 1][pfj + i]) / (PBFICk[k + 1] - PBFICk[k]));
         }
     }
 
@@ -173,41 +189,6 @@ Plane &Bilateral2D_1(Plane &dst, const Plane &src, const Plane &ref, const Bilat
 }
 
 
-// copy data to buff
-template < typename T >
-void data2buff(T * dst, const T * src, int xoffset, int yoffset,
-    int bufheight, int bufwidth, int bufstride, int height, int width, int stride)
-{
-    int x, y;
-    T *dstp;
-    const T *srcp;
-
-    for (y = 0; y < height; ++y)
-    {
-        dstp = dst + (yoffset + y) * bufstride;
-        srcp = src + y * stride;
-        for (x = 0; x < xoffset; ++x)
-            dstp[x] = srcp[0];
-        memcpy(dstp + xoffset, srcp, sizeof(T)*width);
-        for (x = xoffset + width; x < bufwidth; ++x)
-            dstp[x] = srcp[width - 1];
-    }
-
-    srcp = dst + yoffset * bufstride;
-    for (y = 0; y < yoffset; ++y)
-    {
-        dstp = dst + y * bufstride;
-        memcpy(dstp, srcp, sizeof(T)*bufwidth);
-    }
-
-    srcp = dst + (yoffset + height - 1) * bufstride;
-    for (y = yoffset + height; y < bufheight; ++y)
-    {
-        dstp = dst + y * bufstride;
-        memcpy(dstp, srcp, sizeof(T)*bufwidth);
-    }
-}
-
 // Implementation of cross/joint Bilateral filter with truncated spatial window and sub-sampling
 Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Plane &ref, const Bilateral2D_Data &d, int plane)
 {
@@ -215,17 +196,11 @@ Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Plane &ref, const Bilat
 
     int radiusx = d.radius[plane];
     int radiusy = d.radius[plane];
-    int buffnum = radiusy * 2 + 1;
     int samplenum = d.samples[plane];
     int samplestep = d.step[plane];
-    int samplecenter = buffnum / 2;
 
     int height = src.Height();
     int width = src.Width();
-    int stride = src.Width();
-    int bufheight = src.Height() + radiusy * 2;
-    int bufwidth = src.Width() + radiusx * 2;
-    int bufstride = src.Width() + radiusx * 2;
 
     const DType * srcp = src.data();
     const DType * refp = ref.data();
@@ -234,30 +209,28 @@ Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Plane &ref, const Bilat
     const LUT<FLType> &GS_LUT = d.GS_LUT[plane];
     const LUT<FLType> &GR_LUT = d.GR_LUT[plane];
 
-    // Allocate buffs
-    DType *srcbuff = new DType[bufstride * bufheight];
-    DType *refbuff = new DType[bufstride * bufheight];
-    DType *srcbuffp1, *refbuffp1, *srcbuffp2, *refbuffp2;
+    // Copy src and ref to buffs with the border extended by radius
+    Plane srcbuff(src);
+    Plane refbuff(ref);
+    srcbuff.SetApron(radiusx).ExtendBorder();
+    refbuff.SetApron(radiusx).ExtendBorder();
 
-    data2buff(srcbuff, srcp, radiusx, radiusy, bufheight, bufwidth, bufstride, height, width, stride);
-    data2buff(refbuff, refp, radiusx, radiusy, bufheight, bufwidth, bufstride, height, width, stride);
+    const int bufstride = srcbuff.Stride();
+    const DType *srcbuffp1, *refbuffp1, *srcbuffp2, *refbuffp2;
 
     // Process
     FLType SWei, RWei1, RWei2, RWei3, RWei4, WeightSum, Sum;
-    int xoffset, yoffset;
     const int xUpper = radiusx + 1, yUpper = radiusy + 1;
 
-    yoffset = samplecenter;
-    for (j = 0; j < height; ++j, srcp += stride, refp += stride, dstp += stride)
+    for (j = 0; j < height; ++j, srcp += src.Stride(), refp += ref.Stride(), dstp += dst.Stride())
     {
-        srcbuffp1 = srcbuff + (yoffset + j) * bufstride;
-        refbuffp1 = refbuff + (yoffset + j) * bufstride;
+        srcbuffp1 = srcbuff.data() + j * bufstride;
+        refbuffp1 = refbuff.data() + j * bufstride;
 
         for (i = 0; i < width; ++i)
         {
-            xoffset = samplecenter + i;
-            srcbuffp2 = srcbuffp1 + xoffset;
-            refbuffp2 = refbuffp1 + xoffset;
+            srcbuffp2 = srcbuffp1 + i;
+            refbuffp2 = refbuffp1 + i;
 
             WeightSum = GS_LUT[0] * GR_LUT[0];
             Sum = srcp[i] * WeightSum;
@@ -285,10 +258,7 @@ Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Plane &ref, const Bilat
         }
     }
 
-    // Clear and output
-    delete[] srcbuff;
-    delete[] refbuff;
-
+    // Output
     return dst;
 }
 
@@ -299,17 +269,11 @@ Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Bilateral2D_Data &d, in
 
     int radiusx = d.radius[plane];
     int radiusy = d.radius[plane];
-    int buffnum = radiusy * 2 + 1;
     int samplenum = d.samples[plane];
     int samplestep = d.step[plane];
-    int samplecenter = buffnum / 2;
 
     int height = src.Height();
     int width = src.Width();
-    int stride = src.Width();
-    int bufheight = src.Height() + radiusy * 2;
-    int bufwidth = src.Width() + radiusx * 2;
-    int bufstride = src.Width() + radiusx * 2;
 
     const DType * srcp = src.data();
     DType * dstp = dst.data();
@@ -317,26 +281,24 @@ Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Bilateral2D_Data &d, in
     const LUT<FLType> &GS_LUT = d.GS_LUT[plane];
     const LUT<FLType> &GR_LUT = d.GR_LUT[plane];
 
-    // Allocate buffs
-    DType *srcbuff = new DType[bufstride * bufheight];
-    DType *srcbuffp1, *srcbuffp2;
+    // Copy src to buff with the border extended by radius
+    Plane srcbuff(src);
+    srcbuff.SetApron(radiusx).ExtendBorder();
 
-    data2buff(srcbuff, srcp, radiusx, radiusy, bufheight, bufwidth, bufstride, height, width, stride);
+    const int bufstride = srcbuff.Stride();
+    const DType *srcbuffp1, *srcbuffp2;
 
     // Process
     FLType SWei, RWei1, RWei2, RWei3, RWei4, WeightSum, Sum;
-    int xoffset, yoffset;
     const int xUpper = radiusx + 1, yUpper = radiusy + 1;
 
-    yoffset = samplecenter;
-    for (j = 0; j < height; ++j, srcp += stride, dstp += stride)
+    for (j = 0; j < height; ++j, srcp += src.Stride(), dstp += dst.Stride())
     {
-        srcbuffp1 = srcbuff + (yoffset + j) * bufstride;
+        srcbuffp1 = srcbuff.data() + j * bufstride;
 
         for (i = 0; i < width; ++i)
         {
-            xoffset = samplecenter + i;
-            srcbuffp2 = srcbuffp1 + xoffset;
+            srcbuffp2 = srcbuffp1 + i;
 
             WeightSum = GS_LUT[0] * GR_LUT[0];
             Sum = srcp[i] * WeightSum;
@@ -364,8 +326,6 @@ Plane &Bilateral2D_2(Plane &dst, const Plane &src, const Bilateral2D_Data &d, in
         }
     }
 
-    // Clear and output
-    delete[] srcbuff;
-
+    // Output
     return dst;
 }
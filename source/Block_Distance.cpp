@@ -0,0 +1,1195 @@
+#include <atomic>
+#include "Block_Distance.h"
+
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BLOCK_DISTANCE_X86_
+#endif
+
+
+#ifdef BLOCK_DISTANCE_X86_
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SIMD_TARGET_AVX2
+#define SIMD_TARGET_AVX512
+#else
+#include <cpuid.h>
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CPU dispatch
+
+
+#ifdef BLOCK_DISTANCE_X86_
+static void CPUID(int info[4], int leaf, int subleaf)
+{
+#ifdef _MSC_VER
+    __cpuidex(info, leaf, subleaf);
+#else
+    unsigned int a = 0, b = 0, c = 0, d = 0;
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+    info[0] = static_cast<int>(a);
+    info[1] = static_cast<int>(b);
+    info[2] = static_cast<int>(c);
+    info[3] = static_cast<int>(d);
+#endif
+}
+
+static uint64 XGETBV(unsigned int index)
+{
+#ifdef _MSC_VER
+    return _xgetbv(index);
+#else
+    uint32 eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+    return (static_cast<uint64>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+
+static SIMD_Level SIMD_Detect_()
+{
+    SIMD_Level level = SIMD_Level::None;
+
+#ifdef BLOCK_DISTANCE_X86_
+    int info[4];
+
+    CPUID(info, 0, 0);
+    const int maxLeaf = info[0];
+
+    CPUID(info, 1, 0);
+    if (!(info[3] & (1 << 26))) return level;
+    level = SIMD_Level::SSE2;
+
+    // OS must save the YMM (and ZMM) states, which is reported by OSXSAVE and XCR0
+    const bool OSXSAVE = (info[2] & (1 << 27)) != 0;
+    const bool AVX = (info[2] & (1 << 28)) != 0;
+    if (!OSXSAVE || !AVX || maxLeaf < 7) return level;
+
+    const uint64 XCR0 = XGETBV(0);
+    if ((XCR0 & 0x06) != 0x06) return level;
+
+    CPUID(info, 7, 0);
+    if (!(info[1] & (1 << 5))) return level;
+    level = SIMD_Level::AVX2;
+
+    if ((XCR0 & 0xE6) != 0xE6) return level;
+    if (!(info[1] & (1 << 16))) return level;
+    level = SIMD_Level::AVX512;
+#endif
+
+    return level;
+}
+
+
+SIMD_Level SIMD_Detect()
+{
+    static const SIMD_Level level = SIMD_Detect_();
+    return level;
+}
+
+
+static std::atomic<int> &SIMD_Current_()
+{
+    static std::atomic<int> level(static_cast<int>(SIMD_Detect()));
+    return level;
+}
+
+
+SIMD_Level SIMD_Current()
+{
+    return static_cast<SIMD_Level>(SIMD_Current_().load());
+}
+
+
+void SIMD_Set(SIMD_Level level)
+{
+    if (static_cast<int>(level) > static_cast<int>(SIMD_Detect()))
+    {
+        level = SIMD_Detect();
+    }
+
+    SIMD_Current_() = static_cast<int>(level);
+}
+
+
+const char *SIMD_Name(SIMD_Level level)
+{
+    switch (level)
+    {
+    case SIMD_Level::SSE2:
+        return "SSE2";
+    case SIMD_Level::AVX2:
+        return "AVX2";
+    case SIMD_Level::AVX512:
+        return "AVX-512";
+    default:
+        return "Scalar";
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// SSD kernels
+// _Size > 0 for the fixed-size square block (height = width = _Size), which is fully unrolled by the compiler,
+// _Size = 0 for arbitrary block size
+// _Bounded to stop once the partial sum exceeds bound, which is checked every 4 rows since the horizontal sum isn't free.
+// Since the squared differences are non-negative, the partial sum reduced in the same order never exceeds the final sum,
+// thus a block stopped early is guaranteed to have a final sum larger than bound.
+
+
+#ifdef BLOCK_DISTANCE_X86_
+static inline double Reduce_SSE2(__m128d sum, double tail)
+{
+    sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+    return _mm_cvtsd_f64(sum) + tail;
+}
+
+static inline float Reduce_SSE2(__m128 sum, float tail)
+{
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+    return _mm_cvtss_f32(sum) + tail;
+}
+
+SIMD_TARGET_AVX2 static inline double Reduce_AVX2(__m256d sum)
+{
+    __m128d sum2 = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+    sum2 = _mm_add_sd(sum2, _mm_unpackhi_pd(sum2, sum2));
+    return _mm_cvtsd_f64(sum2);
+}
+
+SIMD_TARGET_AVX2 static inline float Reduce_AVX2(__m256 sum)
+{
+    __m128 sum2 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    sum2 = _mm_add_ps(sum2, _mm_movehl_ps(sum2, sum2));
+    sum2 = _mm_add_ss(sum2, _mm_shuffle_ps(sum2, sum2, 0x55));
+    return _mm_cvtss_f32(sum2);
+}
+
+
+template < PCType _Size, bool _Bounded >
+static double SSD_SSE2(const double *ref, const double *src, PCType src_stride, PCType height, PCType width, double bound)
+{
+    if (_Size > 0) height = width = _Size;
+
+    const PCType width2 = width & ~1;
+    __m128d sum = _mm_setzero_pd();
+    double tail = 0;
+
+    for (PCType y = 0; y < height; ++y)
+    {
+        PCType x = 0;
+
+        for (; x < width2; x += 2)
+        {
+            const __m128d d = _mm_sub_pd(_mm_loadu_pd(ref + x), _mm_loadu_pd(src + x));
+            sum = _mm_add_pd(sum, _mm_mul_pd(d, d));
+        }
+
+        for (; x < width; ++x)
+        {
+            const double d = ref[x] - src[x];
+            tail += d * d;
+        }
+
+        if (_Bounded && (y & 3) == 3 && y + 1 < height && Reduce_SSE2(sum, tail) > bound)
+        {
+            break;
+        }
+
+        ref += width;
+        src += src_stride;
+    }
+
+    return Reduce_SSE2(sum, tail);
+}
+
+template < PCType _Size, bool _Bounded >
+static float SSD_SSE2(const float *ref, const float *src, PCType src_stride, PCType height, PCType width, float bound)
+{
+    if (_Size > 0) height = width = _Size;
+
+    const PCType width4 = width & ~3;
+    __m128 sum = _mm_setzero_ps();
+    float tail = 0;
+
+    for (PCType y = 0; y < height; ++y)
+    {
+        PCType x = 0;
+
+        for (; x < width4; x += 4)
+        {
+            const __m128 d = _mm_sub_ps(_mm_loadu_ps(ref + x), _mm_loadu_ps(src + x));
+            sum = _mm_add_ps(sum, _mm_mul_ps(d, d));
+        }
+
+        for (; x < width; ++x)
+        {
+            const float d = ref[x] - src[x];
+            tail += d * d;
+        }
+
+        if (_Bounded && (y & 3) == 3 && y + 1 < height && Reduce_SSE2(sum, tail) > bound)
+        {
+            break;
+        }
+
+        ref += width;
+        src += src_stride;
+    }
+
+    return Reduce_SSE2(sum, tail);
+}
+
+
+template < PCType _Size, bool _Bounded >
+SIMD_TARGET_AVX2 static double SSD_AVX2(const double *ref, const double *src, PCType src_stride, PCType height, PCType width, double bound)
+{
+    if (_Size > 0) height = width = _Size;
+
+    const PCType width4 = width & ~3;
+    const __m256i mask = _mm256_cmpgt_epi64(_mm256_set1_epi64x(width - width4), _mm256_setr_epi64x(0, 1, 2, 3));
+    __m256d sum = _mm256_setzero_pd();
+
+    for (PCType y = 0; y < height; ++y)
+    {
+        PCType x = 0;
+
+        for (; x < width4; x += 4)
+        {
+            const __m256d d = _mm256_sub_pd(_mm256_loadu_pd(ref + x), _mm256_loadu_pd(src + x));
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(d, d));
+        }
+
+        if (x < width)
+        {
+            const __m256d d = _mm256_sub_pd(_mm256_maskload_pd(ref + x, mask), _mm256_maskload_pd(src + x, mask));
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(d, d));
+        }
+
+        if (_Bounded && (y & 3) == 3 && y + 1 < height && Reduce_AVX2(sum) > bound)
+        {
+            break;
+        }
+
+        ref += width;
+        src += src_stride;
+    }
+
+    return Reduce_AVX2(sum);
+}
+
+template < PCType _Size, bool _Bounded >
+SIMD_TARGET_AVX2 static float SSD_AVX2(const float *ref, const float *src, PCType src_stride, PCType height, PCType width, float bound)
+{
+    if (_Size > 0) height = width = _Size;
+
+    const PCType width8 = width & ~7;
+    const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(width - width8), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256 sum = _mm256_setzero_ps();
+
+    for (PCType y = 0; y < height; ++y)
+    {
+        PCType x = 0;
+
+        for (; x < width8; x += 8)
+        {
+            const __m256 d = _mm256_sub_ps(_mm256_loadu_ps(ref + x), _mm256_loadu_ps(src + x));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(d, d));
+        }
+
+        if (x < width)
+        {
+            const __m256 d = _mm256_sub_ps(_mm256_maskload_ps(ref + x, mask), _mm256_maskload_ps(src + x, mask));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(d, d));
+        }
+
+        if (_Bounded && (y & 3) == 3 && y + 1 < height && Reduce_AVX2(sum) > bound)
+        {
+            break;
+        }
+
+        ref += width;
+        src += src_stride;
+    }
+
+    return Reduce_AVX2(sum);
+}
+
+
+template < PCType _Size, bool _Bounded >
+SIMD_TARGET_AVX512 static double SSD_AVX512(const double *ref, const double *src, PCType src_stride, PCType height, PCType width, double bound)
+{
+    if (_Size > 0) height = width = _Size;
+
+    const PCType width8 = width & ~7;
+    const __mmask8 mask = static_cast<__mmask8>((1U << (width - width8)) - 1);
+    __m512d sum = _mm512_setzero_pd();
+
+    for (PCType y = 0; y < height; ++y)
+    {
+        PCType x = 0;
+
+        for (; x < width8; x += 8)
+        {
+            const __m512d d = _mm512_sub_pd(_mm512_loadu_pd(ref + x), _mm512_loadu_pd(src + x));
+            sum = _mm512_add_pd(sum, _mm512_mul_pd(d, d));
+        }
+
+        if (x < width)
+        {
+            const __m512d d = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, ref + x), _mm512_maskz_loadu_pd(mask, src + x));
+            sum = _mm512_add_pd(sum, _mm512_mul_pd(d, d));
+        }
+
+        if (_Bounded && (y & 3) == 3 && y + 1 < height && _mm512_reduce_add_pd(sum) > bound)
+        {
+            break;
+        }
+
+        ref += width;
+        src += src_stride;
+    }
+
+    return _mm512_reduce_add_pd(sum);
+}
+
+template < PCType _Size, bool _Bounded >
+SIMD_TARGET_AVX512 static float SSD_AVX512(const float *ref, const float *src, PCType src_stride, PCType height, PCType width, float bound)
+{
+    if (_Size > 0) height = width = _Size;
+
+    const PCType width16 = width & ~15;
+    const __mmask16 mask = static_cast<__mmask16>((1U << (width - width16)) - 1);
+    __m512 sum = _mm512_setzero_ps();
+
+    for (PCType y = 0; y < height; ++y)
+    {
+        PCType x = 0;
+
+        for (; x < width16; x += 16)
+        {
+            const __m512 d = _mm512_sub_ps(_mm512_loadu_ps(ref + x), _mm512_loadu_ps(src + x));
+            sum = _mm512_add_ps(sum, _mm512_mul_ps(d, d));
+        }
+
+        if (x < width)
+        {
+            const __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, ref + x), _mm512_maskz_loadu_ps(mask, src + x));
+            sum = _mm512_add_ps(sum, _mm512_mul_ps(d, d));
+        }
+
+        if (_Bounded && (y & 3) == 3 && y + 1 < height && _mm512_reduce_add_ps(sum) > bound)
+        {
+            break;
+        }
+
+        ref += width;
+        src += src_stride;
+    }
+
+    return _mm512_reduce_add_ps(sum);
+}
+
+
+// Unbounded kernels of Block_SSD::func_type
+template < PCType _Size >
+static double SSD_SSE2(const double *ref, const double *src, PCType src_stride, PCType height, PCType width)
+{
+    return SSD_SSE2<_Size, false>(ref, src, src_stride, height, width, 0);
+}
+
+template < PCType _Size >
+static float SSD_SSE2(const float *ref, const float *src, PCType src_stride, PCType height, PCType width)
+{
+    return SSD_SSE2<_Size, false>(ref, src, src_stride, height, width, 0);
+}
+
+template < PCType _Size >
+SIMD_TARGET_AVX2 static double SSD_AVX2(const double *ref, const double *src, PCType src_stride, PCType height, PCType width)
+{
+    return SSD_AVX2<_Size, false>(ref, src, src_stride, height, width, 0);
+}
+
+template < PCType _Size >
+SIMD_TARGET_AVX2 static float SSD_AVX2(const float *ref, const float *src, PCType src_stride, PCType height, PCType width)
+{
+    return SSD_AVX2<_Size, false>(ref, src, src_stride, height, width, 0);
+}
+
+template < PCType _Size >
+SIMD_TARGET_AVX512 static double SSD_AVX512(const double *ref, const double *src, PCType src_stride, PCType height, PCType width)
+{
+    return SSD_AVX512<_Size, false>(ref, src, src_stride, height, width, 0);
+}
+
+template < PCType _Size >
+SIMD_TARGET_AVX512 static float SSD_AVX512(const float *ref, const float *src, PCType src_stride, PCType height, PCType width)
+{
+    return SSD_AVX512<_Size, false>(ref, src, src_stride, height, width, 0);
+}
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Integer SSD kernels
+// The 8-bit data is zero-extended to 16-bit, then the differences are squared and summed in pairs by pmaddwd.
+// The sums of the 8-bit kernels fit in 32-bit for blocks up to 256x256,
+// while the pair sums of the 15-bit data are accumulated in 64-bit.
+// For 8x8 blocks, the AVX2 kernels process 2 rows at a time.
+
+
+#ifdef BLOCK_DISTANCE_X86_
+static inline uint32 ReduceInt32_SSE2(__m128i sum)
+{
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return static_cast<uint32>(_mm_cvtsi128_si32(sum));
+}
+
+static inline uint64 ReduceInt64_SSE2(__m128i sum)
+{
+    uint64 result;
+    sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(&result), sum);
+    return result;
+}
+
+SIMD_TARGET_AVX2 static inline uint32 ReduceInt32_AVX2(__m256i sum, __m128i sum2)
+{
+    return ReduceInt32_SSE2(_mm_add_epi32(sum2, _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1))));
+}
+
+SIMD_TARGET_AVX2 static inline uint64 ReduceInt64_AVX2(__m256i sum, __m128i sum2)
+{
+    return ReduceInt64_SSE2(_mm_add_epi64(sum2, _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1))));
+}
+
+// Squared differences of 8 pixels summed in pairs
+static inline __m128i SqrDiff_SSE2(const uint8 *ref, const uint8 *src)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i r = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(ref)), zero);
+    const __m128i s = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)), zero);
+    const __m128i d = _mm_sub_epi16(r, s);
+    return _mm_madd_epi16(d, d);
+}
+
+static inline __m128i SqrDiff_SSE2(const uint16 *ref, const uint16 *src)
+{
+    const __m128i d = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ref)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+    return _mm_madd_epi16(d, d);
+}
+
+// Squared differences of the last 8 pixels of the row summed in pairs, the pixels out of mask are zeroed,
+// thus the remaining pixels of a row of at least 8 pixels are covered without reading out of the row
+static inline __m128i SqrDiffTail_SSE2(const uint8 *ref, const uint8 *src, __m128i mask)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i r = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(ref)), zero);
+    const __m128i s = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)), zero);
+    const __m128i d = _mm_and_si128(_mm_sub_epi16(r, s), mask);
+    return _mm_madd_epi16(d, d);
+}
+
+static inline __m128i SqrDiffTail_SSE2(const uint16 *ref, const uint16 *src, __m128i mask)
+{
+    const __m128i d = _mm_and_si128(_mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ref)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src))), mask);
+    return _mm_madd_epi16(d, d);
+}
+
+// Mask of the last rem (< 8) of 8 16-bit lanes
+static inline __m128i TailMask_SSE2(PCType rem)
+{
+    return _mm_cmpgt_epi16(_mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7), _mm_set1_epi16(static_cast<short>(7 - rem)));
+}
+
+// Add the 32-bit pair sums to the 64-bit accumulators
+static inline __m128i Accumulate64_SSE2(__m128i sum, __m128i x)
+{
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_add_epi64(sum, _mm_add_epi64(_mm_unpacklo_epi32(x, zero), _mm_unpackhi_epi32(x, zero)));
+}
+
+SIMD_TARGET_AVX2 static inline __m256i Accumulate64_AVX2(__m256i sum, __m256i x)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    return _mm256_add_epi64(sum, _mm256_add_epi64(_mm256_unpacklo_epi32(x, zero), _mm256_unpackhi_epi32(x, zero)));
+}
+
+
+template < PCType _Size, bool _Bounded, typename _DTy >
+static _DTy SSD_Int_SSE2(const uint8 *ref, const uint8 *src, PCType src_stride, PCType height, PCType width, _DTy bound)
+{
+    if (_Size > 0) height = width = _Size;
+
+    const PCType width8 = width & ~7;
+    const __m128i mask = TailMask_SSE2(width - width8);
+    __m128i sum = _mm_setzero_si128();
+    uint32 tail = 0;
+
+    for (PCType y = 0; y < height; ++y)
+    {
+        PCType x = 0;
+
+        for (; x < width8; x += 8)
+        {
+            sum = _mm_add_epi32(sum, SqrDiff_SSE2(ref + x, src + x));
+        }
+
+        if (x < width && width >= 8)
+        {
+            sum = _mm_add_epi32(sum, SqrDiffTail_SSE2(ref + width - 8, src + width - 8, mask));
+        }
+        else for (; x < width; ++x)
+        {
+            const sint32 d = static_cast<sint32>(ref[x]) - static_cast<sint32>(src[x]);
+            tail += d * d;
+        }
+
+        if (_Bounded && (y & 3) == 3 && y + 1 < height && static_cast<_DTy>(ReduceInt32_SSE2(sum) + tail) > bound)
+        {
+            break;
+        }
+
+        ref += width;
+        src += src_stride;
+    }
+
+    return static_cast<_DTy>(ReduceInt32_SSE2(sum) + tail);
+}
+
+template < PCType _Size, bool _Bounded, typename _DTy >
+static _DTy SSD_Int_SSE2(const uint16 *ref, const uint16 *src, PCType src_stride, PCType height, PCType width, _DTy bound)
+{
+    if (_Size > 0) height = width = _Size;
+
+    const PCType width8 = width & ~7;
+    const __m128i mask = TailMask_SSE2(width - width8);
+    __m128i sum = _mm_setzero_si128();
+    uint64 tail = 0;
+
+    for (PCType y = 0; y < height; ++y)
+    {
+        PCType x = 0;
+
+        for (; x < width8; x += 8)
+        {
+            sum = Accumulate64_SSE2(sum, SqrDiff_SSE2(ref + x, src + x));
+        }
+
+        if (x < width && width >= 8)
+        {
+            sum = Accumulate64_SSE2(sum, SqrDiffTail_SSE2(ref + width - 8, src + width - 8, mask));
+        }
+        else for (; x < width; ++x)
+        {
+            const sint32 d = static_cast<sint32>(ref[x]) - static_cast<sint32>(src[x]);
+            tail += static_cast<uint32>(d * d);
+        }
+
+        if (_Bounded && (y & 3) == 3 && y + 1 < height && static_cast<_DTy>(ReduceInt64_SSE2(sum) + tail) > bound)
+        {
+            break;
+        }
+
+        ref += width;
+        src += src_stride;
+    }
+
+    return static_cast<_DTy>(ReduceInt64_SSE2(sum) + tail);
+}
+
+
+template < PCType _Size, bool _Bounded, typename _DTy >
+SIMD_TARGET_AVX2 static _DTy SSD_Int_AVX2(const uint8 *ref, const uint8 *src, PCType src_stride, PCType height, PCType width, _DTy bound)
+{
+    if (_Size > 0) height = width = _Size;
+
+    __m256i sum = _mm256_setzero_si256();
+    __m128i sum2 = _mm_setzero_si128();
+    uint32 tail = 0;
+
+    if (_Size == 8)
+    {
+        // 2 rows of the ref block are continuous, thus 16 pixels are processed at a time
+        for (PCType y = 0; y < height; y += 2)
+        {
+            const __m128i s = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)),
+                _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + src_stride)));
+            const __m256i d = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ref))),
+                _mm256_cvtepu8_epi16(s));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(d, d));
+
+            if (_Bounded && (y & 3) == 2 && y + 2 < height && static_cast<_DTy>(ReduceInt32_AVX2(sum, sum2)) > bound)
+            {
+                break;
+            }
+
+            ref += 16;
+            src += src_stride * 2;
+        }
+
+        return static_cast<_DTy>(ReduceInt32_AVX2(sum, sum2));
+    }
+
+    const PCType width16 = width & ~15;
+    const PCType width8 = width & ~7;
+    const __m128i mask = TailMask_SSE2(width - width8);
+
+    for (PCType y = 0; y < height; ++y)
+    {
+        PCType x = 0;
+
+        for (; x < width16; x += 16)
+        {
+            const __m256i d = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ref + x))),
+                _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x))));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(d, d));
+        }
+
+        for (; x < width8; x += 8)
+        {
+            sum2 = _mm_add_epi32(sum2, SqrDiff_SSE2(ref + x, src + x));
+        }
+
+        if (x < width && width >= 8)
+        {
+            sum2 = _mm_add_epi32(sum2, SqrDiffTail_SSE2(ref + width - 8, src + width - 8, mask));
+        }
+        else for (; x < width; ++x)
+        {
+            const sint32 d = static_cast<sint32>(ref[x]) - static_cast<sint32>(src[x]);
+            tail += d * d;
+        }
+
+        if (_Bounded && (y & 3) == 3 && y + 1 < height && static_cast<_DTy>(ReduceInt32_AVX2(sum, sum2) + tail) > bound)
+        {
+            break;
+        }
+
+        ref += width;
+        src += src_stride;
+    }
+
+    return static_cast<_DTy>(ReduceInt32_AVX2(sum, sum2) + tail);
+}
+
+template < PCType _Size, bool _Bounded, typename _DTy >
+SIMD_TARGET_AVX2 static _DTy SSD_Int_AVX2(const uint16 *ref, const uint16 *src, PCType src_stride, PCType height, PCType width, _DTy bound)
+{
+    if (_Size > 0) height = width = _Size;
+
+    __m256i sum = _mm256_setzero_si256();
+    __m128i sum2 = _mm_setzero_si128();
+    uint64 tail = 0;
+
+    if (_Size == 8)
+    {
+        // 2 rows of the ref block are continuous, thus 16 pixels are processed at a time
+        for (PCType y = 0; y < height; y += 2)
+        {
+            const __m256i s = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + src_stride)), 1);
+            const __m256i d = _mm256_sub_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(ref)), s);
+            sum = Accumulate64_AVX2(sum, _mm256_madd_epi16(d, d));
+
+            if (_Bounded && (y & 3) == 2 && y + 2 < height && static_cast<_DTy>(ReduceInt64_AVX2(sum, sum2)) > bound)
+            {
+                break;
+            }
+
+            ref += 16;
+            src += src_stride * 2;
+        }
+
+        return static_cast<_DTy>(ReduceInt64_AVX2(sum, sum2));
+    }
+
+    const PCType width16 = width & ~15;
+    const PCType width8 = width & ~7;
+    const __m128i mask = TailMask_SSE2(width - width8);
+
+    for (PCType y = 0; y < height; ++y)
+    {
+        PCType x = 0;
+
+        for (; x < width16; x += 16)
+        {
+            const __m256i d = _mm256_sub_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(ref + x)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x)));
+            sum = Accumulate64_AVX2(sum, _mm256_madd_epi16(d, d));
+        }
+
+        for (; x < width8; x += 8)
+        {
+            sum2 = Accumulate64_SSE2(sum2, SqrDiff_SSE2(ref + x, src + x));
+        }
+
+        if (x < width && width >= 8)
+        {
+            sum2 = Accumulate64_SSE2(sum2, SqrDiffTail_SSE2(ref + width - 8, src + width - 8, mask));
+        }
+        else for (; x < width; ++x)
+        {
+            const sint32 d = static_cast<sint32>(ref[x]) - static_cast<sint32>(src[x]);
+            tail += static_cast<uint32>(d * d);
+        }
+
+        if (_Bounded && (y & 3) == 3 && y + 1 < height && static_cast<_DTy>(ReduceInt64_AVX2(sum, sum2) + tail) > bound)
+        {
+            break;
+        }
+
+        ref += width;
+        src += src_stride;
+    }
+
+    return static_cast<_DTy>(ReduceInt64_AVX2(sum, sum2) + tail);
+}
+
+
+// Unbounded kernels of Block_SSD::func_type
+template < PCType _Size, typename _Ty, typename _DTy >
+static _DTy SSD_Int_SSE2(const _Ty *ref, const _Ty *src, PCType src_stride, PCType height, PCType width)
+{
+    return SSD_Int_SSE2<_Size, false, _DTy>(ref, src, src_stride, height, width, 0);
+}
+
+template < PCType _Size, typename _Ty, typename _DTy >
+SIMD_TARGET_AVX2 static _DTy SSD_Int_AVX2(const _Ty *ref, const _Ty *src, PCType src_stride, PCType height, PCType width)
+{
+    return SSD_Int_AVX2<_Size, false, _DTy>(ref, src, src_stride, height, width, 0);
+}
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions of struct Block_SSD
+
+
+template < typename _Ty >
+static typename Block_SSD<_Ty, _Ty, _Ty>::func_type SSD_Select(PCType height, PCType width, SIMD_Level level)
+{
+#ifdef BLOCK_DISTANCE_X86_
+    const PCType size = height == width ? width : 0;
+
+    switch (level)
+    {
+    case SIMD_Level::AVX512:
+        if (size == 8) return SSD_AVX512<8>;
+        if (size == 11) return SSD_AVX512<11>;
+        return SSD_AVX512<0>;
+    case SIMD_Level::AVX2:
+        if (size == 8) return SSD_AVX2<8>;
+        if (size == 11) return SSD_AVX2<11>;
+        return SSD_AVX2<0>;
+    case SIMD_Level::SSE2:
+        if (size == 8) return SSD_SSE2<8>;
+        if (size == 11) return SSD_SSE2<11>;
+        return SSD_SSE2<0>;
+    default:
+        break;
+    }
+#endif
+
+    return Block_SSD<_Ty, _Ty, _Ty>::Scalar;
+}
+
+
+template < typename _Ty >
+static typename Block_SSD<_Ty, _Ty, _Ty>::bounded_type SSD_SelectBounded(PCType height, PCType width, SIMD_Level level)
+{
+#ifdef BLOCK_DISTANCE_X86_
+    const PCType size = height == width ? width : 0;
+
+    switch (level)
+    {
+    case SIMD_Level::AVX512:
+        if (size == 8) return SSD_AVX512<8, true>;
+        if (size == 11) return SSD_AVX512<11, true>;
+        return SSD_AVX512<0, true>;
+    case SIMD_Level::AVX2:
+        if (size == 8) return SSD_AVX2<8, true>;
+        if (size == 11) return SSD_AVX2<11, true>;
+        return SSD_AVX2<0, true>;
+    case SIMD_Level::SSE2:
+        if (size == 8) return SSD_SSE2<8, true>;
+        if (size == 11) return SSD_SSE2<11, true>;
+        return SSD_SSE2<0, true>;
+    default:
+        break;
+    }
+#endif
+
+    return Block_SSD<_Ty, _Ty, _Ty>::ScalarBounded;
+}
+
+
+Block_SSD<float, float, float>::func_type Block_SSD<float, float, float>::Select(PCType height, PCType width, SIMD_Level level)
+{
+    return SSD_Select<float>(height, width, level);
+}
+
+Block_SSD<float, float, float>::bounded_type Block_SSD<float, float, float>::SelectBounded(PCType height, PCType width, SIMD_Level level)
+{
+    return SSD_SelectBounded<float>(height, width, level);
+}
+
+
+Block_SSD<double, double, double>::func_type Block_SSD<double, double, double>::Select(PCType height, PCType width, SIMD_Level level)
+{
+    return SSD_Select<double>(height, width, level);
+}
+
+Block_SSD<double, double, double>::bounded_type Block_SSD<double, double, double>::SelectBounded(PCType height, PCType width, SIMD_Level level)
+{
+    return SSD_SelectBounded<double>(height, width, level);
+}
+
+
+template < typename _Ty, typename _DTy >
+static typename Block_SSD<_Ty, _Ty, _DTy>::func_type SSD_Int_Select(PCType height, PCType width, SIMD_Level level)
+{
+#ifdef BLOCK_DISTANCE_X86_
+    const PCType size = height == width ? width : 0;
+
+    switch (level)
+    {
+    case SIMD_Level::AVX512:
+    case SIMD_Level::AVX2:
+        if (size == 8) return SSD_Int_AVX2<8, _Ty, _DTy>;
+        if (size == 11) return SSD_Int_AVX2<11, _Ty, _DTy>;
+        return SSD_Int_AVX2<0, _Ty, _DTy>;
+    case SIMD_Level::SSE2:
+        if (size == 8) return SSD_Int_SSE2<8, _Ty, _DTy>;
+        if (size == 11) return SSD_Int_SSE2<11, _Ty, _DTy>;
+        return SSD_Int_SSE2<0, _Ty, _DTy>;
+    default:
+        break;
+    }
+#endif
+
+    return Block_SSD<_Ty, _Ty, _DTy>::Scalar;
+}
+
+
+template < typename _Ty, typename _DTy >
+static typename Block_SSD<_Ty, _Ty, _DTy>::bounded_type SSD_Int_SelectBounded(PCType height, PCType width, SIMD_Level level)
+{
+#ifdef BLOCK_DISTANCE_X86_
+    const PCType size = height == width ? width : 0;
+
+    switch (level)
+    {
+    case SIMD_Level::AVX512:
+    case SIMD_Level::AVX2:
+        if (size == 8) return SSD_Int_AVX2<8, true, _DTy>;
+        if (size == 11) return SSD_Int_AVX2<11, true, _DTy>;
+        return SSD_Int_AVX2<0, true, _DTy>;
+    case SIMD_Level::SSE2:
+        if (size == 8) return SSD_Int_SSE2<8, true, _DTy>;
+        if (size == 11) return SSD_Int_SSE2<11, true, _DTy>;
+        return SSD_Int_SSE2<0, true, _DTy>;
+    default:
+        break;
+    }
+#endif
+
+    return Block_SSD<_Ty, _Ty, _DTy>::ScalarBounded;
+}
+
+
+Block_SSD<uint8, uint8, float>::func_type Block_SSD<uint8, uint8, float>::Select(PCType height, PCType width, SIMD_Level level)
+{
+    return SSD_Int_Select<uint8, float>(height, width, level);
+}
+
+Block_SSD<uint8, uint8, float>::bounded_type Block_SSD<uint8, uint8, float>::SelectBounded(PCType height, PCType width, SIMD_Level level)
+{
+    return SSD_Int_SelectBounded<uint8, float>(height, width, level);
+}
+
+
+Block_SSD<uint8, uint8, double>::func_type Block_SSD<uint8, uint8, double>::Select(PCType height, PCType width, SIMD_Level level)
+{
+    return SSD_Int_Select<uint8, double>(height, width, level);
+}
+
+Block_SSD<uint8, uint8, double>::bounded_type Block_SSD<uint8, uint8, double>::SelectBounded(PCType height, PCType width, SIMD_Level level)
+{
+    return SSD_Int_SelectBounded<uint8, double>(height, width, level);
+}
+
+
+Block_SSD<uint16, uint16, float>::func_type Block_SSD<uint16, uint16, float>::Select(PCType height, PCType width, SIMD_Level level)
+{
+    return SSD_Int_Select<uint16, float>(height, width, level);
+}
+
+Block_SSD<uint16, uint16, float>::bounded_type Block_SSD<uint16, uint16, float>::SelectBounded(PCType height, PCType width, SIMD_Level level)
+{
+    return SSD_Int_SelectBounded<uint16, float>(height, width, level);
+}
+
+
+Block_SSD<uint16, uint16, double>::func_type Block_SSD<uint16, uint16, double>::Select(PCType height, PCType width, SIMD_Level level)
+{
+    return SSD_Int_Select<uint16, double>(height, width, level);
+}
+
+Block_SSD<uint16, uint16, double>::bounded_type Block_SSD<uint16, uint16, double>::SelectBounded(PCType height, PCType width, SIMD_Level level)
+{
+    return SSD_Int_SelectBounded<uint16, double>(height, width, level);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Weighted sum kernels
+// _Sqr to accumulate sum2 as well, the remaining columns of each row are accumulated by the scalar loop
+
+
+#ifdef BLOCK_DISTANCE_X86_
+static inline __m128d LoadPD_SSE2(const double *src)
+{
+    return _mm_loadu_pd(src);
+}
+
+static inline __m128d LoadPD_SSE2(const DType *src)
+{
+    return _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)));
+}
+
+static inline __m128 LoadPS_SSE2(const float *src)
+{
+    return _mm_loadu_ps(src);
+}
+
+static inline __m128 LoadPS_SSE2(const DType *src)
+{
+    return _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+}
+
+SIMD_TARGET_AVX2 static inline __m256d LoadPD_AVX2(const double *src)
+{
+    return _mm256_loadu_pd(src);
+}
+
+SIMD_TARGET_AVX2 static inline __m256d LoadPD_AVX2(const DType *src)
+{
+    return _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+}
+
+SIMD_TARGET_AVX2 static inline __m256 LoadPS_AVX2(const float *src)
+{
+    return _mm256_loadu_ps(src);
+}
+
+SIMD_TARGET_AVX2 static inline __m256 LoadPS_AVX2(const DType *src)
+{
+    return _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src)));
+}
+
+
+template < bool _Sqr, typename _St1 >
+static void WeightedSum_SSE2(double *sum1, double *sum2, const _St1 *src, PCType src_stride, PCType height, PCType width, double weight)
+{
+    const __m128d w = _mm_set1_pd(weight);
+    const PCType width2 = width & ~PCType(1);
+
+    for (PCType y = 0; y < height; ++y, src += src_stride)
+    {
+        PCType x = 0;
+
+        for (; x < width2; x += 2, sum1 += 2)
+        {
+            const __m128d s = LoadPD_SSE2(src + x);
+            const __m128d temp = _mm_mul_pd(s, w);
+            _mm_storeu_pd(sum1, _mm_add_pd(_mm_loadu_pd(sum1), temp));
+
+            if (_Sqr)
+            {
+                _mm_storeu_pd(sum2, _mm_add_pd(_mm_loadu_pd(sum2), _mm_mul_pd(s, temp)));
+                sum2 += 2;
+            }
+        }
+
+        for (; x < width; ++x, ++sum1)
+        {
+            const double temp = static_cast<double>(src[x]) * weight;
+            *sum1 += temp;
+            if (_Sqr) *sum2++ += static_cast<double>(src[x]) * temp;
+        }
+    }
+}
+
+template < bool _Sqr, typename _St1 >
+static void WeightedSum_SSE2(float *sum1, float *sum2, const _St1 *src, PCType src_stride, PCType height, PCType width, float weight)
+{
+    const __m128 w = _mm_set1_ps(weight);
+    const PCType width4 = width & ~PCType(3);
+
+    for (PCType y = 0; y < height; ++y, src += src_stride)
+    {
+        PCType x = 0;
+
+        for (; x < width4; x += 4, sum1 += 4)
+        {
+            const __m128 s = LoadPS_SSE2(src + x);
+            const __m128 temp = _mm_mul_ps(s, w);
+            _mm_storeu_ps(sum1, _mm_add_ps(_mm_loadu_ps(sum1), temp));
+
+            if (_Sqr)
+            {
+                _mm_storeu_ps(sum2, _mm_add_ps(_mm_loadu_ps(sum2), _mm_mul_ps(s, temp)));
+                sum2 += 4;
+            }
+        }
+
+        for (; x < width; ++x, ++sum1)
+        {
+            const float temp = static_cast<float>(src[x]) * weight;
+            *sum1 += temp;
+            if (_Sqr) *sum2++ += static_cast<float>(src[x]) * temp;
+        }
+    }
+}
+
+template < bool _Sqr, typename _St1 >
+SIMD_TARGET_AVX2 static void WeightedSum_AVX2(double *sum1, double *sum2, const _St1 *src, PCType src_stride, PCType height, PCType width, double weight)
+{
+    const __m256d w = _mm256_set1_pd(weight);
+    const PCType width4 = width & ~PCType(3);
+
+    for (PCType y = 0; y < height; ++y, src += src_stride)
+    {
+        PCType x = 0;
+
+        for (; x < width4; x += 4, sum1 += 4)
+        {
+            const __m256d s = LoadPD_AVX2(src + x);
+            const __m256d temp = _mm256_mul_pd(s, w);
+            _mm256_storeu_pd(sum1, _mm256_add_pd(_mm256_loadu_pd(sum1), temp));
+
+            if (_Sqr)
+            {
+                _mm256_storeu_pd(sum2, _mm256_add_pd(_mm256_loadu_pd(sum2), _mm256_mul_pd(s, temp)));
+                sum2 += 4;
+            }
+        }
+
+        for (; x < width; ++x, ++sum1)
+        {
+            const double temp = static_cast<double>(src[x]) * weight;
+            *sum1 += temp;
+            if (_Sqr) *sum2++ += static_cast<double>(src[x]) * temp;
+        }
+    }
+}
+
+template < bool _Sqr, typename _St1 >
+SIMD_TARGET_AVX2 static void WeightedSum_AVX2(float *sum1, float *sum2, const _St1 *src, PCType src_stride, PCType height, PCType width, float weight)
+{
+    const __m256 w = _mm256_set1_ps(weight);
+    const PCType width8 = width & ~PCType(7);
+
+    for (PCType y = 0; y < height; ++y, src += src_stride)
+    {
+        PCType x = 0;
+
+        for (; x < width8; x += 8, sum1 += 8)
+        {
+            const __m256 s = LoadPS_AVX2(src + x);
+            const __m256 temp = _mm256_mul_ps(s, w);
+            _mm256_storeu_ps(sum1, _mm256_add_ps(_mm256_loadu_ps(sum1), temp));
+
+            if (_Sqr)
+            {
+                _mm256_storeu_ps(sum2, _mm256_add_ps(_mm256_loadu_ps(sum2), _mm256_mul_ps(s, temp)));
+                sum2 += 8;
+            }
+        }
+
+        for (; x < width; ++x, ++sum1)
+        {
+            const float temp = static_cast<float>(src[x]) * weight;
+            *sum1 += temp;
+            if (_Sqr) *sum2++ += static_cast<float>(src[x]) * temp;
+        }
+    }
+}
+
+
+template < typename _St1, typename _DTy >
+static void WeightedSum_SSE2(_DTy *sum1, _DTy *sum2, const _St1 *src, PCType src_stride, PCType height, PCType width, _DTy weight)
+{
+    if (sum2) WeightedSum_SSE2<true>(sum1, sum2, src, src_stride, height, width, weight);
+    else WeightedSum_SSE2<false>(sum1, sum2, src, src_stride, height, width, weight);
+}
+
+template < typename _St1, typename _DTy >
+static void WeightedSum_AVX2(_DTy *sum1, _DTy *sum2, const _St1 *src, PCType src_stride, PCType height, PCType width, _DTy weight)
+{
+    if (sum2) WeightedSum_AVX2<true>(sum1, sum2, src, src_stride, height, width, weight);
+    else WeightedSum_AVX2<false>(sum1, sum2, src, src_stride, height, width, weight);
+}
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions of struct Block_WeightedSum
+
+
+template < typename _St1, typename _DTy >
+static typename Block_WeightedSum<_St1, _DTy>::func_type WeightedSum_Select(SIMD_Level level)
+{
+#ifdef BLOCK_DISTANCE_X86_
+    switch (level)
+    {
+    case SIMD_Level::AVX512:
+    case SIMD_Level::AVX2:
+        return WeightedSum_AVX2<_St1, _DTy>;
+    case SIMD_Level::SSE2:
+        return WeightedSum_SSE2<_St1, _DTy>;
+    default:
+        break;
+    }
+#endif
+
+    return Block_WeightedSum<_St1, _DTy>::Scalar;
+}
+
+
+Block_WeightedSum<float, float>::func_type Block_WeightedSum<float, float>::Select(SIMD_Level level)
+{
+    return WeightedSum_Select<float, float>(level);
+}
+
+
+Block_WeightedSum<double, double>::func_type Block_WeightedSum<double, double>::Select(SIMD_Level level)
+{
+    return WeightedSum_Select<double, double>(level);
+}
+
+
+Block_WeightedSum<DType, float>::func_type Block_WeightedSum<DType, float>::Select(SIMD_Level level)
+{
+    return WeightedSum_Select<DType, float>(level);
+}
+
+
+Block_WeightedSum<DType, double>::func_type Block_WeightedSum<DType, double>::Select(SIMD_Level level)
+{
+    return WeightedSum_Select<DType, double>(level);
+}
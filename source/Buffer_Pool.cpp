@@ -0,0 +1,168 @@
+#include "Buffer_Pool.h"
+
+
+// Functions of class BufferPool
+BufferPool::~BufferPool()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    TrimLocked(0);
+}
+
+
+void *BufferPool::Acquire(size_t bytes)
+{
+    const size_t size = BucketSize(bytes);
+    void *memory = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.acquires;
+
+        auto iter = idle_.find(size);
+
+        if (iter != idle_.end() && !iter->second.empty())
+        {
+            memory = iter->second.back();
+            iter->second.pop_back();
+
+            ++stats_.hits;
+            stats_.retained_bytes -= size;
+            stats_.used_bytes += size;
+            used_[memory] = size;
+
+            return memory;
+        }
+
+        ++stats_.misses;
+    }
+
+    // Allocate outside the lock
+    uint8 *block = nullptr;
+    AlignedMalloc(block, size);
+    memory = block;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.used_bytes += size;
+    stats_.peak_bytes = Max(stats_.peak_bytes, stats_.used_bytes + stats_.retained_bytes);
+    used_[memory] = size;
+
+    return memory;
+}
+
+
+void BufferPool::Release(void *memory)
+{
+    if (memory == nullptr)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto iter = used_.find(memory);
+
+    if (iter == used_.end())
+    {
+        DEBUG_FAIL("BufferPool::Release: the memory is not acquired from this pool!");
+    }
+
+    const size_t size = iter->second;
+    used_.erase(iter);
+    stats_.used_bytes -= size;
+
+    if (stats_.retained_bytes + size <= capacity_)
+    {
+        idle_[size].push_back(memory);
+        stats_.retained_bytes += size;
+    }
+    else
+    {
+        ++stats_.drops;
+        lock.unlock();
+
+        uint8 *block = static_cast<uint8 *>(memory);
+        AlignedFree(block);
+    }
+}
+
+
+size_t BufferPool::Capacity() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return capacity_;
+}
+
+void BufferPool::SetCapacity(size_t _Capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = _Capacity;
+    TrimLocked(capacity_);
+}
+
+
+void BufferPool::Trim(size_t retained)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    TrimLocked(retained);
+}
+
+void BufferPool::TrimLocked(size_t retained)
+{
+    // Free the largest blocks first
+    for (auto iter = idle_.rbegin(); iter != idle_.rend() && stats_.retained_bytes > retained; ++iter)
+    {
+        auto &blocks = iter->second;
+
+        while (!blocks.empty() && stats_.retained_bytes > retained)
+        {
+            uint8 *block = static_cast<uint8 *>(blocks.back());
+            blocks.pop_back();
+            AlignedFree(block);
+            stats_.retained_bytes -= iter->first;
+        }
+    }
+}
+
+
+BufferPool::Stats BufferPool::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void BufferPool::ResetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.acquires = 0;
+    stats_.hits = 0;
+    stats_.misses = 0;
+    stats_.drops = 0;
+    stats_.peak_bytes = stats_.used_bytes + stats_.retained_bytes;
+}
+
+
+size_t BufferPool::BucketSize(size_t bytes)
+{
+    const size_t MinBucket = 4096;
+
+    if (bytes <= MinBucket)
+    {
+        return MinBucket;
+    }
+
+    // 8 buckets between each power of 2
+    size_t step = MinBucket;
+
+    while (step * 16 <= bytes)
+    {
+        step *= 2;
+    }
+
+    return (bytes + step - 1) / step * step;
+}
+
+
+BufferPool &BufferPool::Default()
+{
+    static _Myt *pool = new _Myt();
+    return *pool;
+}
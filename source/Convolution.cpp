@@ -1,8 +1,9 @@
 #include <cstring>
 #include "Convolution.h"
 
- 
-Plane & Convolution3V(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, bool norm)
+
+template < typename _Ty >
+Plane_Int<_Ty> & Convolution3V(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm)
 {
     PCType i0, i1, i2, j, upper;
     FLType P0, P1, P2;
@@ -12,7 +13,8 @@ Plane & Convolution3V(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
+    PCType dst_stride = dst.Stride();
 
     FLType FloorFL = static_cast<FLType>(dst.Floor());
     FLType CeilFL = static_cast<FLType>(dst.Ceil());
@@ -59,6 +61,7 @@ Plane & Convolution3V(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
         i1 = stride * j;
         i0 = j < 1 ? i1 : i1 - stride;
         i2 = j >= height - 1 ? i1 : i1 + stride;
+        auto dstp = dst.data() + (dst_stride - stride) * j;
 
         for (upper = stride * j + width; i1 < upper; i0++, i1++, i2++)
         {
@@ -69,7 +72,7 @@ Plane & Convolution3V(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
             R = K0 * P0 + K1 * P1 + K2 * P2;
             if (absVal) R = Abs(R);
             if (clip) R = Clip(R, FloorFL, CeilFL);
-            dst[i1] = static_cast<DType>(R + FLType(0.5));
+            dstp[i1] = static_cast<_Ty>(R + FLType(0.5));
         }
     }
 
@@ -77,7 +80,8 @@ Plane & Convolution3V(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
 }
 
 
-Plane & Convolution3H(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, bool norm)
+template < typename _Ty >
+Plane_Int<_Ty> & Convolution3H(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm)
 {
     PCType i, j, upper;
     FLType P0, P1, P2;
@@ -87,7 +91,8 @@ Plane & Convolution3H(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
+    PCType dst_stride = dst.Stride();
 
     FLType FloorFL = static_cast<FLType>(dst.Floor());
     FLType CeilFL = static_cast<FLType>(dst.Ceil());
@@ -132,6 +137,7 @@ Plane & Convolution3H(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
     for (j = 0; j < height; j++)
     {
         i = stride * j + radius;
+        auto dstp = dst.data() + (dst_stride - stride) * j;
 
         P0 = P1 = P2 = static_cast<FLType>(src[i - radius]);
 
@@ -144,7 +150,7 @@ Plane & Convolution3H(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
             R = K0 * P0 + K1 * P1 + K2 * P2;
             if (absVal) R = Abs(R);
             if (clip) R = Clip(R, FloorFL, CeilFL);
-            dst[i - radius] = static_cast<DType>(R + FLType(0.5));
+            dstp[i - radius] = static_cast<_Ty>(R + FLType(0.5));
         }
 
         for (upper = stride * j + width + radius; i < upper; i++)
@@ -155,7 +161,7 @@ Plane & Convolution3H(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
             R = K0 * P0 + K1 * P1 + K2 * P2;
             if (absVal) R = Abs(R);
             if (clip) R = Clip(R, FloorFL, CeilFL);
-            dst[i - radius] = static_cast<DType>(R + FLType(0.5));
+            dstp[i - radius] = static_cast<_Ty>(R + FLType(0.5));
         }
     }
 
@@ -163,7 +169,8 @@ Plane & Convolution3H(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
 }
 
 
-Plane & Convolution3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm)
+template < typename _Ty >
+Plane_Int<_Ty> & Convolution3(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm)
 {
     PCType i0, i1, i2, j, upper;
     FLType P0, P1, P2, P3, P4, P5, P6, P7, P8;
@@ -173,7 +180,8 @@ Plane & Convolution3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
+    PCType dst_stride = dst.Stride();
 
     FLType FloorFL = static_cast<FLType>(dst.Floor());
     FLType CeilFL = static_cast<FLType>(dst.Ceil());
@@ -226,6 +234,7 @@ Plane & Convolution3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
         i1 = stride * j + radius;
         i0 = j < 1 ? i1 : i1 - stride;
         i2 = j >= height - 1 ? i1 : i1 + stride;
+        auto dstp = dst.data() + (dst_stride - stride) * j;
 
         P0 = P1 = P2 = static_cast<FLType>(src[i0 - radius]);
         P3 = P4 = P5 = static_cast<FLType>(src[i1 - radius]);
@@ -240,7 +249,7 @@ Plane & Convolution3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
             R = K0 * P0 + K1 * P1 + K2 * P2 + K3 * P3 + K4 * P4 + K5 * P5 + K6 * P6 + K7 * P7 + K8 * P8;
             if (absVal) R = Abs(R);
             if (clip) R = Clip(R, FloorFL, CeilFL);
-            dst[i1 - radius] = static_cast<DType>(R + FLType(0.5));
+            dstp[i1 - radius] = static_cast<_Ty>(R + FLType(0.5));
         }
 
         for (upper = stride * j + width + radius; i1 < upper; i0++, i1++, i2++)
@@ -252,7 +261,7 @@ Plane & Convolution3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
             R = K0 * P0 + K1 * P1 + K2 * P2 + K3 * P3 + K4 * P4 + K5 * P5 + K6 * P6 + K7 * P7 + K8 * P8;
             if (absVal) R = Abs(R);
             if (clip) R = Clip(R, FloorFL, CeilFL);
-            dst[i1 - radius] = static_cast<DType>(R + FLType(0.5));
+            dstp[i1 - radius] = static_cast<_Ty>(R + FLType(0.5));
         }
     }
 
@@ -260,7 +269,8 @@ Plane & Convolution3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType
 }
 
 
-Plane & FirstOrderDerivative3(Plane &dst, const Plane &src, FLType K0, FLType K1, FLType K2, FLType K6, FLType K7, FLType K8, bool norm)
+template < typename _Ty >
+Plane_Int<_Ty> & FirstOrderDerivative3(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K6, FLType K7, FLType K8, bool norm)
 {
     PCType i0, i1, i2, j, upper;
     FLType P0, P1, P2, P3, P4, P5, P6, P7, P8;
@@ -270,7 +280,8 @@ Plane & FirstOrderDerivative3(Plane &dst, const Plane &src, FLType K0, FLType K1
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
+    PCType dst_stride = dst.Stride();
 
     FLType FloorFL = static_cast<FLType>(dst.Floor());
     FLType CeilFL = static_cast<FLType>(dst.Ceil());
@@ -320,6 +331,7 @@ Plane & FirstOrderDerivative3(Plane &dst, const Plane &src, FLType K0, FLType K1
         i1 = stride * j + radius;
         i0 = j < 1 ? i1 : i1 - stride;
         i2 = j >= height - 1 ? i1 : i1 + stride;
+        auto dstp = dst.data() + (dst_stride - stride) * j;
 
         P0 = P1 = P2 = static_cast<FLType>(src[i0 - radius]);
         P3 = P4 = P5 = static_cast<FLType>(src[i1 - radius]);
@@ -337,7 +349,7 @@ Plane & FirstOrderDerivative3(Plane &dst, const Plane &src, FLType K0, FLType K1
             if (absVal) R = Abs(R0) + Abs(R1);
             else R = R0 + R1;
             if (clip) R = Clip(R, FloorFL, CeilFL);
-            dst[i1 - radius] = static_cast<DType>(R + FLType(0.5));
+            dstp[i1 - radius] = static_cast<_Ty>(R + FLType(0.5));
         }
 
         for (upper = stride * j + width + radius; i1 < upper; i0++, i1++, i2++)
@@ -352,7 +364,7 @@ Plane & FirstOrderDerivative3(Plane &dst, const Plane &src, FLType K0, FLType K1
             if (absVal) R = Abs(R0) + Abs(R1);
             else R = R0 + R1;
             if (clip) R = Clip(R, FloorFL, CeilFL);
-            dst[i1 - radius] = static_cast<DType>(R + FLType(0.5));
+            dstp[i1 - radius] = static_cast<_Ty>(R + FLType(0.5));
         }
     }
 
@@ -360,7 +372,8 @@ Plane & FirstOrderDerivative3(Plane &dst, const Plane &src, FLType K0, FLType K1
 }
 
 
-Plane & EdgeDetect_Sobel(Plane &dst, const Plane &src)
+template < typename _Ty >
+Plane_Int<_Ty> & EdgeDetect_Sobel(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src)
 {
     PCType i0, i1, i2, j, upper;
     sint32 P0, P1, P2, P3, P4, P5, P6, P7, P8;
@@ -370,7 +383,8 @@ Plane & EdgeDetect_Sobel(Plane &dst, const Plane &src)
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
+    PCType dst_stride = dst.Stride();
 
     dst.ReQuantize(dst.BitDepth(), QuantRange::PC, false);
     sint32 Ceil = static_cast<sint32>(dst.Ceil());
@@ -380,6 +394,7 @@ Plane & EdgeDetect_Sobel(Plane &dst, const Plane &src)
         i1 = stride * j + radius;
         i0 = j < 1 ? i1 : i1 - stride;
         i2 = j >= height - 1 ? i1 : i1 + stride;
+        auto dstp = dst.data() + (dst_stride - stride) * j;
 
         P0 = P1 = P2 = static_cast<sint32>(src[i0 - radius]);
         P3 = P4 = P5 = static_cast<sint32>(src[i1 - radius]);
@@ -395,7 +410,7 @@ Plane & EdgeDetect_Sobel(Plane &dst, const Plane &src)
             R0 = R + P6 + 2 * (P7 - P1) - P2;
             R1 = R + P2 + 2 * (P5 - P3) - P6;
             R = RoundDiv(Abs(R0) + Abs(R1), sint32(8));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dstp[i1 - radius] = static_cast<_Ty>(R);
         }
 
         for (upper = stride * j + width + radius; i1 < upper; i0++, i1++, i2++)
@@ -408,7 +423,7 @@ Plane & EdgeDetect_Sobel(Plane &dst, const Plane &src)
             R0 = R + P6 + 2 * (P7 - P1) - P2;
             R1 = R + P2 + 2 * (P5 - P3) - P6;
             R = RoundDiv(Abs(R0) + Abs(R1), sint32(8));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dstp[i1 - radius] = static_cast<_Ty>(R);
         }
     }
 
@@ -416,7 +431,8 @@ Plane & EdgeDetect_Sobel(Plane &dst, const Plane &src)
 }
 
 
-Plane & EdgeDetect_Prewitt(Plane &dst, const Plane &src)
+template < typename _Ty >
+Plane_Int<_Ty> & EdgeDetect_Prewitt(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src)
 {
     PCType i0, i1, i2, j, upper;
     sint32 P0, P1, P2, P3, P4, P5, P6, P7, P8;
@@ -426,7 +442,8 @@ Plane & EdgeDetect_Prewitt(Plane &dst, const Plane &src)
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
+    PCType dst_stride = dst.Stride();
 
     dst.ReQuantize(dst.BitDepth(), QuantRange::PC, false);
     sint32 Ceil = static_cast<sint32>(dst.Ceil());
@@ -436,6 +453,7 @@ Plane & EdgeDetect_Prewitt(Plane &dst, const Plane &src)
         i1 = stride * j + radius;
         i0 = j < 1 ? i1 : i1 - stride;
         i2 = j >= height - 1 ? i1 : i1 + stride;
+        auto dstp = dst.data() + (dst_stride - stride) * j;
 
         P0 = P1 = P2 = static_cast<sint32>(src[i0 - radius]);
         P3 = P4 = P5 = static_cast<sint32>(src[i1 - radius]);
@@ -451,7 +469,7 @@ Plane & EdgeDetect_Prewitt(Plane &dst, const Plane &src)
             R0 = R + P6 + P7 - P1 - P2;
             R1 = R + P2 + P5 - P3 - P6;
             R = RoundDiv(Abs(R0) + Abs(R1), sint32(6));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dstp[i1 - radius] = static_cast<_Ty>(R);
         }
 
         for (upper = stride * j + width + radius; i1 < upper; i0++, i1++, i2++)
@@ -464,7 +482,7 @@ Plane & EdgeDetect_Prewitt(Plane &dst, const Plane &src)
             R0 = R + P6 + P7 - P1 - P2;
             R1 = R + P2 + P5 - P3 - P6;
             R = RoundDiv(Abs(R0) + Abs(R1), sint32(6));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dstp[i1 - radius] = static_cast<_Ty>(R);
         }
     }
 
@@ -472,7 +490,8 @@ Plane & EdgeDetect_Prewitt(Plane &dst, const Plane &src)
 }
 
 
-Plane & EdgeDetect_Laplace1(Plane &dst, const Plane &src)
+template < typename _Ty >
+Plane_Int<_Ty> & EdgeDetect_Laplace1(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src)
 {
     PCType i0, i1, i2, j, upper;
     sint32 P0, P1, P2, P3, P4, P5, P6, P7, P8;
@@ -482,7 +501,8 @@ Plane & EdgeDetect_Laplace1(Plane &dst, const Plane &src)
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
+    PCType dst_stride = dst.Stride();
 
     sint32 Floor = static_cast<sint32>(dst.Floor());
     sint32 Ceil = static_cast<sint32>(dst.Ceil());
@@ -492,6 +512,7 @@ Plane & EdgeDetect_Laplace1(Plane &dst, const Plane &src)
         i1 = stride * j + radius;
         i0 = j < 1 ? i1 : i1 - stride;
         i2 = j >= height - 1 ? i1 : i1 + stride;
+        auto dstp = dst.data() + (dst_stride - stride) * j;
 
         P0 = P1 = P2 = static_cast<sint32>(src[i0 - radius]);
         P3 = P4 = P5 = static_cast<sint32>(src[i1 - radius]);
@@ -505,7 +526,7 @@ Plane & EdgeDetect_Laplace1(Plane &dst, const Plane &src)
 
             R = 4 * P4 - (P1 + P3 + P5 + P7);
             R = RoundDiv(Abs(R), sint32(4));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dstp[i1 - radius] = static_cast<_Ty>(R);
         }
 
         for (upper = stride * j + width + radius; i1 < upper; i0++, i1++, i2++)
@@ -516,7 +537,7 @@ Plane & EdgeDetect_Laplace1(Plane &dst, const Plane &src)
 
             R = 4 * P4 - (P1 + P3 + P5 + P7);
             R = RoundDiv(Abs(R), sint32(4));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dstp[i1 - radius] = static_cast<_Ty>(R);
         }
     }
 
@@ -524,7 +545,8 @@ Plane & EdgeDetect_Laplace1(Plane &dst, const Plane &src)
 }
 
 
-Plane & EdgeDetect_Laplace2(Plane &dst, const Plane &src)
+template < typename _Ty >
+Plane_Int<_Ty> & EdgeDetect_Laplace2(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src)
 {
     PCType i0, i1, i2, j, upper;
     sint32 P0, P1, P2, P3, P4, P5, P6, P7, P8;
@@ -534,7 +556,8 @@ Plane & EdgeDetect_Laplace2(Plane &dst, const Plane &src)
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
+    PCType dst_stride = dst.Stride();
 
     sint32 Floor = static_cast<sint32>(dst.Floor());
     sint32 Ceil = static_cast<sint32>(dst.Ceil());
@@ -544,6 +567,7 @@ Plane & EdgeDetect_Laplace2(Plane &dst, const Plane &src)
         i1 = stride * j + radius;
         i0 = j < 1 ? i1 : i1 - stride;
         i2 = j >= height - 1 ? i1 : i1 + stride;
+        auto dstp = dst.data() + (dst_stride - stride) * j;
 
         P0 = P1 = P2 = static_cast<sint32>(src[i0 - radius]);
         P3 = P4 = P5 = static_cast<sint32>(src[i1 - radius]);
@@ -557,7 +581,7 @@ Plane & EdgeDetect_Laplace2(Plane &dst, const Plane &src)
 
             R = 8 * P4 - (P0 + P1 + P2 + P3 + P5 + P6 + P7 + P8);
             R = RoundDiv(Abs(R), sint32(8));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dstp[i1 - radius] = static_cast<_Ty>(R);
         }
 
         for (upper = stride * j + width + radius; i1 < upper; i0++, i1++, i2++)
@@ -568,7 +592,7 @@ Plane & EdgeDetect_Laplace2(Plane &dst, const Plane &src)
 
             R = 8 * P4 - (P0 + P1 + P2 + P3 + P5 + P6 + P7 + P8);
             R = RoundDiv(Abs(R), sint32(8));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dstp[i1 - radius] = static_cast<_Ty>(R);
         }
     }
 
@@ -576,7 +600,8 @@ Plane & EdgeDetect_Laplace2(Plane &dst, const Plane &src)
 }
 
 
-Plane & EdgeDetect_Laplace3(Plane &dst, const Plane &src)
+template < typename _Ty >
+Plane_Int<_Ty> & EdgeDetect_Laplace3(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src)
 {
     PCType i0, i1, i2, j, upper;
     sint32 P0, P1, P2, P3, P4, P5, P6, P7, P8;
@@ -586,7 +611,8 @@ Plane & EdgeDetect_Laplace3(Plane &dst, const Plane &src)
 
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
+    PCType dst_stride = dst.Stride();
 
     sint32 Floor = static_cast<sint32>(dst.Floor());
     sint32 Ceil = static_cast<sint32>(dst.Ceil());
@@ -596,6 +622,7 @@ Plane & EdgeDetect_Laplace3(Plane &dst, const Plane &src)
         i1 = stride * j + radius;
         i0 = j < 1 ? i1 : i1 - stride;
         i2 = j >= height - 1 ? i1 : i1 + stride;
+        auto dstp = dst.data() + (dst_stride - stride) * j;
 
         P0 = P1 = P2 = static_cast<sint32>(src[i0 - radius]);
         P3 = P4 = P5 = static_cast<sint32>(src[i1 - radius]);
@@ -609,7 +636,7 @@ Plane & EdgeDetect_Laplace3(Plane &dst, const Plane &src)
 
             R = 12 * P4 - 2 * (P1 + P3 + P5 + P7) - (P0 + P2 + P6 + P8);
             R = RoundDiv(Abs(R), sint32(12));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dstp[i1 - radius] = static_cast<_Ty>(R);
         }
 
         for (upper = stride * j + width + radius; i1 < upper; i0++, i1++, i2++)
@@ -620,7 +647,7 @@ Plane & EdgeDetect_Laplace3(Plane &dst, const Plane &src)
 
             R = 12 * P4 - 2 * (P1 + P3 + P5 + P7) - (P0 + P2 + P6 + P8);
             R = RoundDiv(Abs(R), sint32(12));
-            dst[i1 - radius] = static_cast<DType>(R);
+            dstp[i1 - radius] = static_cast<_Ty>(R);
         }
     }
 
@@ -628,7 +655,8 @@ Plane & EdgeDetect_Laplace3(Plane &dst, const Plane &src)
 }
 
 
-Plane & EdgeDetect(Plane &dst, const Plane &src, EdgeKernel Kernel)
+template < typename _Ty >
+Plane_Int<_Ty> & EdgeDetect(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, EdgeKernel Kernel)
 {
     switch (Kernel)
     {
@@ -651,3 +679,18 @@ Plane & EdgeDetect(Plane &dst, const Plane &src, EdgeKernel Kernel)
 
     return dst;
 }
+
+
+// Explicit instantiations for the integer planes of different storage types
+#define CONVOLUTION_INSTANTIATE(_Ty) \
+    template Plane_Int<_Ty> & Convolution3V(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm); \
+    template Plane_Int<_Ty> & Convolution3H(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, bool norm); \
+    template Plane_Int<_Ty> & Convolution3(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K3, FLType K4, FLType K5, FLType K6, FLType K7, FLType K8, bool norm); \
+    template Plane_Int<_Ty> & FirstOrderDerivative3(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, FLType K0, FLType K1, FLType K2, FLType K6, FLType K7, FLType K8, bool norm); \
+    template Plane_Int<_Ty> & EdgeDetect(Plane_Int<_Ty> &dst, const Plane_Int<_Ty> &src, EdgeKernel Kernel);
+
+CONVOLUTION_INSTANTIATE(DType)
+CONVOLUTION_INSTANTIATE(uint8)
+CONVOLUTION_INSTANTIATE(uint16)
+
+#undef CONVOLUTION_INSTANTIATE
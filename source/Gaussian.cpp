@@ -127,19 +127,32 @@ void RecursiveGaussian::Filter(FLType *dst, const FLType *src, PCType height, PC
 }
 
 
+// The kernels take a single stride for dst and src, thus src is copied to dst first if their strides are different
+static const FLType *MatchStride(Plane_FL &dst, const Plane_FL &src)
+{
+    if (dst.Stride() == src.Stride())
+    {
+        return src.data();
+    }
+
+    CopyData(dst, src);
+    return dst.data();
+}
+
+
 void RecursiveGaussian::FilterV(Plane_FL &dst, const Plane_FL &src)
 {
-    FilterV(dst.data(), src.data(), dst.Height(), dst.Width(), dst.Stride());
+    FilterV(dst.data(), MatchStride(dst, src), dst.Height(), dst.Width(), dst.Stride());
 }
 
 void RecursiveGaussian::FilterH(Plane_FL &dst, const Plane_FL &src)
 {
-    FilterH(dst.data(), src.data(), dst.Height(), dst.Width(), dst.Stride());
+    FilterH(dst.data(), MatchStride(dst, src), dst.Height(), dst.Width(), dst.Stride());
 }
 
 void RecursiveGaussian::Filter(Plane_FL &dst, const Plane_FL &src)
 {
-    Filter(dst.data(), src.data(), dst.Height(), dst.Width(), dst.Stride());
+    Filter(dst.data(), MatchStride(dst, src), dst.Height(), dst.Width(), dst.Stride());
 }
 
 
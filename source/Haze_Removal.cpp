@@ -9,12 +9,36 @@
 const Haze_Removal_Para Haze_Removal_Default;
 
 
+// Multiply one scale of the multi-scale transmission map into tMapInv in one pass
+// The first scale initializes tMapInv, and the last one is fused with the geometric mean.
+template < typename _Ex >
+static void MultiplyScale(Plane_FL &tMapInv, const PlaneExpr<_Ex> &factor, size_t s, size_t scount)
+{
+    const FLType scountRec = FLType(1) / static_cast<FLType>(scount);
+
+    auto geoMean = [=](FLType x)
+    {
+        return pow(x, scountRec);
+    };
+
+    if (s + 1 < scount)
+    {
+        if (s == 0) ASSIGN_PPL(tMapInv, factor);
+        else ASSIGN_PPL(tMapInv, tMapInv * factor);
+    }
+    else
+    {
+        if (s == 0) ASSIGN_PPL(tMapInv, Expr_Map(geoMean, factor));
+        else ASSIGN_PPL(tMapInv, Expr_Map(geoMean, tMapInv * factor));
+    }
+}
+
+
 // Functions for class Haze_Removal
 Frame &Haze_Removal::process_Frame(Frame &dst, const Frame &src)
 {
     height = dst.Height();
     width = dst.Width();
-    stride = dst.Stride();
 
     if (src.isYUV() || dst.isYUV())
     {
@@ -24,6 +48,9 @@ Frame &Haze_Removal::process_Frame(Frame &dst, const Frame &src)
     {
         TransferConvert(dataR, dataG, dataB, src.R(), src.G(), src.B(), TransferChar::linear, para.TransferChar_);
 
+        // Stride of the float point planes, which differs from the stride of dst
+        stride = dataR.Stride();
+
         GetTMapInv();
         GetAtmosLight();
         RemoveHaze();
@@ -216,7 +243,7 @@ void Haze_Removal_Retinex::GetTMapInv()
     }
     else // multi-scale Gaussian filter
     {
-        tMapInv = Plane_FL(refY, true, 1);
+        tMapInv = Plane_FL(refY, false);
         Plane_FL gauss(refY, false);
 
         for (s = 0; s < scount; ++s)
@@ -226,33 +253,15 @@ void Haze_Removal_Retinex::GetTMapInv()
                 RecursiveGaussian GFilter(para.sigmaVector[s], true);
                 GFilter.Filter(gauss, refY);
 
-                LOOP_VH_PPL(height, width, stride, [&](PCType i)
+                MultiplyScale(tMapInv, Expr_Map([](FLType g)
                 {
-                    if (gauss[i] > 0)
-                    {
-                        tMapInv[i] *= gauss[i];
-                    }
-                    else
-                    {
-                        tMapInv[i] = 0;
-                    }
-                });
+                    return g > 0 ? g : FLType(0);
+                }, gauss), s, scount);
             }
             else
             {
-                LOOP_VH_PPL(height, width, stride, [&](PCType i)
-                {
-                    tMapInv[i] *= refY[i];
-                });
+                MultiplyScale(tMapInv, PlaneExpr_Plane<Plane_FL>(refY), s, scount);
             }
         }
-
-        // Calculate geometric mean of multiple scales
-        const FLType scountRec = FLType(1) / static_cast<FLType>(scount);
-
-        LOOP_VH_PPL(height, width, stride, [&](PCType i)
-        {
-            tMapInv[i] = pow(tMapInv[i], scountRec);
-        });
     }
 }
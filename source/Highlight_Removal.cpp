@@ -18,8 +18,10 @@ Frame &Specular_Highlight_Removal(Frame &dst, const Frame &src, const double thr
     Plane &dstG = dst.G();
     Plane &dstB = dst.B();
 
-    PCType i;
-    PCType pcount = srcR.PixelCount();
+    PCType height = srcR.Height();
+    PCType width = srcR.Width();
+    PCType stride = srcR.Stride();
+    PCType dst_stride = dstR.Stride();
     DType ValueRange = srcR.ValueRange();
 
     DType R, G, B;
@@ -37,7 +39,7 @@ Frame &Specular_Highlight_Removal(Frame &dst, const Frame &src, const double thr
 
     // Compute σ_max at every pixel using the src image and store it as a grayscale image.
     // Compute λ_max at every pixel using the src image and store it as a grayscale image.
-    for (i = 0; i < pcount; i++)
+    LOOP_VH(height, width, stride, [&](PCType i)
     {
         R = srcR[i];
         G = srcG[i];
@@ -61,7 +63,7 @@ Frame &Specular_Highlight_Removal(Frame &dst, const Frame &src, const double thr
 
         PsigmaMax[i] = (DType)(sigmaMax * ValueRange + 0.5);
         PlambdaMax[i] = sigmaMax == sigmaMin ? 0 : (DType)((sigmaMax - sigmaMin) / (1 - 3 * sigmaMin) * ValueRange + 0.5);
-    }
+    });
 
     // repeat until σ_maxF − σ_max < 0.03 at every pixel.
     PCType flag = 1;
@@ -76,7 +78,9 @@ Frame &Specular_Highlight_Removal(Frame &dst, const Frame &src, const double thr
         Bilateral2D(PsigmaMaxF, PsigmaMax, PlambdaMax, blData);
 
         // For each pixel p, σ_max(p) = max(σ_max(p), σ_maxF(p))
-        for (i = 0, flag = 0; i < pcount; i++)
+        flag = 0;
+
+        LOOP_VH(height, width, stride, [&](PCType i)
         {
             if (PsigmaMaxF[i] > PsigmaMax[i])
             {
@@ -87,11 +91,11 @@ Frame &Specular_Highlight_Removal(Frame &dst, const Frame &src, const double thr
 
                 PsigmaMax[i] = PsigmaMaxF[i];
             }
-        }
+        });
     }
 
     // Compute diffuse component
-    for (i = 0; i < pcount; i++)
+    LOOP_VH(height, width, dst_stride, stride, [&](PCType o, PCType i)
     {
         R = srcR[i];
         G = srcG[i];
@@ -100,16 +104,16 @@ Frame &Specular_Highlight_Removal(Frame &dst, const Frame &src, const double thr
 
         if (PsigmaMax[i] * 3 <= ValueRange)
         {
-            dstR[i] = R;
-            dstG[i] = G;
-            dstB[i] = B;
+            dstR[o] = R;
+            dstG[o] = G;
+            dstB[o] = B;
         }
         else
         {
             specular_component = (Max(Max(R, G), B) - sigmaMax*(R + G + B)) / (1 - 3 * sigmaMax);
-            dstR[i] = dstR.Quantize(R - specular_component);
-            dstG[i] = dstG.Quantize(G - specular_component);
-            dstB[i] = dstB.Quantize(B - specular_component);
+            dstR[o] = dstR.Quantize(R - specular_component);
+            dstG[o] = dstG.Quantize(G - specular_component);
+            dstB[o] = dstB.Quantize(B - specular_component);
         }
         /*dst.R()[i] = PsigmaMax[i];
         dst.G()[i] = PsigmaMax[i];
@@ -117,7 +121,7 @@ Frame &Specular_Highlight_Removal(Frame &dst, const Frame &src, const double thr
         /*dst.R()[i] = PlambdaMax[i];
         dst.G()[i] = PlambdaMax[i];
         dst.B()[i] = PlambdaMax[i];*/
-    }
+    });
 
     // Output
     return dst;
@@ -142,7 +142,7 @@ Frame & Histogram_Equalization(Frame &dst, const Frame &src, FLType strength, bo
     PCType i, j, upper;
     PCType height = src.Height();
     PCType width = src.Width();
-    PCType stride = src.Width();
+    PCType stride = src.Stride();
 
     if (src.isYUV())
     {
@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <cctype>
 #include <ctime>
+#include <chrono>
 #include "ISP_MW.h"
 
 
@@ -11,6 +12,7 @@
 #define Test_Func Test_Speed
 //#define Test_Func Test_Write
 //#define Test_Func Test_Other
+//#define Test_Func Test_BlockMatching
 
 //#define Convolution_
 //#define EdgeDetect_
@@ -177,6 +179,119 @@ int Test_Other()
 }
 
 
+// Throughput of block-matching distance kernels of the plane for each instruction set level supported by the CPU
+template < typename _St1 >
+static void Test_BlockMatching(const _St1 &src, const char *name, int Loop, PCType range, double thMSE)
+{
+    typedef Block<typename _St1::value_type, FLType> block_type;
+
+    const PCType width = src.Width();
+    const PCType height = src.Height();
+    const PCType BlockSizes[] = { 8, 11, 16 };
+
+    const SIMD_Level maxLevel = SIMD_Detect();
+
+    for (PCType BlockSize : BlockSizes)
+    {
+        block_type refBlock(src, BlockSize, BlockSize, typename block_type::PosType(height / 2, width / 2));
+
+        typename block_type::PosCode search_pos;
+
+        for (PCType j = -range; j <= range; ++j)
+        {
+            for (PCType i = -range; i <= range; ++i)
+            {
+                search_pos.push_back(typename block_type::PosType(height / 2 + j, width / 2 + i));
+            }
+        }
+
+        typename block_type::PosPairCode match_code;
+        match_code.reserve(search_pos.size());
+
+        for (int level = 0; level <= static_cast<int>(maxLevel); ++level)
+        {
+            SIMD_Set(static_cast<SIMD_Level>(level));
+
+            auto start = std::chrono::high_resolution_clock::now();
+
+            for (int l = 0; l < Loop; l++)
+            {
+                match_code.clear();
+                refBlock.BlockMatchingMulti(match_code, src, search_pos, thMSE);
+            }
+
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            double candidates = static_cast<double>(search_pos.size()) * Loop;
+
+            std::cout << name << ", BlockSize " << BlockSize << "x" << BlockSize << ", " << SIMD_Name(static_cast<SIMD_Level>(level))
+                << ": " << candidates / elapsed.count() << " candidates/s\n";
+        }
+    }
+
+    SIMD_Set(maxLevel);
+}
+
+
+// The float kernels and the integer kernels of the quantized planes (BM3D_Para_Base::BMdepth)
+int Test_BlockMatching()
+{
+    const int Loop = 200;
+    const PCType width = 512;
+    const PCType height = 512;
+    const PCType range = 24;
+    const double thMSE = 400;
+
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<FLType> dist(0, 1);
+
+    Plane_FL src(FLType(0), width, height, true, false, false);
+
+    FOR_EACH(src, [&](FLType &x)
+    {
+        x = dist(gen);
+    });
+
+    std::cout.unsetf(std::ios_base::showpos);
+
+    Test_BlockMatching(src, "Float", Loop, range, thMSE);
+    Test_BlockMatching(Plane_8(src, 8), "8-bit", Loop, range, thMSE);
+    Test_BlockMatching(Plane_16(src, 15), "15-bit", Loop, range, thMSE);
+
+    std::cout.setf(std::ios_base::showpos);
+
+    return 0;
+}
+
+
+// PSNR of each plane of the test image against the reference image
+// Used to compare the output of the single precision build (FLTYPE_FLOAT) with the double precision build
+int Compare_PSNR(const std::string &RefPath, const std::string &TestPath)
+{
+    const Frame RefFrame = ImageReader(RefPath);
+    const Frame TestFrame = ImageReader(TestPath);
+
+    if (RefFrame.PlaneCount() != TestFrame.PlaneCount()
+        || RefFrame.Width() != TestFrame.Width() || RefFrame.Height() != TestFrame.Height())
+    {
+        std::cerr << "Compare_PSNR: the size of \"" << TestPath << "\" doesn't match \"" << RefPath << "\".\n";
+        return 1;
+    }
+
+    std::cout.unsetf(std::ios_base::showpos);
+    std::cout.setf(std::ios_base::fixed, std::ios_base::floatfield);
+    std::cout.precision(3);
+
+    for (Frame::PlaneCountType i = 0; i < RefFrame.PlaneCount(); i++)
+    {
+        std::cout << "Plane " << i << ": PSNR " << GetPSNR(RefFrame.P(i), TestFrame.P(i)) << " dB\n";
+    }
+
+    std::cout << "Frame: PSNR " << GetPSNR(RefFrame, TestFrame) << " dB\n";
+
+    return 0;
+}
+
+
 int main(int argc, char ** argv)
 {
     srand(static_cast<unsigned int>(time(0)));
@@ -202,6 +317,21 @@ int Filtering(const int argc, char ** argv)
 {
     int i;
 
+    if (argc == 2 && std::string(argv[1]) == "--bm_benchmark")
+    {
+        return Test_BlockMatching();
+    }
+
+    if (argc == 3 && std::string(argv[1]) == "--fftw_wisdom")
+    {
+        return BM3D_Warm_Wisdom(argv[2]);
+    }
+
+    if (argc == 4 && std::string(argv[1]) == "--psnr")
+    {
+        return Compare_PSNR(argv[2], argv[3]);
+    }
+
     if (argc <= 2)
     {
         std::cout << "Not enough arguments specified.\n";
@@ -221,6 +351,35 @@ int Filtering(const int argc, char ** argv)
 
     FilterIO *filterIOPtr = nullptr;
 
+    if (FilterName == "--pipeline")
+    {
+        filterIOPtr = new Pipeline_IO(CreateFilterIO);
+    }
+    else
+    {
+        filterIOPtr = CreateFilterIO(FilterName);
+    }
+
+    if (filterIOPtr == nullptr)
+    {
+        return 1;
+    }
+
+    filterIOPtr->SetArgs(argc2, args);
+    filterIOPtr->operator()();
+    delete filterIOPtr;
+
+    return 0;
+}
+
+
+FilterIO *CreateFilterIO(const std::string &_FilterName)
+{
+    FilterIO *filterIOPtr = nullptr;
+
+    std::string FilterName = _FilterName;
+    std::transform(FilterName.begin(), FilterName.end(), FilterName.begin(), tolower);
+
     if (FilterName == "--gaussian")
     {
         filterIOPtr = new _Gaussian2D_IO;
@@ -269,21 +428,18 @@ int Filtering(const int argc, char ** argv)
     {
         filterIOPtr = new BM3D_IO;
     }
+    else if (FilterName == "--vbm3d")
+    {
+        filterIOPtr = new VBM3D_IO;
+    }
     else if (FilterName == "--hrr" || FilterName == "--haze_removal" || FilterName == "--haze_removal_retinex")
     {
         filterIOPtr = new _Haze_Removal_Retinex_IO;
     }
     else
     {
-        return 1;
+        return nullptr;
     }
 
-    if (filterIOPtr != nullptr)
-    {
-        filterIOPtr->SetArgs(argc2, args);
-        filterIOPtr->operator()();
-        delete filterIOPtr;
-    }
-
-    return 0;
+    return filterIOPtr;
 }
@@ -1,17 +1,77 @@
 #define ENABLE_PPL
 
 
+#include <atomic>
 #include "Image_Type.h"
 #include "Conversion.hpp"
 
 
-// Functions of class Plane
-void Plane::DefaultPara(bool Chroma, value_type _BitDepth, QuantRange _QuantRange)
+// Layout of the newly allocated planes
+#ifdef _CUDA_
+static std::atomic<size_t> Plane_Alignment_(0);
+#else
+static std::atomic<size_t> Plane_Alignment_(64);
+#endif
+static std::atomic<PCType> Plane_Apron_(0);
+
+
+size_t Plane_Alignment()
+{
+    return Plane_Alignment_;
+}
+
+void Plane_SetAlignment(size_t alignment)
+{
+    Plane_Alignment_ = alignment;
+}
+
+PCType Plane_Apron()
+{
+    return Plane_Apron_;
+}
+
+void Plane_SetApron(PCType apron)
+{
+    Plane_Apron_ = apron > 0 ? apron : 0;
+}
+
+
+// Functions of class Plane_Int
+template < typename _Ty >
+void Plane_Int<_Ty>::Alloc(PCType _Apron, PCType _StrideHint)
+{
+    Apron_ = _Apron;
+    Plane_Alloc(Alloc_, Data_, Stride_, Width_, Height_, Apron_, _StrideHint);
+}
+
+template < typename _Ty >
+void Plane_Int<_Ty>::Free()
+{
+    Plane_Free(Alloc_);
+    Data_ = nullptr;
+}
+
+template < typename _Ty >
+void Plane_Int<_Ty>::Borrow(pointer _Data, PCType _Width, PCType _Height, PCType _Stride)
+{
+    Free();
+
+    Width_ = _Width;
+    Height_ = _Height;
+    PixelCount_ = _Width * _Height;
+    Stride_ = _Stride;
+    Apron_ = 0;
+    Data_ = _Data;
+}
+
+template < typename _Ty >
+void Plane_Int<_Ty>::DefaultPara(bool Chroma, para_type _BitDepth, QuantRange _QuantRange)
 {
     Quantize_Value(Floor_, Neutral_, Ceil_, _BitDepth, _QuantRange, Chroma);
 }
 
-void Plane::CopyParaFrom(const _Myt &src)
+template < typename _Ty >
+void Plane_Int<_Ty>::CopyParaFrom(const _Myt &src)
 {
     Width_ = src.Width();
     Height_ = src.Height();
@@ -23,13 +83,14 @@ void Plane::CopyParaFrom(const _Myt &src)
     TransferChar_ = src.GetTransferChar();
 }
 
-void Plane::InitValue(value_type Value, bool Init)
+template < typename _Ty >
+void Plane_Int<_Ty>::InitValue(value_type Value, bool Init)
 {
     if (Init)
     {
         Value = Quantize(Value);
 
-        if (Value != 0)
+        if (Value != 0 || isView())
         {
             for_each([&](value_type &x)
             {
@@ -38,22 +99,24 @@ void Plane::InitValue(value_type Value, bool Init)
         }
         else
         {
-            memset(data(), Value, sizeof(value_type) * size());
+            memset(Alloc_, 0, sizeof(value_type) * (Height_ + Apron_ * 2) * Stride_);
         }
     }
 }
 
 
-Plane::Plane(value_type Value, PCType _Width, PCType _Height, value_type _BitDepth, bool Init)
-    : _Myt(Value, _Width, _Height, _BitDepth, 0, 0, (value_type(1) << _BitDepth) - 1,
+template < typename _Ty >
+Plane_Int<_Ty>::Plane_Int(value_type Value, PCType _Width, PCType _Height, para_type _BitDepth, bool Init)
+    : _Myt(Value, _Width, _Height, _BitDepth, 0, 0, (para_type(1) << _BitDepth) - 1,
     TransferChar_Default(_Width, _Height, true), Init)
 {}
 
-Plane::Plane(value_type Value, PCType _Width, PCType _Height, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar, bool Init)
+template < typename _Ty >
+Plane_Int<_Ty>::Plane_Int(value_type Value, PCType _Width, PCType _Height, para_type _BitDepth, para_type _Floor, para_type _Neutral, para_type _Ceil, TransferChar _TransferChar, bool Init)
     : Width_(_Width), Height_(_Height), PixelCount_(_Width * _Height), BitDepth_(_BitDepth),
     Floor_(_Floor), Neutral_(_Neutral), Ceil_(_Ceil), TransferChar_(_TransferChar)
 {
-    const char *FunctionName = "class Plane constructor";
+    const char *FunctionName = "class Plane_Int constructor";
     if (_BitDepth > MaxBitDepth)
     {
         std::cerr << FunctionName << ": \"BitDepth=" << _BitDepth << "\" is invalid, maximum allowed bit depth is " << MaxBitDepth << ".\n";
@@ -64,7 +127,7 @@ Plane::Plane(value_type Value, PCType _Width, PCType _Height, value_type _BitDep
         std::cerr << FunctionName << ": invalid values of \"Floor=" << _Floor << "\" and \"Ceil=" << _Ceil << "\" are set.\n";
         DEBUG_BREAK;
     }
-    if (ValueRange() >= value_type(1) << _BitDepth)
+    if (ValueRange() >= para_type(1) << _BitDepth)
     {
         std::cerr << FunctionName << ": \"Ceil-Floor=" << ValueRange() << "\" exceeds \"BitDepth=" << _BitDepth << "\" limit.\n";
         DEBUG_BREAK;
@@ -74,97 +137,166 @@ Plane::Plane(value_type Value, PCType _Width, PCType _Height, value_type _BitDep
         std::cerr << FunctionName << ": invalid values of \"Floor=" << _Floor << "\", \"Neutral=" << _Neutral << "\" and \"Ceil=" << _Ceil << "\" are set.\n";
         DEBUG_BREAK;
     }
+    if (_Floor < value_type_MIN || _Ceil > value_type_MAX)
+    {
+        std::cerr << FunctionName << ": values of \"Floor=" << _Floor << "\" and \"Ceil=" << _Ceil << "\" exceed the range of the storage type.\n";
+        DEBUG_BREAK;
+    }
 
-    AlignedMalloc(Data_, size());
+    Alloc(Plane_Apron());
 
     InitValue(Value, Init);
 }
 
-Plane::Plane(const _Myt &src)
-    : _Myt(src, false)
+template < typename _Ty >
+Plane_Int<_Ty>::Plane_Int(const _Myt &src)
+    : Width_(src.Width()), Height_(src.Height()), PixelCount_(src.PixelCount()), BitDepth_(src.BitDepth()),
+    Floor_(src.Floor()), Neutral_(src.Neutral()), Ceil_(src.Ceil()), TransferChar_(src.GetTransferChar())
 {
-    memcpy(data(), src.data(), sizeof(value_type) * size());
+    Alloc(src.Apron(), Plane_StrideHint<value_type>(src));
+
+    CopyData(*this, src);
 }
 
-Plane::Plane(const _Myt &src, bool Init, value_type Value)
-    : _Myt(Value, src.Width(), src.Height(), src.BitDepth(), src.Floor(), src.Neutral(), src.Ceil(), src.GetTransferChar(), Init)
-{}
+template < typename _Ty >
+Plane_Int<_Ty>::Plane_Int(const _Myt &src, bool Init, value_type Value)
+    : Width_(src.Width()), Height_(src.Height()), PixelCount_(src.PixelCount()), BitDepth_(src.BitDepth()),
+    Floor_(src.Floor()), Neutral_(src.Neutral()), Ceil_(src.Ceil()), TransferChar_(src.GetTransferChar())
+{
+    Alloc(src.Apron(), Plane_StrideHint<value_type>(src));
 
-Plane::Plane(_Myt &&src)
+    InitValue(Value, Init);
+}
+
+template < typename _Ty >
+Plane_Int<_Ty>::Plane_Int(_Myt &&src)
     : Width_(src.Width()), Height_(src.Height()), PixelCount_(src.PixelCount()), BitDepth_(src.BitDepth()),
     Floor_(src.Floor()), Neutral_(src.Neutral()), Ceil_(src.Ceil()), TransferChar_(src.GetTransferChar())
 {
-    Data_ = src.data();
+    // Moving from a view copies the pixels, thus the new plane always owns its memory
+    if (src.isView())
+    {
+        Alloc(src.Apron(), Plane_StrideHint<value_type>(src));
+        CopyData(*this, src);
+        return;
+    }
+
+    Stride_ = src.Stride_;
+    Apron_ = src.Apron_;
+    Data_ = src.Data_;
+    Alloc_ = src.Alloc_;
 
     src.Width_ = 0;
     src.Height_ = 0;
     src.PixelCount_ = 0;
     src.Data_ = nullptr;
+    src.Alloc_ = nullptr;
 }
 
-Plane::Plane(const Plane_FL &src, value_type _BitDepth)
-    : _Myt(src, _BitDepth, 0, 0, (value_type(1) << _BitDepth) - 1)
+template < typename _Ty >
+Plane_Int<_Ty>::Plane_Int(const Plane_FL &src, para_type _BitDepth)
+    : _Myt(src, _BitDepth, 0, 0, (para_type(1) << _BitDepth) - 1)
 {}
 
-Plane::Plane(const Plane_FL &src, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil)
+template < typename _Ty >
+Plane_Int<_Ty>::Plane_Int(const Plane_FL &src, para_type _BitDepth, para_type _Floor, para_type _Neutral, para_type _Ceil)
     : _Myt(src, false, 0, _BitDepth, _Floor, _Neutral, _Ceil)
 {
     RangeConvert(*this, src);
 }
 
-Plane::Plane(const Plane_FL &src, bool Init, value_type Value, value_type _BitDepth)
-    : _Myt(src, Init, Value, _BitDepth, 0, 0, (value_type(1) << _BitDepth) - 1)
+template < typename _Ty >
+Plane_Int<_Ty>::Plane_Int(const Plane_FL &src, bool Init, value_type Value, para_type _BitDepth)
+    : _Myt(src, Init, Value, _BitDepth, 0, 0, (para_type(1) << _BitDepth) - 1)
 {}
 
-Plane::Plane(const Plane_FL &src, bool Init, value_type Value, value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil)
-    : _Myt(Value, src.Width(), src.Height(), _BitDepth, _Floor, _Neutral, _Ceil, src.GetTransferChar(), Init)
-{}
+template < typename _Ty >
+Plane_Int<_Ty>::Plane_Int(const Plane_FL &src, bool Init, value_type Value, para_type _BitDepth, para_type _Floor, para_type _Neutral, para_type _Ceil)
+    : _Myt(Value, src.Width(), src.Height(), _BitDepth, _Floor, _Neutral, _Ceil, src.GetTransferChar(), false)
+{
+    const PCType _StrideHint = Plane_StrideHint<value_type>(src);
 
+    if (Apron_ != src.Apron() || (_StrideHint > 0 && Stride_ != _StrideHint))
+    {
+        Free();
+        Alloc(src.Apron(), _StrideHint);
+    }
+
+    InitValue(Value, Init);
+}
 
-Plane::~Plane()
+
+template < typename _Ty >
+Plane_Int<_Ty>::~Plane_Int()
 {
-    AlignedFree(Data_);
+    Free();
 }
 
 
-Plane &Plane::operator=(const _Myt &src)
+template < typename _Ty >
+Plane_Int<_Ty> &Plane_Int<_Ty>::operator=(const _Myt &src)
 {
     if (this == &src)
     {
         return *this;
     }
 
+    // Write the pixels through the view
+    if (isView())
+    {
+        if (Width() != src.Width() || Height() != src.Height())
+        {
+            DEBUG_FAIL("Plane_Int::operator=: the size of the view and \"src\" must be the same.");
+        }
+
+        CopyParaFrom(src);
+        CopyData(*this, src);
+
+        return *this;
+    }
+
     CopyParaFrom(src);
 
-    AlignedFree(Data_);
-    AlignedMalloc(Data_, size());
+    Free();
+    Alloc(src.Apron(), Plane_StrideHint<value_type>(src));
 
-    memcpy(data(), src.data(), sizeof(value_type) * size());
+    CopyData(*this, src);
 
     return *this;
 }
 
-Plane &Plane::operator=(_Myt &&src)
+template < typename _Ty >
+Plane_Int<_Ty> &Plane_Int<_Ty>::operator=(_Myt &&src)
 {
     if (this == &src)
     {
         return *this;
     }
 
+    if (isView() || src.isView())
+    {
+        return *this = static_cast<const _Myt &>(src);
+    }
+
     CopyParaFrom(src);
 
-    AlignedFree(Data_);
-    Data_ = src.data();
+    Free();
+    Stride_ = src.Stride_;
+    Apron_ = src.Apron_;
+    Data_ = src.Data_;
+    Alloc_ = src.Alloc_;
 
     src.Width_ = 0;
     src.Height_ = 0;
     src.PixelCount_ = 0;
     src.Data_ = nullptr;
+    src.Alloc_ = nullptr;
 
     return *this;
 }
 
-bool Plane::operator==(const _Myt &b) const
+template < typename _Ty >
+bool Plane_Int<_Ty>::operator==(const _Myt &b) const
 {
     if (this == &b)
     {
@@ -177,35 +309,38 @@ bool Plane::operator==(const _Myt &b) const
         return false;
     }
 
-    PCType i;
-    for (i = 0; Data_[i] == b.Data_[i] && i < PixelCount(); i++);
-    if (i < PixelCount())
+    for (PCType j = 0; j < Height(); j++)
     {
-        return false;
-    }
-    else
-    {
-        return true;
+        if (memcmp(Data_ + j * Stride(), b.Data_ + j * b.Stride(), sizeof(value_type) * Width()) != 0)
+        {
+            return false;
+        }
     }
+
+    return true;
 }
 
 
-Plane::value_type Plane::Min() const
+template < typename _Ty >
+typename Plane_Int<_Ty>::value_type Plane_Int<_Ty>::Min() const
 {
     return GetMin(*this);
 }
 
-Plane::value_type Plane::Max() const
+template < typename _Ty >
+typename Plane_Int<_Ty>::value_type Plane_Int<_Ty>::Max() const
 {
     return GetMax(*this);
 }
 
-void Plane::MinMax(reference min, reference max) const
+template < typename _Ty >
+void Plane_Int<_Ty>::MinMax(reference min, reference max) const
 {
     GetMinMax(*this, min, max);
 }
 
-FLType Plane::Mean() const
+template < typename _Ty >
+FLType Plane_Int<_Ty>::Mean() const
 {
     uint64 Sum = 0;
 
@@ -217,7 +352,8 @@ FLType Plane::Mean() const
     return static_cast<FLType>(Sum) / PixelCount();
 }
 
-FLType Plane::Variance(FLType Mean) const
+template < typename _Ty >
+FLType Plane_Int<_Ty>::Variance(FLType Mean) const
 {
     FLType diff;
     FLType Sum = 0;
@@ -232,41 +368,59 @@ FLType Plane::Variance(FLType Mean) const
 }
 
 
-Plane &Plane::ReSize(PCType _Width, PCType _Height)
+template < typename _Ty >
+Plane_Int<_Ty> &Plane_Int<_Ty>::ReSize(PCType _Width, PCType _Height)
 {
     if (Width() != _Width || Height() != _Height)
     {
-        auto newPC = _Width * _Height;
-
-        if (PixelCount() != newPC)
+        if (isView())
         {
-            auto originPC = PixelCount();
-            PixelCount_ = newPC;
-
-            if (newPC == 0)
-            {
-                AlignedFree(Data_);
-            }
-            else if (originPC == 0)
-            {
-                AlignedMalloc(Data_, newPC);
-            }
-            else
-            {
-                AlignedRealloc(Data_, newPC);
-            }
+            DEBUG_FAIL("Plane_Int::ReSize: a view can't be resized.");
         }
 
+        Free();
+
         Width_ = _Width;
         Height_ = _Height;
+        PixelCount_ = _Width * _Height;
+
+        Alloc(Apron_);
+    }
+
+    return *this;
+}
+
+template < typename _Ty >
+Plane_Int<_Ty> &Plane_Int<_Ty>::SetApron(PCType _Apron)
+{
+    if (Apron_ != _Apron)
+    {
+        if (isView())
+        {
+            DEBUG_FAIL("Plane_Int::SetApron: a view can't be re-allocated.");
+        }
+
+        _Myt temp(std::move(*this));
+
+        CopyParaFrom(temp);
+        Alloc(_Apron);
+
+        CopyData(*this, temp);
     }
 
     return *this;
 }
 
-Plane &Plane::ReQuantize(value_type _BitDepth, QuantRange _QuantRange, bool scale, bool clip)
+template < typename _Ty >
+void Plane_Int<_Ty>::ExtendBorder()
+{
+    ::ExtendBorder(*this);
+}
+
+template < typename _Ty >
+Plane_Int<_Ty> &Plane_Int<_Ty>::ReQuantize(para_type _BitDepth, QuantRange _QuantRange, bool scale, bool clip)
 {
-    const char *FunctionName = "Plane::ReQuantize";
+    const char *FunctionName = "Plane_Int::ReQuantize";
     if (_BitDepth > MaxBitDepth)
     {
         std::cerr << FunctionName << ": \"BitDepth=" << _BitDepth
@@ -274,16 +428,17 @@ Plane &Plane::ReQuantize(value_type _BitDepth, QuantRange _QuantRange, bool scal
         DEBUG_BREAK;
     }
 
-    value_type _Floor, _Neutral, _Ceil;
+    para_type _Floor, _Neutral, _Ceil;
     Quantize_Value(_Floor, _Neutral, _Ceil, _BitDepth, _QuantRange, isChroma());
     return ReQuantize(_BitDepth, _Floor, _Neutral, _Ceil, scale, clip);
 }
 
-Plane &Plane::ReQuantize(value_type _BitDepth, value_type _Floor, value_type _Neutral, value_type _Ceil, bool scale, bool clip)
+template < typename _Ty >
+Plane_Int<_Ty> &Plane_Int<_Ty>::ReQuantize(para_type _BitDepth, para_type _Floor, para_type _Neutral, para_type _Ceil, bool scale, bool clip)
 {
-    value_type _ValueRange = _Ceil - _Floor;
+    para_type _ValueRange = _Ceil - _Floor;
 
-    const char *FunctionName = "Plane::ReQuantize";
+    const char *FunctionName = "Plane_Int::ReQuantize";
     if (_BitDepth > MaxBitDepth)
     {
         std::cerr << FunctionName << ": \"BitDepth=" << _BitDepth
@@ -296,7 +451,7 @@ Plane &Plane::ReQuantize(value_type _BitDepth, value_type _Floor, value_type _Ne
             << _Floor << "\" and \"Ceil=" << _Ceil << "\" are set.\n";
         DEBUG_BREAK;
     }
-    if (_ValueRange >= value_type(1) << _BitDepth)
+    if (_ValueRange >= para_type(1) << _BitDepth)
     {
         std::cerr << FunctionName << ": \"Ceil-Floor=" << _ValueRange
             << "\" exceeds \"BitDepth=" << _BitDepth << "\" limit.\n";
@@ -308,6 +463,12 @@ Plane &Plane::ReQuantize(value_type _BitDepth, value_type _Floor, value_type _Ne
             << "\", \"Neutral=" << _Neutral << "\" and \"Ceil=" << _Ceil << "\" are set.\n";
         DEBUG_BREAK;
     }
+    if (_Floor < value_type_MIN || _Ceil > value_type_MAX)
+    {
+        std::cerr << FunctionName << ": values of \"Floor=" << _Floor
+            << "\" and \"Ceil=" << _Ceil << "\" exceed the range of the storage type.\n";
+        DEBUG_BREAK;
+    }
 
     if (scale && data() && (Floor() != _Floor || Neutral() != _Neutral || Ceil() != _Ceil))
     {
@@ -342,7 +503,8 @@ Plane &Plane::ReQuantize(value_type _BitDepth, value_type _Floor, value_type _Ne
 }
 
 
-Plane &Plane::Binarize(const _Myt &src, value_type lower_thrD, value_type upper_thrD)
+template < typename _Ty >
+Plane_Int<_Ty> &Plane_Int<_Ty>::Binarize(const _Myt &src, para_type lower_thrD, para_type upper_thrD)
 {
     double lower_thr = static_cast<double>(lower_thrD - src.Floor()) / src.ValueRange();
     double upper_thr = static_cast<double>(upper_thrD - src.Floor()) / src.ValueRange();
@@ -350,18 +512,21 @@ Plane &Plane::Binarize(const _Myt &src, value_type lower_thrD, value_type upper_
     return Binarize_ratio(src, lower_thr, upper_thr);
 }
 
-Plane &Plane::Binarize_ratio(const _Myt &src, double lower_thr, double upper_thr)
+template < typename _Ty >
+Plane_Int<_Ty> &Plane_Int<_Ty>::Binarize_ratio(const _Myt &src, double lower_thr, double upper_thr)
 {
     auto &dst = *this;
 
-    value_type lower_thrD = static_cast<value_type>(lower_thr * src.ValueRange() + 0.5) + src.Floor();
-    value_type upper_thrD = static_cast<value_type>(upper_thr * src.ValueRange() + 0.5) + src.Floor();
+    para_type lower_thrD = static_cast<para_type>(lower_thr * src.ValueRange() + 0.5) + src.Floor();
+    para_type upper_thrD = static_cast<para_type>(upper_thr * src.ValueRange() + 0.5) + src.Floor();
+    const value_type FloorD = static_cast<value_type>(dst.Floor());
+    const value_type CeilD = static_cast<value_type>(dst.Ceil());
 
     if (upper_thr <= lower_thr || lower_thr >= 1 || upper_thr < 0)
     {
         dst.for_each([&](value_type &x)
         {
-            x = dst.Floor();
+            x = FloorD;
         });
     }
     else if (lower_thr < 0)
@@ -370,14 +535,14 @@ Plane &Plane::Binarize_ratio(const _Myt &src, double lower_thr, double upper_thr
         {
             dst.for_each([&](value_type &x)
             {
-                x = dst.Ceil();
+                x = CeilD;
             });
         }
         else
         {
             dst.transform([&](value_type x)
             {
-                return x <= upper_thrD ? dst.Ceil() : dst.Floor();
+                return x <= upper_thrD ? CeilD : FloorD;
             });
         }
     }
@@ -387,14 +552,14 @@ Plane &Plane::Binarize_ratio(const _Myt &src, double lower_thr, double upper_thr
         {
             dst.transform([&](value_type x)
             {
-                return x > lower_thrD ? dst.Ceil() : dst.Floor();
+                return x > lower_thrD ? CeilD : FloorD;
             });
         }
         else
         {
             dst.transform([&](value_type x)
             {
-                return x > lower_thrD && x <= upper_thrD ? dst.Ceil() : dst.Floor();
+                return x > lower_thrD && x <= upper_thrD ? CeilD : FloorD;
             });
         }
     }
@@ -403,7 +568,63 @@ Plane &Plane::Binarize_ratio(const _Myt &src, double lower_thr, double upper_thr
 }
 
 
+template class Plane_Int<DType>;
+template class Plane_Int<uint8>;
+template class Plane_Int<uint16>;
+
+
+// Functions of class PlaneView_Int
+template < typename _Ty >
+PlaneView_Int<_Ty>::PlaneView_Int(const _Mybase &src, PCType top, PCType left, PCType height, PCType width)
+    : _Mybase(0, 0, 0, src.BitDepth(), src.Floor(), src.Neutral(), src.Ceil(), src.GetTransferChar(), false)
+{
+    if (top < 0 || left < 0 || height <= 0 || width <= 0 || top + height > src.Height() || left + width > src.Width())
+    {
+        DEBUG_FAIL("class PlaneView_Int constructor: the rectangle exceeds the range of Plane \"src\".");
+    }
+
+    this->Borrow(const_cast<pointer>(src.data()) + top * src.Stride() + left, width, height, src.Stride());
+}
+
+template < typename _Ty >
+PlaneView_Int<_Ty>::PlaneView_Int(pointer _Data, PCType _Width, PCType _Height, PCType _Stride, para_type _BitDepth,
+    para_type _Floor, para_type _Neutral, para_type _Ceil, TransferChar _TransferChar)
+    : _Mybase(0, 0, 0, _BitDepth, _Floor, _Neutral, _Ceil, _TransferChar, false)
+{
+    this->Borrow(_Data, _Width, _Height, _Stride);
+}
+
+
+template class PlaneView_Int<DType>;
+template class PlaneView_Int<uint8>;
+template class PlaneView_Int<uint16>;
+
+
 // Functions of class Plane_FL
+void Plane_FL::Alloc(PCType _Apron, PCType _StrideHint)
+{
+    Apron_ = _Apron;
+    Plane_Alloc(Alloc_, Data_, Stride_, Width_, Height_, Apron_, _StrideHint);
+}
+
+void Plane_FL::Free()
+{
+    Plane_Free(Alloc_);
+    Data_ = nullptr;
+}
+
+void Plane_FL::Borrow(pointer _Data, PCType _Width, PCType _Height, PCType _Stride)
+{
+    Free();
+
+    Width_ = _Width;
+    Height_ = _Height;
+    PixelCount_ = _Width * _Height;
+    Stride_ = _Stride;
+    Apron_ = 0;
+    Data_ = _Data;
+}
+
 void Plane_FL::DefaultPara(bool Chroma, value_type range)
 {
     if (Chroma) // Plane "src" is chroma
@@ -449,7 +670,7 @@ Plane_FL::Plane_FL(value_type Value, PCType _Width, PCType _Height, bool RGB, bo
 {
     DefaultPara(!RGB&&Chroma);
 
-    AlignedMalloc(Data_, size());
+    Alloc(Plane_Apron());
 
     InitValue(Value, Init);
 }
@@ -458,43 +679,65 @@ Plane_FL::Plane_FL(value_type Value, PCType _Width, PCType _Height, value_type _
     : Width_(_Width), Height_(_Height), PixelCount_(_Width * _Height),
     Floor_(_Floor), Neutral_(_Neutral), Ceil_(_Ceil), TransferChar_(_TransferChar)
 {
-    AlignedMalloc(Data_, size());
+    Alloc(Plane_Apron());
 
     InitValue(Value, Init);
 }
 
 Plane_FL::Plane_FL(const _Myt &src)
-    : _Myt(src, false)
+    : Width_(src.Width()), Height_(src.Height()), PixelCount_(src.PixelCount()),
+    Floor_(src.Floor()), Neutral_(src.Neutral()), Ceil_(src.Ceil()), TransferChar_(src.GetTransferChar())
 {
-    memcpy(data(), src.data(), sizeof(value_type) * size());
+    Alloc(src.Apron(), Plane_StrideHint<value_type>(src));
+
+    CopyData(*this, src);
 }
 
 Plane_FL::Plane_FL(const _Myt &src, bool Init, value_type Value)
-    : _Myt(Value, src.Width(), src.Height(), src.Floor(), src.Neutral(), src.Ceil(), src.GetTransferChar(), Init)
-{}
+    : Width_(src.Width()), Height_(src.Height()), PixelCount_(src.PixelCount()),
+    Floor_(src.Floor()), Neutral_(src.Neutral()), Ceil_(src.Ceil()), TransferChar_(src.GetTransferChar())
+{
+    Alloc(src.Apron(), Plane_StrideHint<value_type>(src));
+
+    InitValue(Value, Init);
+}
 
 Plane_FL::Plane_FL(_Myt &&src)
     : Width_(src.Width()), Height_(src.Height()), PixelCount_(src.PixelCount()),
     Floor_(src.Floor()), Neutral_(src.Neutral()), Ceil_(src.Ceil()), TransferChar_(src.GetTransferChar())
 {
-    Data_ = src.data();
+    // Moving from a view copies the pixels, thus the new plane always owns its memory
+    if (src.isView())
+    {
+        Alloc(src.Apron(), Plane_StrideHint<value_type>(src));
+        CopyData(*this, src);
+        return;
+    }
+
+    Stride_ = src.Stride_;
+    Apron_ = src.Apron_;
+    Data_ = src.Data_;
+    Alloc_ = src.Alloc_;
 
     src.Width_ = 0;
     src.Height_ = 0;
     src.PixelCount_ = 0;
     src.Data_ = nullptr;
+    src.Alloc_ = nullptr;
 }
 
-Plane_FL::Plane_FL(const Plane &src, value_type range)
+template < typename _St1 >
+Plane_FL::Plane_FL(const Plane_Int<_St1> &src, value_type range)
     : _Myt(src, false, 0, range)
 {
     RangeConvert(*this, src);
 }
 
-Plane_FL::Plane_FL(const Plane &src, bool Init, value_type Value, value_type range)
+template < typename _St1 >
+Plane_FL::Plane_FL(const Plane_Int<_St1> &src, bool Init, value_type Value, value_type range)
     : Width_(src.Width()), Height_(src.Height()), PixelCount_(src.PixelCount()), TransferChar_(src.GetTransferChar())
 {
-    AlignedMalloc(Data_, size());
+    Alloc(src.Apron(), Plane_StrideHint<value_type>(src));
 
     if (range > 0)
     {
@@ -510,10 +753,17 @@ Plane_FL::Plane_FL(const Plane &src, bool Init, value_type Value, value_type ran
     InitValue(Value, Init);
 }
 
+template Plane_FL::Plane_FL(const Plane_Int<DType> &src, value_type range);
+template Plane_FL::Plane_FL(const Plane_Int<uint8> &src, value_type range);
+template Plane_FL::Plane_FL(const Plane_Int<uint16> &src, value_type range);
+template Plane_FL::Plane_FL(const Plane_Int<DType> &src, bool Init, value_type Value, value_type range);
+template Plane_FL::Plane_FL(const Plane_Int<uint8> &src, bool Init, value_type Value, value_type range);
+template Plane_FL::Plane_FL(const Plane_Int<uint16> &src, bool Init, value_type Value, value_type range);
+
 
 Plane_FL::~Plane_FL()
 {
-    AlignedFree(Data_);
+    Free();
 }
 
 
@@ -524,12 +774,26 @@ Plane_FL &Plane_FL::operator=(const _Myt &src)
         return *this;
     }
 
+    // Write the pixels through the view
+    if (isView())
+    {
+        if (Width() != src.Width() || Height() != src.Height())
+        {
+            DEBUG_FAIL("Plane_FL::operator=: the size of the view and \"src\" must be the same.");
+        }
+
+        CopyParaFrom(src);
+        CopyData(*this, src);
+
+        return *this;
+    }
+
     CopyParaFrom(src);
 
-    AlignedFree(Data_);
-    AlignedMalloc(Data_, size());
+    Free();
+    Alloc(src.Apron(), Plane_StrideHint<value_type>(src));
 
-    memcpy(data(), src.data(), sizeof(value_type) * size());
+    CopyData(*this, src);
 
     return *this;
 }
@@ -541,15 +805,24 @@ Plane_FL &Plane_FL::operator=(_Myt &&src)
         return *this;
     }
 
+    if (isView() || src.isView())
+    {
+        return *this = static_cast<const _Myt &>(src);
+    }
+
     CopyParaFrom(src);
 
-    AlignedFree(Data_);
-    Data_ = src.data();
+    Free();
+    Stride_ = src.Stride_;
+    Apron_ = src.Apron_;
+    Data_ = src.Data_;
+    Alloc_ = src.Alloc_;
 
     src.Width_ = 0;
     src.Height_ = 0;
     src.PixelCount_ = 0;
     src.Data_ = nullptr;
+    src.Alloc_ = nullptr;
 
     return *this;
 }
@@ -567,16 +840,15 @@ bool Plane_FL::operator==(const _Myt &b) const
         return false;
     }
 
-    PCType i;
-    for (i = 0; Data_[i] == b.Data_[i] && i < PixelCount(); i++);
-    if (i < PixelCount())
-    {
-        return false;
-    }
-    else
+    for (PCType j = 0; j < Height(); j++)
     {
-        return true;
+        if (memcmp(Data_ + j * Stride(), b.Data_ + j * b.Stride(), sizeof(value_type) * Width()) != 0)
+        {
+            return false;
+        }
     }
+
+    return true;
 }
 
 
@@ -626,38 +898,50 @@ Plane_FL &Plane_FL::ReSize(PCType _Width, PCType _Height)
 {
     if (Width() != _Width || Height() != _Height)
     {
-        auto newPC = _Width * _Height;
-
-        if (PixelCount() != newPC)
+        if (isView())
         {
-            auto originPC = PixelCount();
-            PixelCount_ = newPC;
-
-            if (newPC == 0)
-            {
-                AlignedFree(Data_);
-            }
-            else if (originPC == 0)
-            {
-                AlignedMalloc(Data_, newPC);
-            }
-            else
-            {
-                AlignedRealloc(Data_, newPC);
-            }
+            DEBUG_FAIL("Plane_FL::ReSize: a view can't be resized.");
         }
 
+        Free();
+
         Width_ = _Width;
         Height_ = _Height;
+        PixelCount_ = _Width * _Height;
+
+        Alloc(Apron_);
     }
 
     return *this;
 }
 
-Plane_FL &Plane_FL::ReQuantize(value_type _Floor, value_type _Neutral, value_type _Ceil, bool scale, bool clip)
+Plane_FL &Plane_FL::SetApron(PCType _Apron)
+{
+    if (Apron_ != _Apron)
+    {
+        if (isView())
+        {
+            DEBUG_FAIL("Plane_FL::SetApron: a view can't be re-allocated.");
+        }
+
+        _Myt temp(std::move(*this));
+
+        CopyParaFrom(temp);
+        Alloc(_Apron);
+
+        CopyData(*this, temp);
+    }
+
+    return *this;
+}
+
+void Plane_FL::ExtendBorder()
 {
-    PCType i;
+    ::ExtendBorder(*this);
+}
 
+Plane_FL &Plane_FL::ReQuantize(value_type _Floor, value_type _Neutral, value_type _Ceil, bool scale, bool clip)
+{
     const char *FunctionName = "Plane_FL::ReQuantize";
     if (_Ceil <= _Floor)
     {
@@ -679,17 +963,17 @@ Plane_FL &Plane_FL::ReQuantize(value_type _Floor, value_type _Neutral, value_typ
 
         if (clip)
         {
-            for (i = 0; i < PixelCount(); i++)
+            transform([&](value_type x)
             {
-                Data_[i] = Clip(Data_[i] * gain + offset, _Floor, _Ceil);
-            }
+                return Clip(x * gain + offset, _Floor, _Ceil);
+            });
         }
         else
         {
-            for (i = 0; i < PixelCount(); i++)
+            transform([&](value_type x)
             {
-                Data_[i] = Data_[i] * gain + offset;
-            }
+                return x * gain + offset;
+            });
         }
     }
 
@@ -703,74 +987,51 @@ Plane_FL &Plane_FL::ReQuantize(value_type _Floor, value_type _Neutral, value_typ
 
 Plane_FL &Plane_FL::Binarize(const _Myt &src, value_type lower_thrD, value_type upper_thrD)
 {
-    PCType i, j, upper;
-
-    PCType height = src.Height();
-    PCType width = src.Width();
-    PCType stride = src.Stride();
-
     double lower_thr = static_cast<double>(lower_thrD - src.Floor()) / src.ValueRange();
     double upper_thr = static_cast<double>(upper_thrD - src.Floor()) / src.ValueRange();
 
+    const value_type _Floor = Floor();
+    const value_type _Ceil = Ceil();
+
     if (upper_thr <= lower_thr || lower_thr >= 1 || upper_thr < 0)
     {
-        for (j = 0; j < height; j++)
+        for_each([&](value_type &x)
         {
-            i = stride * j;
-            for (upper = i + width; i < upper; i++)
-            {
-                Data_[i] = Floor();
-            }
-        }
+            x = _Floor;
+        });
     }
     else if (lower_thr < 0)
     {
         if (upper_thr >= 1)
         {
-            for (j = 0; j < height; j++)
+            for_each([&](value_type &x)
             {
-                i = stride * j;
-                for (upper = i + width; i < upper; i++)
-                {
-                    Data_[i] = Ceil();
-                }
-            }
+                x = _Ceil;
+            });
         }
         else
         {
-            for (j = 0; j < height; j++)
+            transform(src, [&](value_type x)
             {
-                i = stride * j;
-                for (upper = i + width; i < upper; i++)
-                {
-                    Data_[i] = src[i] <= upper_thrD ? Ceil() : Floor();
-                }
-            }
+                return x <= upper_thrD ? _Ceil : _Floor;
+            });
         }
     }
     else
     {
         if (upper_thr >= 1)
         {
-            for (j = 0; j < height; j++)
+            transform(src, [&](value_type x)
             {
-                i = stride * j;
-                for (upper = i + width; i < upper; i++)
-                {
-                    Data_[i] = src[i] > lower_thrD ? Ceil() : Floor();
-                }
-            }
+                return x > lower_thrD ? _Ceil : _Floor;
+            });
         }
         else
         {
-            for (j = 0; j < height; j++)
+            transform(src, [&](value_type x)
             {
-                i = stride * j;
-                for (upper = i + width; i < upper; i++)
-                {
-                    Data_[i] = src[i] > lower_thrD && src[i] <= upper_thrD ? Ceil() : Floor();
-                }
-            }
+                return x > lower_thrD && x <= upper_thrD ? _Ceil : _Floor;
+            });
         }
     }
 
@@ -786,6 +1047,26 @@ Plane_FL &Plane_FL::Binarize_ratio(const _Myt &src, double lower_thr, double upp
 }
 
 
+// Functions of class PlaneView_FL
+PlaneView_FL::PlaneView_FL(const _Mybase &src, PCType top, PCType left, PCType height, PCType width)
+    : _Mybase(0, 0, 0, src.Floor(), src.Neutral(), src.Ceil(), src.GetTransferChar(), false)
+{
+    if (top < 0 || left < 0 || height <= 0 || width <= 0 || top + height > src.Height() || left + width > src.Width())
+    {
+        DEBUG_FAIL("class PlaneView_FL constructor: the rectangle exceeds the range of Plane_FL \"src\".");
+    }
+
+    Borrow(const_cast<pointer>(src.data()) + top * src.Stride() + left, width, height, src.Stride());
+}
+
+PlaneView_FL::PlaneView_FL(pointer _Data, PCType _Width, PCType _Height, PCType _Stride,
+    value_type _Floor, value_type _Neutral, value_type _Ceil, TransferChar _TransferChar)
+    : _Mybase(0, 0, 0, _Floor, _Neutral, _Ceil, _TransferChar, false)
+{
+    Borrow(_Data, _Width, _Height, _Stride);
+}
+
+
 // Functions of class Frame
 void Frame::InitPlanes(PCType _Width, PCType _Height, value_type _BitDepth, bool Init)
 {
@@ -882,6 +1163,15 @@ void Frame::CopyPlanes(const _Myt &src, bool Copy, bool Init)
 {
     value_type _Floor, _Neutral, _Ceil;
 
+    // The new planes keep the memory layout of src planes
+    auto NewPlane = [Init](const _Mysub &srcP, value_type Value, value_type Floor, value_type Neutral, value_type Ceil, TransferChar _TransferChar)
+    {
+        _Mysub *dstP = new _Mysub(srcP, false);
+        dstP->ReQuantize(srcP.BitDepth(), Floor, Neutral, Ceil, false).SetTransferChar(_TransferChar);
+        dstP->InitValue(Value, Init);
+        return dstP;
+    };
+
     FreePlanes();
 
     if (isRGB())
@@ -896,7 +1186,7 @@ void Frame::CopyPlanes(const _Myt &src, bool Copy, bool Init)
             {
                 Quantize_Value(_Floor, _Neutral, _Ceil, src.R().BitDepth(), QuantRange_, false);
 
-                R_ = new _Mysub(_Floor, src.R().Width(), src.R().Height(), src.R().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar_, Init);
+                R_ = NewPlane(src.R(), _Floor, _Floor, _Neutral, _Ceil, TransferChar_);
             }
             P_[PlaneCount_++] = R_;
         }
@@ -911,7 +1201,7 @@ void Frame::CopyPlanes(const _Myt &src, bool Copy, bool Init)
             {
                 Quantize_Value(_Floor, _Neutral, _Ceil, src.G().BitDepth(), QuantRange_, false);
 
-                G_ = new _Mysub(_Floor, src.G().Width(), src.G().Height(), src.G().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar_, Init);
+                G_ = NewPlane(src.G(), _Floor, _Floor, _Neutral, _Ceil, TransferChar_);
             }
             P_[PlaneCount_++] = G_;
         }
@@ -926,7 +1216,7 @@ void Frame::CopyPlanes(const _Myt &src, bool Copy, bool Init)
             {
                 Quantize_Value(_Floor, _Neutral, _Ceil, src.B().BitDepth(), QuantRange_, false);
 
-                B_ = new _Mysub(_Floor, src.B().Width(), src.B().Height(), src.B().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar_, Init);
+                B_ = NewPlane(src.B(), _Floor, _Floor, _Neutral, _Ceil, TransferChar_);
             }
             P_[PlaneCount_++] = B_;
         }
@@ -943,7 +1233,7 @@ void Frame::CopyPlanes(const _Myt &src, bool Copy, bool Init)
             {
                 Quantize_Value(_Floor, _Neutral, _Ceil, src.Y().BitDepth(), QuantRange_, false);
 
-                Y_ = new _Mysub(_Floor, src.Y().Width(), src.Y().Height(), src.Y().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar_, Init);
+                Y_ = NewPlane(src.Y(), _Floor, _Floor, _Neutral, _Ceil, TransferChar_);
             }
             P_[PlaneCount_++] = Y_;
         }
@@ -960,7 +1250,7 @@ void Frame::CopyPlanes(const _Myt &src, bool Copy, bool Init)
                 {
                     Quantize_Value(_Floor, _Neutral, _Ceil, src.U().BitDepth(), QuantRange_, true);
 
-                    U_ = new _Mysub(_Neutral, src.U().Width(), src.U().Height(), src.U().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar::linear, Init);
+                    U_ = NewPlane(src.U(), _Neutral, _Floor, _Neutral, _Ceil, TransferChar::linear);
                 }
                 P_[PlaneCount_++] = U_;
             }
@@ -975,7 +1265,7 @@ void Frame::CopyPlanes(const _Myt &src, bool Copy, bool Init)
                 {
                     Quantize_Value(_Floor, _Neutral, _Ceil, src.V().BitDepth(), QuantRange_, true);
 
-                    V_ = new _Mysub(_Neutral, src.V().Width(), src.V().Height(), src.V().BitDepth(), _Floor, _Neutral, _Ceil, TransferChar::linear, Init);
+                    V_ = NewPlane(src.V(), _Neutral, _Floor, _Neutral, _Ceil, TransferChar::linear);
                 }
                 P_[PlaneCount_++] = V_;
             }
@@ -986,6 +1276,7 @@ void Frame::CopyPlanes(const _Myt &src, bool Copy, bool Init)
 void Frame::MovePlanes(_Myt &src)
 {
     PlaneCount_ = src.PlaneCount_;
+    src.PlaneCount_ = 0;
 
     P_ = std::move(src.P_);
     src.P_.insert(src.P_.end(), MaxPlaneCount, nullptr);
@@ -1007,6 +1298,69 @@ void Frame::MovePlanes(_Myt &src)
     src.A_ = nullptr;
 }
 
+void Frame::ViewPlanes(const _Myt &src, PCType top, PCType left, PCType height, PCType width)
+{
+    FrameNum_ = src.FrameNum();
+    PixelType_ = src.GetPixelType();
+    QuantRange_ = src.GetQuantRange();
+    ChromaPlacement_ = src.GetChromaPlacement();
+    ColorPrim_ = src.GetColorPrim();
+    TransferChar_ = src.GetTransferChar();
+    ColorMatrix_ = src.GetColorMatrix();
+
+    FreePlanes();
+    P_.assign(MaxPlaneCount, nullptr);
+
+    const PCType srcHeight = src.Height();
+    const PCType srcWidth = src.Width();
+
+    for (PlaneCountType n = 0; n < src.PlaneCount(); ++n)
+    {
+        const _Mysub &srcP = src.P(n);
+
+        // Scale the rectangle for the sub-sampled planes, it should be aligned to the sub-sampling ratio
+        const PCType ratioV = srcHeight / srcP.Height();
+        const PCType ratioH = srcWidth / srcP.Width();
+
+        if (top % ratioV || height % ratioV || left % ratioH || width % ratioH)
+        {
+            DEBUG_FAIL("Frame::ViewPlanes: the rectangle is not aligned to the chroma sub-sampling of Frame \"src\".");
+        }
+
+        const PCType _Top = top / ratioV;
+        const PCType _Left = left / ratioH;
+        const PCType _Height = height / ratioV;
+        const PCType _Width = width / ratioH;
+
+        if (_Top + _Height > srcP.Height() || _Left + _Width > srcP.Width())
+        {
+            DEBUG_FAIL("Frame::ViewPlanes: the rectangle exceeds the range of Frame \"src\".");
+        }
+
+        _Mysub *dstP = new _Mysub(0, 0, 0, srcP.BitDepth(), srcP.Floor(), srcP.Neutral(), srcP.Ceil(), srcP.GetTransferChar(), false);
+        dstP->Borrow(const_cast<pointer>(srcP.data()) + _Top * srcP.Stride() + _Left, _Width, _Height, srcP.Stride());
+        P_[PlaneCount_++] = dstP;
+    }
+
+    auto MapPlane = [&](_Mysub *srcP)
+    {
+        for (PlaneCountType n = 0; n < PlaneCount_; ++n)
+        {
+            if (srcP == src.P_[n]) return P_[n];
+        }
+
+        return static_cast<_Mysub *>(nullptr);
+    };
+
+    R_ = MapPlane(src.R_);
+    G_ = MapPlane(src.G_);
+    B_ = MapPlane(src.B_);
+    Y_ = MapPlane(src.Y_);
+    U_ = MapPlane(src.U_);
+    V_ = MapPlane(src.V_);
+    A_ = MapPlane(src.A_);
+}
+
 void Frame::FreePlanes()
 {
     PlaneCount_ = 0;
@@ -1064,6 +1418,14 @@ Frame::Frame(_Myt &&src)
     : FrameNum_(src.FrameNum()), PixelType_(src.GetPixelType()), QuantRange_(src.GetQuantRange()), ChromaPlacement_(src.GetChromaPlacement()),
     ColorPrim_(src.GetColorPrim()), TransferChar_(src.GetTransferChar()), ColorMatrix_(src.GetColorMatrix())
 {
+    // Moving from a view copies the pixels, thus the new frame always owns its memory
+    if (src.isView())
+    {
+        P_.assign(MaxPlaneCount, nullptr);
+        CopyPlanes(src, true);
+        return;
+    }
+
     MovePlanes(src);
 }
 
@@ -1081,6 +1443,11 @@ Frame &Frame::operator=(const _Myt &src)
         return *this;
     }
 
+    if (isView() && GetPixelType() != src.GetPixelType())
+    {
+        DEBUG_FAIL("Frame::operator=: the PixelType of the view and \"src\" must be the same.");
+    }
+
     FrameNum_ = src.FrameNum();
     PixelType_ = src.GetPixelType();
     QuantRange_ = src.GetQuantRange();
@@ -1089,6 +1456,17 @@ Frame &Frame::operator=(const _Myt &src)
     TransferChar_ = src.GetTransferChar();
     ColorMatrix_ = src.GetColorMatrix();
 
+    // Write the pixels through the planes of the view
+    if (isView())
+    {
+        for (PlaneCountType n = 0; n < PlaneCount_; ++n)
+        {
+            *P_[n] = *src.P_[n];
+        }
+
+        return *this;
+    }
+
     CopyPlanes(src, true);
 
     return *this;
@@ -1101,6 +1479,11 @@ Frame &Frame::operator=(_Myt &&src)
         return *this;
     }
 
+    if (isView() || src.isView())
+    {
+        return *this = static_cast<const _Myt &>(src);
+    }
+
     FrameNum_ = src.FrameNum();
     PixelType_ = src.GetPixelType();
     QuantRange_ = src.GetQuantRange();
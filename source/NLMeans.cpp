@@ -2,10 +2,27 @@
 #include "Conversion.hpp"
 
 
+void NLMeans::WeightLUT_Init()
+{
+    // Distances no less than thMSE are never weighted, and exp(-t) is negligible beyond t = 32
+    const double tMax = para.strength > 0 ? Clip(para.thMSE / (para.strength * para.strength), 0.0, 32.0) : 0.0;
+    const LUT<FLType>::LevelType Levels = static_cast<LUT<FLType>::LevelType>(ceil(tMax * WeightLUT_Scale)) + 2;
+
+    WeightLUT = LUT<FLType>(Levels);
+
+    for (LUT<FLType>::LevelType i = 0; i < Levels; ++i)
+    {
+        WeightLUT[i] = static_cast<FLType>(exp(-static_cast<double>(i) / WeightLUT_Scale));
+    }
+
+    WeightLUT_Mul = para.strength > 0 ? static_cast<FLType>(WeightLUT_Scale / (para.strength * para.strength)) : 0;
+}
+
+
 // Get the filtered block through weighted averaging of matched blocks in Plane src
 template < typename _St1 >
 void NLMeans::WeightedAverage(block_type &dstBlock, const block_type &refBlock, const _St1 &src,
-    const PosPairCode &code)
+    const PosPairCode &code, block_type &sumX1)
 {
     PCType GroupSize = static_cast<PCType>(code.size());
     // When para.GroupSize > 0, limit GroupSize up to para.GroupSize
@@ -24,30 +41,20 @@ void NLMeans::WeightedAverage(block_type &dstBlock, const block_type &refBlock,
         dstBlock.SetPos(refBlock.GetPos());
     }
 
-    block_type sumX1(refBlock, true, 0);
+    sumX1.InitValue(true, 0);
 
-    FLType exponentMul = static_cast<FLType>(-1 / (para.strength * para.strength));
+    const auto accumulate = Block_WeightedSum<typename _St1::value_type, FLType>::Select();
     FLType weightSum = 0;
     FLType weight;
 
     for (PCType k = 0; k < GroupSize; ++k)
     {
-        weight = exp(code[k].first * exponentMul);
+        weight = Weight(code[k].first);
         weightSum += weight;
 
         Pos pos = code[k].second;
-        auto sumX1p = sumX1.data();
-        auto srcp = src.data() + pos.y * src.Stride() + pos.x;
-
-        for (PCType y = 0; y < refBlock.Height(); ++y)
-        {
-            PCType x = y * src.Stride();
-
-            for (PCType upper = x + refBlock.Width(); x < upper; ++x, ++sumX1p)
-            {
-                *sumX1p += static_cast<FLType>(srcp[x]) * weight;
-            }
-        }
+        accumulate(sumX1.data(), nullptr, src.data() + pos.y * src.Stride() + pos.x, src.Stride(),
+            refBlock.Height(), refBlock.Width(), weight);
     }
 
     FLType weightSumRec = FLType(1) / weightSum;
@@ -66,7 +73,7 @@ void NLMeans::WeightedAverage(block_type &dstBlock, const block_type &refBlock,
 // A soft threshold optimal correction is applied by testing staionarity, to improve the NL-means algorithm
 template < typename _St1 >
 void NLMeans::WeightedAverage_Correction(block_type &dstBlock, const block_type &refBlock, const _St1 &src,
-    const PosPairCode &code)
+    const PosPairCode &code, block_type &sumX1, block_type &sumX2)
 {
     PCType GroupSize = static_cast<PCType>(code.size());
     // When para.GroupSize > 0, limit GroupSize up to para.GroupSize
@@ -85,35 +92,21 @@ void NLMeans::WeightedAverage_Correction(block_type &dstBlock, const block_type
         dstBlock.SetPos(refBlock.GetPos());
     }
 
-    block_type sumX1(refBlock, true, 0);
-    block_type sumX2(refBlock, true, 0);
+    sumX1.InitValue(true, 0);
+    sumX2.InitValue(true, 0);
 
-    FLType exponentMul = static_cast<FLType>(-1 / (para.strength * para.strength));
+    const auto accumulate = Block_WeightedSum<typename _St1::value_type, FLType>::Select();
     FLType weightSum = 0;
     FLType weight;
-    FLType temp;
 
     for (PCType k = 0; k < GroupSize; ++k)
     {
-        weight = exp(code[k].first * exponentMul);
+        weight = Weight(code[k].first);
         weightSum += weight;
 
         Pos pos = code[k].second;
-        auto sumX1p = sumX1.data();
-        auto sumX2p = sumX2.data();
-        auto srcp = src.data() + pos.y * src.Stride() + pos.x;
-
-        for (PCType y = 0; y < refBlock.Height(); ++y)
-        {
-            PCType x = y * src.Stride();
-
-            for (PCType upper = x + refBlock.Width(); x < upper; ++x, ++sumX1p, ++sumX2p)
-            {
-                temp = static_cast<FLType>(srcp[x]) * weight;
-                *sumX1p += temp;
-                *sumX2p += static_cast<FLType>(srcp[x]) * temp;
-            }
-        }
+        accumulate(sumX1.data(), sumX2.data(), src.data() + pos.y * src.Stride() + pos.x, src.Stride(),
+            refBlock.Height(), refBlock.Width(), weight);
     }
 
     FLType sigma = static_cast<FLType>(para.sigma * src.ValueRange() / 255); // sigma is converted from 8bit-scale to fit the src range
@@ -133,92 +126,561 @@ void NLMeans::WeightedAverage_Correction(block_type &dstBlock, const block_type
         EX = *sumX1p * weightSumRec;
         VarX = *sumX2p * weightSumRec - EX * EX;
 
-        // estimated_Y = EX + max(0, 1 - VarN / VarX) * (X - EX);
-        if (VarX > VarN)
+        *dstp = Correction(X, EX, VarX, VarN);
+    }
+}
+
+
+// Get the filtered block through weighted averaging of matched blocks in the frames of a sequence
+template < typename _St1 >
+void NLMeans::WeightedAverage(block_type &dstBlock, const block_type &refBlock, const std::vector<const _St1 *> &src,
+    const Pos3PairCode &code, block_type &sumX1, block_type &sumX2)
+{
+    const PCType GroupSize = static_cast<PCType>(code.size());
+    const _St1 &center = *src[code.empty() ? 0 : code[0].second.z];
+
+    if (GroupSize < 2)
+    {
+        dstBlock.From(center, refBlock.GetPos());
+        return;
+    }
+    else
+    {
+        dstBlock.SetPos(refBlock.GetPos());
+    }
+
+    sumX1.InitValue(true, 0);
+    if (para.correction) sumX2.InitValue(true, 0);
+
+    const auto accumulate = Block_WeightedSum<typename _St1::value_type, FLType>::Select();
+    FLType weightSum = 0;
+    FLType weight;
+
+    for (PCType k = 0; k < GroupSize; ++k)
+    {
+        weight = Weight(code[k].first);
+        weightSum += weight;
+
+        const Pos3Type pos = code[k].second;
+        const _St1 &frame = *src[pos.z];
+        accumulate(sumX1.data(), para.correction ? sumX2.data() : nullptr, frame.data() + pos.y * frame.Stride() + pos.x,
+            frame.Stride(), refBlock.Height(), refBlock.Width(), weight);
+    }
+
+    FLType weightSumRec = FLType(1) / weightSum;
+
+    auto dstp = dstBlock.data();
+    auto sumX1p = sumX1.data();
+
+    if (!para.correction)
+    {
+        for (auto upper = dstp + dstBlock.PixelCount(); dstp != upper; ++dstp, ++sumX1p)
+        {
+            *dstp = static_cast<FLType>(*sumX1p * weightSumRec);
+        }
+
+        return;
+    }
+
+    FLType sigma = static_cast<FLType>(para.sigma * center.ValueRange() / 255); // sigma is converted from 8bit-scale to fit the src range
+
+    FLType X, EX, VarX;
+    FLType VarN = static_cast<FLType>(sigma * sigma);
+
+    auto refp = refBlock.data();
+    auto sumX2p = sumX2.data();
+
+    for (auto upper = dstp + dstBlock.PixelCount(); dstp != upper; ++dstp, ++refp, ++sumX1p, ++sumX2p)
+    {
+        X = static_cast<FLType>(*refp);
+        EX = *sumX1p * weightSumRec;
+        VarX = *sumX2p * weightSumRec - EX * EX;
+
+        *dstp = Correction(X, EX, VarX, VarN);
+    }
+}
+
+
+void NLMeans::BlockMatching(std::vector<std::vector<PosPairCode>> &codes, const Plane_FL &ref,
+    const std::vector<PosCode> &refPos, int threads) const
+{
+    const PCType rowCount = static_cast<PCType>(refPos.size());
+
+    codes.resize(rowCount);
+
+    if (para.BMalgorithm != 1 && para.BMalgorithm != 2)
+    {
+        ThreadPool::Default().parallel_for(0, rowCount, [&](PCType row)
+        {
+            block_type refBlock(para.BlockSize, para.BlockSize, Pos(0, 0), false);
+            std::vector<PosPairCode> &rowCodes = codes[row];
+
+            rowCodes.resize(refPos[row].size());
+
+            for (size_t k = 0; k < refPos[row].size(); ++k)
+            {
+                // Get reference block from ref
+                refBlock.From(ref, refPos[row][k]);
+
+                rowCodes[k] = refBlock.BlockMatchingMulti(ref, para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true);
+            }
+        }, threads);
+
+        return;
+    }
+
+    // Predictive search: each chunk of PSfull rows takes predictions only from its own rows.
+    // Sliding-window SSD: the column sums are computed from scratch for the first row of each chunk,
+    // the chunk size is a trade-off between the parallelism and the cost of the initial column sums.
+    const PCType chunkRows = para.BMalgorithm == 2 ? (para.PSfull > 0 ? para.PSfull : Max(PCType(1), rowCount)) : 16;
+    const PCType chunks = (rowCount + chunkRows - 1) / chunkRows;
+
+    ThreadPool::Default().parallel_for(0, chunks, [&](PCType c)
+    {
+        const PCType lower = chunkRows * c;
+        const PCType upper = Min(rowCount, lower + chunkRows);
+
+        if (para.BMalgorithm == 1)
         {
-            *dstp = static_cast<FLType>(X - (VarN / VarX) * (X - EX));
+            BlockMatching_Sliding<FLType, FLType> matcher(para.BlockSize, para.BlockSize,
+                para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true);
+
+            for (PCType row = lower; row < upper; ++row)
+            {
+                matcher(codes[row], ref, refPos[row]);
+            }
         }
         else
         {
-            *dstp = static_cast<FLType>(EX);
+            BlockMatching_Predictive<FLType, FLType> predictor(para.BlockSize, para.BlockSize,
+                para.BMrange, para.BMstep, para.thMSE, para.PSrange, para.PSnum, para.PSfull, 1, para.GroupSize, true);
+            const std::vector<PosPairCode> noCodes;
+
+            for (PCType row = lower; row < upper; ++row)
+            {
+                predictor(codes[row], ref, refPos[row], refPos[row > lower ? row - 1 : row],
+                    row > lower ? codes[row - 1] : noCodes, row);
+            }
+        }
+    }, threads);
+}
+
+
+NLMeans::Pos3PairCode NLMeans::BlockMatching(const std::vector<const Plane_FL *> &ref, PCType center,
+    const PosPairCode &matchCode, PCType j, PCType i) const
+{
+    const Plane_FL &refCenter = *ref[center];
+
+    Pos3PairCode code;
+
+    for (const auto &match : matchCode)
+    {
+        code.push_back(Pos3Pair(match.first, Pos3Type(center, match.second.y, match.second.x)));
+    }
+
+    // The reference block itself stays the first
+    if (code.empty())
+    {
+        code.push_back(Pos3Pair(static_cast<KeyType>(0), Pos3Type(center, j, i)));
+    }
+
+    const PCType frames = static_cast<PCType>(ref.size());
+    const PCType bottom = refCenter.Height() - para.BlockSize;
+    const PCType right = refCenter.Width() - para.BlockSize;
+    const PCType range = para.PSrange * para.BMstep;
+    const size_t predNum = static_cast<size_t>(Max(PCType(1), para.PSnum));
+
+    block_type refBlock(refCenter, para.BlockSize, para.BlockSize, PosType(j, i));
+    PosCode predPos;
+    PosCode searchPos;
+    PosPairCode frameCode;
+
+    // Follow the trajectories of the best matches frame by frame, backward and forward from frame center
+    for (PCType dir = -1; dir <= 1; dir += 2)
+    {
+        predPos.clear();
+
+        for (size_t k = 0; k < code.size() && k < predNum; ++k)
+        {
+            predPos.push_back(PosType(code[k].second.y, code[k].second.x));
         }
+
+        for (PCType z = center + dir; z >= 0 && z < frames; z += dir)
+        {
+            searchPos.clear();
+
+            for (auto pos : predPos)
+            {
+                for (PCType y = Max(PCType(0), pos.y - range); y <= Min(bottom, pos.y + range); y += para.BMstep)
+                {
+                    for (PCType x = Max(PCType(0), pos.x - range); x <= Min(right, pos.x + range); x += para.BMstep)
+                    {
+                        searchPos.push_back(PosType(y, x));
+                    }
+                }
+            }
+
+            std::sort(searchPos.begin(), searchPos.end());
+            searchPos.erase(std::unique(searchPos.begin(), searchPos.end()), searchPos.end());
+
+            frameCode.clear();
+            refBlock.BlockMatchingTopK(frameCode, *ref[z], searchPos, para.thMSE, para.GroupSize, true);
+
+            // The trajectories are lost
+            if (frameCode.empty())
+            {
+                break;
+            }
+
+            predPos.clear();
+
+            for (size_t k = 0; k < frameCode.size(); ++k)
+            {
+                if (k < predNum) predPos.push_back(frameCode[k].second);
+                code.push_back(Pos3Pair(frameCode[k].first, Pos3Type(z, frameCode[k].second.y, frameCode[k].second.x)));
+            }
+        }
+    }
+
+    // The best matches of all the frames, the reference block stays the first
+    std::stable_sort(code.begin() + 1, code.end(), [](const Pos3Pair &left, const Pos3Pair &right)
+    {
+        return left.first < right.first;
+    });
+
+    if (para.GroupSize > 0 && static_cast<PCType>(code.size()) > para.GroupSize)
+    {
+        code.resize(para.GroupSize);
     }
+
+    return code;
 }
 
 
-// Non-local Means denoising algorithm based on block matching and weighted average of grouped blocks
-Plane_FL &NLMeans::process_Plane_FL(Plane_FL &dst, const Plane_FL &src, const Plane_FL &ref)
+template < typename _Fn1 >
+void NLMeans::Kernel(Plane_FL *const ResNum[], Plane_FL &ResDen, int planes,
+    const std::vector<PosCode> &refPos, _Fn1 &&filter, int threads)
 {
-    if (para.strength <= 0 || para.GroupSize == 1 || para.BlockSize <= 0
-        || para.BMrange <= 0 || para.BMrange < para.BMstep || para.thMSE <= 0)
+    const PCType rowCount = static_cast<PCType>(refPos.size());
+
+    if (rowCount == 0)
     {
-        dst = src;
-        return dst;
+        return;
     }
 
-    PCType height = src.Height();
-    PCType width = src.Width();
+    // Each band holds enough rows of reference blocks to keep all the threads busy,
+    // while the memory of the buffered filtered blocks is bounded by the band size
+    const PCType rowBlocks = static_cast<PCType>(refPos[0].size());
+    const PCType bandRows = Min(rowCount, Max(PCType(1), threads * 2));
+    const PCType tasks = bandRows * planes;
 
-    PCType BlockPosRight = width - para.BlockSize;
-    PCType BlockPosBottom = height - para.BlockSize;
+    const block_type blockInit(para.BlockSize, para.BlockSize, Pos(0, 0), false);
+    std::vector<std::vector<block_type>> bandFiltered(tasks, std::vector<block_type>(rowBlocks, blockInit));
 
-    block_type dstBlock(para.BlockSize, para.BlockSize, Pos(0, 0), false);
-    block_type srcBlock(para.BlockSize, para.BlockSize, Pos(0, 0), false);
-    block_type refBlock(para.BlockSize, para.BlockSize, Pos(0, 0), false);
+    for (PCType row = 0; row < rowCount; row += bandRows)
+    {
+        const PCType rowUpper = Min(rowCount, row + bandRows);
+        const PCType bandTasks = (rowUpper - row) * planes;
 
-    Plane_FL ResNum(dst, true, 0);
-    Plane_FL ResDen(dst, true, 0);
+        // Get the filtered blocks through weighted averaging of matched blocks in parallel,
+        // each task filters a row of reference blocks in a plane with its own scratch blocks
+        ThreadPool::Default().parallel_for(0, bandTasks, [&](PCType t)
+        {
+            const PCType r = row + t / planes;
+            const int plane = static_cast<int>(t % planes);
+            const PCType rowSize = static_cast<PCType>(refPos[r].size());
+            std::vector<block_type> &filtered = bandFiltered[t];
+
+            if (static_cast<PCType>(filtered.size()) < rowSize)
+            {
+                filtered.resize(rowSize, blockInit);
+            }
+
+            Scratch scratch = { blockInit, blockInit, blockInit };
+
+            for (PCType k = 0; k < rowSize; ++k)
+            {
+                filter(filtered[k], plane, r, k, scratch);
+            }
+        }, threads);
 
-    for (PCType j = 0;; j += para.BlockStep)
+        // The filtered blocks are sumed in the scan order of reference blocks, each plane by a separate task
+        ThreadPool::Default().parallel_for(0, planes, [&](PCType plane)
+        {
+            for (PCType r = row; r < rowUpper; ++r)
+            {
+                const std::vector<block_type> &filtered = bandFiltered[(r - row) * planes + plane];
+
+                for (size_t k = 0; k < refPos[r].size(); ++k)
+                {
+                    filtered[k].AddTo(*ResNum[plane]);
+                    if (plane == 0) filtered[k].CountTo(ResDen);
+                }
+            }
+        }, threads);
+    }
+}
+
+
+template < typename _St1 >
+void NLMeans::PixelWise(Plane_FL *const dst[], const _St1 *const src[], int planes, const Plane_FL &ref, int threads)
+{
+    const PCType height = ref.Height();
+    const PCType width = ref.Width();
+    const PCType stride = ref.Stride();
+    const PCType PatchSize = para.BlockSize;
+    const PCType offset = (PatchSize - 1) / 2; // the patch of (y, x) starts from (y - offset, x - offset)
+    const PCType step = para.BMstep;
+    const PCType range = para.BMrange / step * step;
+
+    // Displacements of the lower half of the search window, the upper half is given by symmetry,
+    // as the patch distance of (y, x) to (y + dy, x + dx) is the patch distance of (y + dy, x + dx) to (y, x)
+    PosCode disp;
+
+    for (PCType dy = 0; dy <= range; dy += step)
     {
-        // Handle scan of reference block - vertical
-        if (j >= BlockPosBottom + para.BlockStep)
+        for (PCType dx = -range; dx <= range; dx += step)
         {
-            break;
+            if (dy > 0 || dx > 0)
+            {
+                disp.push_back(PosType(dy, dx));
+            }
         }
-        else if (j > BlockPosBottom)
+    }
+
+    // Patch distances are converted to MSE in 8bit-scale, the same as the keys of block matching
+    const double distMul = double(255 * 255) / (static_cast<double>(ref.ValueRange()) * ref.ValueRange());
+    const double thMSE = para.thMSE;
+
+    std::vector<FLType> VarN(planes);
+
+    for (int plane = 0; plane < planes; ++plane)
+    {
+        // sigma is converted from 8bit-scale to fit the src range
+        FLType sigma = static_cast<FLType>(para.sigma * src[plane]->ValueRange() / 255);
+        VarN[plane] = sigma * sigma;
+    }
+
+    // Each band of rows is filtered separately with the patch distances of its own rows and the rows above it,
+    // the band size is independent of the number of threads, thus so is the result
+    const PCType bandRows = 64;
+    const PCType bands = (height + bandRows - 1) / bandRows;
+
+    ThreadPool::Default().parallel_for(0, bands, [&](PCType band)
+    {
+        const PCType y0 = band * bandRows;
+        const PCType y1 = Min(height, y0 + bandRows);
+        const PCType bandPixels = (y1 - y0) * width;
+
+        // Weighted sums of the pixels of each plane, the pixel itself is taken with weight 1
+        std::vector<FLType> sumW(bandPixels, 1);
+        std::vector<std::vector<FLType>> sumX1(planes);
+        std::vector<std::vector<FLType>> sumX2(para.correction ? planes : 0);
+
+        for (int plane = 0; plane < planes; ++plane)
         {
-            j = BlockPosBottom;
+            const _St1 &s = *src[plane];
+            sumX1[plane].resize(bandPixels);
+            if (para.correction) sumX2[plane].resize(bandPixels);
+
+            for (PCType y = y0; y < y1; ++y)
+            {
+                for (PCType x = 0; x < width; ++x)
+                {
+                    const FLType X = static_cast<FLType>(s(y, x));
+                    sumX1[plane][(y - y0) * width + x] = X;
+                    if (para.correction) sumX2[plane][(y - y0) * width + x] = X * X;
+                }
+            }
         }
 
-        for (PCType i = 0;; i += para.BlockStep)
+        std::vector<double> integral;
+        std::vector<FLType> weight;
+
+        // Accumulate the pixel (y + d.y, x + d.x) of each plane to the pixel (y, x) with weight w
+        auto accumulate = [&](PCType y, PCType x, const PosType &d, FLType w)
         {
-            // Handle scan of reference block - horizontal
-            if (i >= BlockPosRight + para.BlockStep)
+            const PCType n = (y - y0) * width + x;
+            sumW[n] += w;
+
+            for (int plane = 0; plane < planes; ++plane)
             {
-                break;
+                const FLType X = static_cast<FLType>((*src[plane])(y + d.y, x + d.x));
+                const FLType temp = X * w;
+                sumX1[plane][n] += temp;
+                if (para.correction) sumX2[plane][n] += X * temp;
             }
-            else if (i > BlockPosRight)
+        };
+
+        for (const auto &d : disp)
+        {
+            // Pixels p whose displaced pixel p + d is in the plane
+            const PCType px0 = Max(PCType(0), -d.x);
+            const PCType px1 = Min(width, width - d.x);
+            const PCType validRows = height - d.y;
+
+            // The weights of p in [py0, py1) are needed for the pixels of this band, as p itself or p + d
+            const PCType py0 = Max(PCType(0), y0 - d.y);
+            const PCType py1 = Min(y1, validRows);
+
+            if (px0 >= px1 || py0 >= py1)
             {
-                i = BlockPosRight;
+                continue;
             }
 
-            // Get source block from src
-            srcBlock.From(src, Pos(j, i));
+            // Integral image of the squared differences in the rows covered by the patches of [py0, py1)
+            const PCType iy0 = Max(PCType(0), py0 - offset);
+            const PCType iy1 = Min(validRows, py1 - offset + PatchSize - 1);
+            const PCType iw = px1 - px0 + 1;
 
-            // Get reference block from ref
-            refBlock.From(ref, Pos(j, i));
+            integral.assign((iy1 - iy0 + 1) * iw, 0);
 
-            // Form a group by block matching between reference block and its neighborhood in reference plane
-            PosPairCode matchCode = refBlock.BlockMatchingMulti(ref, para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true);
+            for (PCType y = iy0; y < iy1; ++y)
+            {
+                auto p0 = ref.data() + y * stride;
+                auto p1 = ref.data() + (y + d.y) * stride + d.x;
+                const double *upper = integral.data() + (y - iy0) * iw;
+                double *cur = integral.data() + (y - iy0 + 1) * iw;
+                double rowSum = 0;
+
+                for (PCType x = px0; x < px1; ++x)
+                {
+                    const double temp = static_cast<double>(p0[x]) - static_cast<double>(p1[x]);
+                    rowSum += temp * temp;
+                    cur[x - px0 + 1] = upper[x - px0 + 1] + rowSum;
+                }
+            }
 
-            // Get the filtered block through weighted averaging of matched blocks in Plane src
-            // A soft threshold optimal correction is applied by testing staionarity, to improve the NL-means algorithm
-            if (para.correction)
+            // Weights of the patch distances, the patches are clipped to the valid pixels on the borders
+            weight.resize((py1 - py0) * width);
+
+            for (PCType y = py0; y < py1; ++y)
             {
-                WeightedAverage_Correction(dstBlock, srcBlock, src, matchCode);
+                const PCType by0 = Max(iy0, y - offset) - iy0;
+                const PCType by1 = Min(iy1, y - offset + PatchSize) - iy0;
+                const double *top = integral.data() + by0 * iw;
+                const double *bottom = integral.data() + by1 * iw;
+                FLType *weightp = weight.data() + (y - py0) * width;
+
+                for (PCType x = px0; x < px1; ++x)
+                {
+                    const PCType bx0 = Max(px0, x - offset) - px0;
+                    const PCType bx1 = Min(px1, x - offset + PatchSize) - px0;
+                    const double sum = bottom[bx1] - bottom[bx0] - top[bx1] + top[bx0];
+                    const double MSE = sum * distMul / ((by1 - by0) * (bx1 - bx0));
+
+                    weightp[x] = MSE < thMSE ? Weight(static_cast<KeyType>(MSE)) : FLType(0);
+                }
             }
-            else
+
+            // p = (y, x) in this band takes p + d
+            for (PCType y = y0; y < py1; ++y)
             {
-                WeightedAverage(dstBlock, srcBlock, src, matchCode);
+                const FLType *weightp = weight.data() + (y - py0) * width;
+
+                for (PCType x = px0; x < px1; ++x)
+                {
+                    if (weightp[x] > 0) accumulate(y, x, d, weightp[x]);
+                }
             }
 
-            // The filtered blocks are sumed and averaged to form the final filtered image
-            dstBlock.AddTo(ResNum);
-            dstBlock.CountTo(ResDen);
+            // p + d = (y, x) in this band takes p
+            const PosType negd(-d.y, -d.x);
+
+            for (PCType y = Max(y0, d.y); y < y1; ++y)
+            {
+                const FLType *weightp = weight.data() + (y - d.y - py0) * width - d.x;
+
+                for (PCType x = px0 + d.x; x < px1 + d.x; ++x)
+                {
+                    if (weightp[x] > 0) accumulate(y, x, negd, weightp[x]);
+                }
+            }
+        }
+
+        // The weighted average, with the soft threshold optimal correction if enabled
+        for (int plane = 0; plane < planes; ++plane)
+        {
+            const _St1 &s = *src[plane];
+            Plane_FL &d = *dst[plane];
+
+            for (PCType y = y0; y < y1; ++y)
+            {
+                for (PCType x = 0; x < width; ++x)
+                {
+                    const PCType n = (y - y0) * width + x;
+                    const FLType weightSumRec = FLType(1) / sumW[n];
+                    const FLType EX = sumX1[plane][n] * weightSumRec;
+
+                    if (para.correction)
+                    {
+                        const FLType VarX = sumX2[plane][n] * weightSumRec - EX * EX;
+                        d(y, x) = Correction(static_cast<FLType>(s(y, x)), EX, VarX, VarN[plane]);
+                    }
+                    else
+                    {
+                        d(y, x) = EX;
+                    }
+                }
+            }
         }
+    }, threads);
+}
+
+
+// Non-local Means denoising algorithm based on block matching and weighted average of grouped blocks
+Plane_FL &NLMeans::process_Plane_FL(Plane_FL &dst, const Plane_FL &src, const Plane_FL &ref)
+{
+    if (para.strength <= 0 || para.GroupSize == 1 || para.BlockSize <= 0
+        || para.BMrange <= 0 || para.BMrange < para.BMstep || para.thMSE <= 0)
+    {
+        dst = src;
+        return dst;
+    }
+
+    PCType height = src.Height();
+    PCType width = src.Width();
+
+    const int threads = para.threads > 0 ? para.threads : ThreadPool::Default().Threads();
+
+    if (para.mode == 1)
+    {
+        Plane_FL *const dstP[1] = { &dst };
+        const Plane_FL *const srcP[1] = { &src };
+
+        PixelWise(dstP, srcP, 1, ref, threads);
+
+        return dst;
     }
 
+    const std::vector<PosCode> refPos = BlockScanPos(height, width, para.BlockSize, para.BlockStep);
+
+    // Form groups by block matching between reference blocks and their neighborhood in reference plane
+    std::vector<std::vector<PosPairCode>> codes;
+    BlockMatching(codes, ref, refPos, threads);
+
+    Plane_FL ResNum(dst, true, 0);
+    Plane_FL ResDen(dst, true, 0);
+
+    Plane_FL *const ResNumP[1] = { &ResNum };
+
+    Kernel(ResNumP, ResDen, 1, refPos, [&](block_type &dstBlock, int plane, PCType row, PCType k, Scratch &scratch)
+    {
+        // Get source block from src
+        scratch.srcBlock.From(src, refPos[row][k]);
+
+        // Get the filtered block through weighted averaging of matched blocks in Plane src
+        // A soft threshold optimal correction is applied by testing staionarity, to improve the NL-means algorithm
+        if (para.correction)
+        {
+            WeightedAverage_Correction(dstBlock, scratch.srcBlock, src, codes[row][k], scratch.sumX1, scratch.sumX2);
+        }
+        else
+        {
+            WeightedAverage(dstBlock, scratch.srcBlock, src, codes[row][k], scratch.sumX1);
+        }
+    }, threads);
+
     // The filtered blocks are sumed and averaged to form the final filtered image
     _Transform(dst, ResNum, ResDen, [](FLType num, FLType den)
     {
@@ -280,81 +742,256 @@ Frame &NLMeans::process_Frame(Frame &dst, const Frame &src, const Frame &ref)
     Plane_FL refY(ref.P(0), false);
     ConvertToY(refY, ref, ColorMatrix::OPP);
 
-    PCType BlockPosRight = width - para.BlockSize;
-    PCType BlockPosBottom = height - para.BlockSize;
+    const int threads = para.threads > 0 ? para.threads : ThreadPool::Default().Threads();
+
+    if (para.mode == 1)
+    {
+        Plane_FL Res0(dst0, false);
+        Plane_FL Res1(dst1, false);
+        Plane_FL Res2(dst2, false);
+
+        // The three planes share the weights computed on the Y plane of ref
+        Plane_FL *const dstP[3] = { &Res0, &Res1, &Res2 };
+        const Plane *const srcP[3] = { &src0, &src1, &src2 };
+
+        PixelWise(dstP, srcP, 3, refY, threads);
+
+        _Transform(dst0, Res0, [](Plane_FL::value_type x)
+        {
+            return static_cast<Plane::value_type>(x + Plane_FL::value_type(0.5));
+        });
+
+        _Transform(dst1, Res1, [](Plane_FL::value_type x)
+        {
+            return static_cast<Plane::value_type>(x + Plane_FL::value_type(0.5));
+        });
+
+        _Transform(dst2, Res2, [](Plane_FL::value_type x)
+        {
+            return static_cast<Plane::value_type>(x + Plane_FL::value_type(0.5));
+        });
+
+        return dst;
+    }
+
+    const std::vector<PosCode> refPos = BlockScanPos(height, width, para.BlockSize, para.BlockStep);
 
-    block_type dstBlock0(para.BlockSize, para.BlockSize, Pos(0, 0), false);
-    block_type dstBlock1(para.BlockSize, para.BlockSize, Pos(0, 0), false);
-    block_type dstBlock2(para.BlockSize, para.BlockSize, Pos(0, 0), false);
-    block_type srcBlock0(para.BlockSize, para.BlockSize, Pos(0, 0), false);
-    block_type srcBlock1(para.BlockSize, para.BlockSize, Pos(0, 0), false);
-    block_type srcBlock2(para.BlockSize, para.BlockSize, Pos(0, 0), false);
-    block_type refBlockY(para.BlockSize, para.BlockSize, Pos(0, 0), false);
+    // Form groups by block matching between reference blocks and their neighborhood in reference plane
+    std::vector<std::vector<PosPairCode>> codes;
+    BlockMatching(codes, refY, refPos, threads);
 
     Plane_FL ResNum0(dst0, true, 0);
     Plane_FL ResNum1(dst1, true, 0);
     Plane_FL ResNum2(dst2, true, 0);
     Plane_FL ResDen(dst0, true, 0);
 
-    for (PCType j = 0;; j += para.BlockStep)
+    // The three planes share the groups and are filtered concurrently
+    Plane_FL *const ResNumP[3] = { &ResNum0, &ResNum1, &ResNum2 };
+    const Plane *const srcP[3] = { &src0, &src1, &src2 };
+
+    Kernel(ResNumP, ResDen, 3, refPos, [&](block_type &dstBlock, int plane, PCType row, PCType k, Scratch &scratch)
     {
-        // Handle scan of reference block - vertical
-        if (j >= BlockPosBottom + para.BlockStep)
+        // Get source block from src
+        scratch.srcBlock.From(*srcP[plane], refPos[row][k]);
+
+        // Get the filtered block through weighted averaging of matched blocks in Plane src
+        // A soft threshold optimal correction is applied by testing staionarity, to improve the NL-means algorithm
+        if (para.correction)
         {
-            break;
+            WeightedAverage_Correction(dstBlock, scratch.srcBlock, *srcP[plane], codes[row][k], scratch.sumX1, scratch.sumX2);
         }
-        else if (j > BlockPosBottom)
+        else
         {
-            j = BlockPosBottom;
+            WeightedAverage(dstBlock, scratch.srcBlock, *srcP[plane], codes[row][k], scratch.sumX1);
         }
+    }, threads);
 
-        for (PCType i = 0;; i += para.BlockStep)
+    // The filtered blocks are sumed and averaged to form the final filtered image
+    _Transform(dst0, ResNum0, ResDen, [](Plane_FL::value_type num, Plane_FL::value_type den)
+    {
+        return static_cast<Plane::value_type>(num / den + Plane_FL::value_type(0.5));
+    });
+
+    _Transform(dst1, ResNum1, ResDen, [](Plane_FL::value_type num, Plane_FL::value_type den)
+    {
+        return static_cast<Plane::value_type>(num / den + Plane_FL::value_type(0.5));
+    });
+
+    _Transform(dst2, ResNum2, ResDen, [](Plane_FL::value_type num, Plane_FL::value_type den)
+    {
+        return static_cast<Plane::value_type>(num / den + Plane_FL::value_type(0.5));
+    });
+
+    return dst;
+}
+
+
+void NLMeans::Push(const Frame &src)
+{
+    if (finished)
+    {
+        DEBUG_FAIL("NLMeans::Push: the sequence is finished, Reset() should be called before pushing a new sequence.");
+    }
+    if (src.PlaneCount() < 3)
+    {
+        DEBUG_FAIL("NLMeans::Push: only frames of 3 planes are supported.");
+    }
+    if (pushed > 0)
+    {
+        const Frame &last = GetSlot(pushed - 1).src;
+
+        if (src.Width() != last.Width() || src.Height() != last.Height())
         {
-            // Handle scan of reference block - horizontal
-            if (i >= BlockPosRight + para.BlockStep)
-            {
-                break;
-            }
-            else if (i > BlockPosRight)
-            {
-                i = BlockPosRight;
-            }
+            DEBUG_FAIL("NLMeans::Push: all the frames of the sequence must have the same size.");
+        }
+    }
 
-            // Get reference block from ref
-            refBlockY.From(refY, Pos(j, i));
+    // The slot of frame pushed - ring.size() is no longer referenced by any window
+    Slot &slot = GetSlot(pushed);
 
-            // Get source block from src
-            srcBlock0.From(src0, Pos(j, i));
-            srcBlock1.From(src1, Pos(j, i));
-            srcBlock2.From(src2, Pos(j, i));
+    // Moved from a copy, since the copy assignment requires an allocated Frame
+    slot.src = Frame(src);
+    slot.ref = Plane_FL(src.P(0), false);
+    ConvertToY(slot.ref, src, ColorMatrix::OPP);
 
-            // Form a group by block matching between reference block and its neighborhood in reference plane
-            PosPairCode matchCode = refBlockY.BlockMatchingMulti(refY, para.BMrange, para.BMstep, para.thMSE, 1, para.GroupSize, true);
+    ++pushed;
+    Advance();
+}
 
-            // Get the filtered block through weighted averaging of matched blocks in Plane src
-            // A soft threshold optimal correction is applied by testing staionarity, to improve the NL-means algorithm
-            if (para.correction)
-            {
-                WeightedAverage_Correction(dstBlock0, srcBlock0, src0, matchCode);
-                WeightedAverage_Correction(dstBlock1, srcBlock1, src1, matchCode);
-                WeightedAverage_Correction(dstBlock2, srcBlock2, src2, matchCode);
-            }
-            else
-            {
-                WeightedAverage(dstBlock0, srcBlock0, src0, matchCode);
-                WeightedAverage(dstBlock1, srcBlock1, src1, matchCode);
-                WeightedAverage(dstBlock2, srcBlock2, src2, matchCode);
-            }
 
-            // The filtered blocks are sumed and averaged to form the final filtered image
-            dstBlock0.AddTo(ResNum0);
-            dstBlock1.AddTo(ResNum1);
-            dstBlock2.AddTo(ResNum2);
+void NLMeans::Finish()
+{
+    finished = true;
+    Advance();
+}
+
+
+bool NLMeans::Pop(Frame &dst)
+{
+    if (output.empty())
+    {
+        return false;
+    }
+
+    dst = std::move(output.front());
+    output.pop_front();
+
+    return true;
+}
+
+
+void NLMeans::Reset()
+{
+    pushed = 0;
+    done = 0;
+    finished = false;
+    output.clear();
+}
+
+
+std::vector<Frame> NLMeans::operator()(const std::vector<Frame> &src)
+{
+    std::vector<Frame> dst;
+    Frame frame;
+
+    Reset();
+
+    for (const auto &s : src)
+    {
+        Push(s);
+        while (Pop(frame)) dst.push_back(std::move(frame));
+    }
+
+    Finish();
+    while (Pop(frame)) dst.push_back(std::move(frame));
 
-            dstBlock0.CountTo(ResDen);
+    Reset();
+
+    return dst;
+}
+
+
+void NLMeans::Advance()
+{
+    // Frame n needs the frames up to n + radius
+    while (done < pushed && (done + para.radius < pushed || finished))
+    {
+        ProcessFrame(done++);
+    }
+}
+
+
+void NLMeans::ProcessFrame(PCType n)
+{
+    const PCType lower = Max(PCType(0), n - para.radius);
+    const PCType upper = Min(pushed - 1, n + para.radius);
+    const PCType center = n - lower;
+
+    const Frame &src = GetSlot(n).src;
+    Frame dst(src, false);
+
+    if (lower == upper || para.mode == 1 || para.strength <= 0 || para.GroupSize == 1 || para.BlockSize <= 0
+        || para.BMrange <= 0 || para.BMrange < para.BMstep || para.thMSE <= 0)
+    {
+        process_Frame(dst, src, src);
+        output.push_back(std::move(dst));
+        return;
+    }
+
+    std::vector<const Plane_FL *> ref;
+    std::vector<const Plane *> srcSeq[3];
+
+    for (PCType z = lower; z <= upper; ++z)
+    {
+        Slot &slot = GetSlot(z);
+        ref.push_back(&slot.ref);
+
+        for (int plane = 0; plane < 3; ++plane)
+        {
+            srcSeq[plane].push_back(&slot.src.P(plane));
         }
     }
 
+    const int threads = para.threads > 0 ? para.threads : ThreadPool::Default().Threads();
+    const std::vector<PosCode> refPos = BlockScanPos(src.Height(), src.Width(), para.BlockSize, para.BlockStep);
+    const PCType rowCount = static_cast<PCType>(refPos.size());
+
+    // Form groups by block matching in the current frame, then follow the matches to the other frames
+    std::vector<std::vector<PosPairCode>> codes;
+    BlockMatching(codes, *ref[center], refPos, threads);
+
+    std::vector<std::vector<Pos3PairCode>> codes3(rowCount);
+
+    ThreadPool::Default().parallel_for(0, rowCount, [&](PCType row)
+    {
+        codes3[row].resize(refPos[row].size());
+
+        for (size_t k = 0; k < refPos[row].size(); ++k)
+        {
+            codes3[row][k] = BlockMatching(ref, center, codes[row][k], refPos[row][k].y, refPos[row][k].x);
+        }
+    }, threads);
+
+    Plane &dst0 = dst.P(0);
+    Plane &dst1 = dst.P(1);
+    Plane &dst2 = dst.P(2);
+
+    Plane_FL ResNum0(dst0, true, 0);
+    Plane_FL ResNum1(dst1, true, 0);
+    Plane_FL ResNum2(dst2, true, 0);
+    Plane_FL ResDen(dst0, true, 0);
+
+    Plane_FL *const ResNumP[3] = { &ResNum0, &ResNum1, &ResNum2 };
+
+    Kernel(ResNumP, ResDen, 3, refPos, [&](block_type &dstBlock, int plane, PCType row, PCType k, Scratch &scratch)
+    {
+        // Get source block from the current frame
+        scratch.srcBlock.From(*srcSeq[plane][center], refPos[row][k]);
+
+        // Get the filtered block through weighted averaging of matched blocks in the frames
+        WeightedAverage(dstBlock, scratch.srcBlock, srcSeq[plane], codes3[row][k], scratch.sumX1, scratch.sumX2);
+    }, threads);
+
     // The filtered blocks are sumed and averaged to form the final filtered image
     _Transform(dst0, ResNum0, ResDen, [](Plane_FL::value_type num, Plane_FL::value_type den)
     {
@@ -371,5 +1008,5 @@ Frame &NLMeans::process_Frame(Frame &dst, const Frame &src, const Frame &ref)
         return static_cast<Plane::value_type>(num / den + Plane_FL::value_type(0.5));
     });
 
-    return dst;
+    output.push_back(std::move(dst));
 }
@@ -0,0 +1,141 @@
+#include <chrono>
+#include <iomanip>
+#include "Pipeline.h"
+#include "Helper.h"
+
+
+void Pipeline_IO::arguments_process()
+{
+    std::vector<std::string> pipeArgs;
+    std::vector<std::vector<std::string>> stageArgs;
+
+    names.clear();
+    stages.clear();
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (args[i][0] != '-')
+        {
+            // Input path
+            pipeArgs.push_back(args[i]);
+            continue;
+        }
+
+        FilterIO *stage = factory(args[i]);
+
+        if (stage != nullptr)
+        {
+            names.push_back(args[i]);
+            stages.emplace_back(stage);
+            stageArgs.push_back(std::vector<std::string>());
+            continue;
+        }
+
+        // Every option takes exactly one value
+        std::vector<std::string> &dst = stages.size() > 0 ? stageArgs.back() : pipeArgs;
+
+        dst.push_back(args[i]);
+        if (i + 1 < argc) dst.push_back(args[++i]);
+    }
+
+    if (stages.size() == 0)
+    {
+        DEBUG_FAIL("Pipeline_IO::arguments_process: No filter specified!");
+    }
+
+    for (size_t n = 0; n < stages.size(); ++n)
+    {
+        stages[n]->SetArgs(static_cast<int>(stageArgs[n].size()), stageArgs[n]);
+    }
+
+    argc = static_cast<int>(pipeArgs.size());
+    args = pipeArgs;
+
+    _Mybase::arguments_process();
+
+    if (GetTag().size() == 0)
+    {
+        std::string tag;
+
+        for (auto &stage : stages)
+        {
+            tag += stage->GetTag();
+        }
+
+        SetTag(tag);
+    }
+}
+
+
+void Pipeline_IO::prepare()
+{
+    for (size_t n = 0; n < stages.size(); ++n)
+    {
+        stages[n]->Init();
+
+        // The stages are chained frame by frame, thus a delayed output can't be passed to the next stage
+        if (stages[n]->Delay() > 0)
+        {
+            DEBUG_FAIL("Pipeline_IO::prepare: filters with frame delay (e.g. --vbm3d) are not supported in a pipeline.");
+        }
+    }
+
+    elapsed.assign(stages.size(), 0);
+    frames = 0;
+}
+
+
+void Pipeline_IO::finish()
+{
+    if (frames == 0)
+    {
+        return;
+    }
+
+    double total = 0;
+
+    for (auto e : elapsed)
+    {
+        total += e;
+    }
+
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::cout.unsetf(std::ios_base::showpos);
+    std::cout << std::fixed << std::setprecision(1);
+
+    std::cout << "Pipeline_IO: " << frames << " frame(s) processed\n";
+
+    for (size_t n = 0; n < stages.size(); ++n)
+    {
+        std::cout << "    " << std::left << std::setw(24) << names[n] << std::right
+            << std::setw(10) << elapsed[n] * 1000 << " ms"
+            << std::setw(10) << elapsed[n] * 1000 / frames << " ms/frame"
+            << std::setw(8) << (total > 0 ? elapsed[n] / total * 100 : 0) << " %\n";
+    }
+
+    std::cout << "    " << std::left << std::setw(24) << "total" << std::right
+        << std::setw(10) << total * 1000 << " ms"
+        << std::setw(10) << total * 1000 / frames << " ms/frame\n";
+
+    std::cout.flags(flags);
+}
+
+
+Frame Pipeline_IO::process(const Frame &src)
+{
+    Frame dst;
+
+    for (size_t n = 0; n < stages.size(); ++n)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        dst = stages[n]->Filter(n == 0 ? src : dst);
+
+        std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+        elapsed[n] += duration.count();
+    }
+
+    ++frames;
+
+    return dst;
+}
@@ -3,6 +3,31 @@
 #include "Gaussian.h"
 
 
+// Multiply one scale of the multi-scale Retinex into dst in one pass
+// The first scale initializes dst, and the last one is fused with the logarithm of the geometric mean.
+template < typename _Ex >
+static void MultiplyScale(Plane_FL &dst, const PlaneExpr<_Ex> &factor, size_t s, size_t scount)
+{
+    const FLType scountRec = 1 / static_cast<FLType>(scount);
+
+    auto logMean = [=](FLType x)
+    {
+        return log(x) * scountRec;
+    };
+
+    if (s + 1 < scount)
+    {
+        if (s == 0) dst = factor;
+        else dst = dst * factor;
+    }
+    else
+    {
+        if (s == 0) dst = Expr_Map(logMean, factor);
+        else dst = Expr_Map(logMean, dst * factor);
+    }
+}
+
+
 // Functions of class Retinex
 Plane_FL &Retinex::Kernel(Plane_FL &dst, const Plane_FL &src)
 {
@@ -19,11 +44,6 @@ Plane_FL &Retinex::Kernel(Plane_FL &dst, const Plane_FL &src)
         return dst;
     }
 
-    PCType i, j, upper;
-    PCType height = src.Height();
-    PCType width = src.Width();
-    PCType stride = src.Stride();
-
     Plane_FL gauss(src, false);
 
     if (scount == 1 && para.sigmaVector[0] > 0) // single-scale Gaussian filter
@@ -31,14 +51,10 @@ Plane_FL &Retinex::Kernel(Plane_FL &dst, const Plane_FL &src)
         RecursiveGaussian GFilter(para.sigmaVector[0], true);
         Plane_FL gauss = GFilter(src);
 
-        for (j = 0; j < height; ++j)
+        TRANSFORM(dst, src, gauss, [](FLType x, FLType g)
         {
-            i = j * stride;
-            for (upper = i + width; i < upper; ++i)
-            {
-                dst[i] = gauss[i] <= 0 ? 0 : log(src[i] / gauss[i] + 1);
-            }
-        }
+            return g <= 0 ? 0 : log(x / g + 1);
+        });
     }
     else // multi-scale Gaussian filter
     {
@@ -47,8 +63,6 @@ Plane_FL &Retinex::Kernel(Plane_FL &dst, const Plane_FL &src)
             DEBUG_FAIL("Retinex::Kernel: Data of Plane_FL \"dst\" and Plane_FL \"src\" can not be of the same address for multi-scale.");
         }
 
-        dst.InitValue(1);
-
         for (s = 0; s < scount; ++s)
         {
             if (para.sigmaVector[s] > 0)
@@ -56,39 +70,14 @@ Plane_FL &Retinex::Kernel(Plane_FL &dst, const Plane_FL &src)
                 RecursiveGaussian GFilter(para.sigmaVector[s], true);
                 GFilter.Filter(gauss, src);
 
-                for (j = 0; j < height; ++j)
+                MultiplyScale(dst, Expr_Map([](FLType x, FLType g)
                 {
-                    i = j * stride;
-                    for (upper = i + width; i < upper; ++i)
-                    {
-                        if (gauss[i] > 0)
-                        {
-                            dst[i] *= src[i] / gauss[i] + 1;
-                        }
-                    }
-                }
+                    return g > 0 ? x / g + 1 : FLType(1);
+                }, src, gauss), s, scount);
             }
             else
             {
-                for (j = 0; j < height; ++j)
-                {
-                    i = j * stride;
-                    for (upper = i + width; i < upper; ++i)
-                    {
-                        dst[i] *= FLType(2);
-                    }
-                }
-            }
-        }
-
-        FLType scountRec = 1 / static_cast<FLType>(scount);
-
-        for (j = 0; j < height; ++j)
-        {
-            i = j * stride;
-            for (upper = i + width; i < upper; ++i)
-            {
-                dst[i] = log(dst[i]) * scountRec;
+                MultiplyScale(dst, PlaneExpr_Scalar<FLType>(2), s, scount);
             }
         }
     }
@@ -174,10 +163,11 @@ Plane &Retinex_MSRCR_GIMP::process_Plane(Plane &dst, const Plane &src)
 // Functions of class Retinex_MSRCP
 Frame &Retinex_MSRCP::process_Frame(Frame &dst, const Frame &src)
 {
-    PCType i, j, upper;
+    PCType i, d, f, j, upper;
     PCType height = src.Height();
     PCType width = src.Width();
     PCType stride = src.Stride();
+    PCType dst_stride = dst.Stride();
 
     FLType gain, offset;
 
@@ -204,21 +194,25 @@ Frame &Retinex_MSRCP::process_Frame(Frame &dst, const Frame &src)
         FLType offsetY = dstY.Floor() + FLType(0.5);
         offset = dstU.Neutral() + FLType(dstU.isPCChroma() ? 0.499999 : 0.5);
 
+        const PCType fl_stride = idata.Stride();
+
         for (j = 0; j < height; ++j)
         {
             i = j * stride;
-            for (upper = i + width; i < upper; ++i)
+            d = j * dst_stride;
+            f = j * fl_stride;
+            for (upper = i + width; i < upper; ++i, ++d, ++f)
             {
                 Uval = srcU[i] - sNeutral;
                 Vval = srcV[i] - sNeutral;
                 if (para.chroma_protect > 1)
-                    gain = idata[i] <= 0 ? 1 : log(odata[i] / idata[i] * chroma_protect_mul1 + 1) * chroma_protect_mul2;
+                    gain = idata[f] <= 0 ? 1 : log(odata[f] / idata[f] * chroma_protect_mul1 + 1) * chroma_protect_mul2;
                 else
-                    gain = idata[i] <= 0 ? 1 : odata[i] / idata[i];
+                    gain = idata[f] <= 0 ? 1 : odata[f] / idata[f];
                 gain = Min(sRangeC2FL / Max(Abs(Uval), Abs(Vval)), gain);
-                dstY[i] = static_cast<DType>(odata[i] * dRangeFL + offsetY);
-                dstU[i] = static_cast<DType>(Uval * gain + offset);
-                dstV[i] = static_cast<DType>(Vval * gain + offset);
+                dstY[d] = static_cast<DType>(odata[f] * dRangeFL + offsetY);
+                dstU[d] = static_cast<DType>(Uval * gain + offset);
+                dstV[d] = static_cast<DType>(Vval * gain + offset);
             }
         }
     }
@@ -242,19 +236,23 @@ Frame &Retinex_MSRCP::process_Frame(Frame &dst, const Frame &src)
         DType Rval, Gval, Bval;
         offset = dstR.Floor() + FLType(0.5);
 
+        const PCType fl_stride = idata.Stride();
+
         for (j = 0; j < height; ++j)
         {
             i = j * stride;
-            for (upper = i + width; i < upper; ++i)
+            d = j * dst_stride;
+            f = j * fl_stride;
+            for (upper = i + width; i < upper; ++i, ++d, ++f)
             {
                 Rval = srcR[i] - sFloor;
                 Gval = srcG[i] - sFloor;
                 Bval = srcB[i] - sFloor;
-                gain = idata[i] <= 0 ? 1 : odata[i] / idata[i];
+                gain = idata[f] <= 0 ? 1 : odata[f] / idata[f];
                 gain = Min(sRangeFL / Max(Rval, Max(Gval, Bval)), gain);
-                dstR[i] = static_cast<DType>(Rval * gain + offset);
-                dstG[i] = static_cast<DType>(Gval * gain + offset);
-                dstB[i] = static_cast<DType>(Bval * gain + offset);
+                dstR[d] = static_cast<DType>(Rval * gain + offset);
+                dstG[d] = static_cast<DType>(Gval * gain + offset);
+                dstB[d] = static_cast<DType>(Bval * gain + offset);
             }
         }
     }
@@ -266,7 +264,7 @@ Frame &Retinex_MSRCP::process_Frame(Frame &dst, const Frame &src)
 // Functions of class Retinex_MSRCR
 Frame &Retinex_MSRCR::process_Frame(Frame &dst, const Frame &src)
 {
-    PCType i, j, upper;
+    PCType i, f, j, upper;
     PCType height = src.Height();
     PCType width = src.Width();
     PCType stride = src.Stride();
@@ -296,19 +294,22 @@ Frame &Retinex_MSRCR::process_Frame(Frame &dst, const Frame &src)
         DType Rval, Gval, Bval;
         FLType temp;
 
+        const PCType fl_stride = odataR.Stride();
+
         for (j = 0; j < height; ++j)
         {
             i = j * stride;
-            for (upper = i + width; i < upper; ++i)
+            f = j * fl_stride;
+            for (upper = i + width; i < upper; ++i, ++f)
             {
                 Rval = srcR[i] - sFloor;
                 Gval = srcG[i] - sFloor;
                 Bval = srcB[i] - sFloor;
                 temp = static_cast<FLType>(Rval + Gval + Bval);
                 temp = temp <= 0 ? 0 : para.restore / temp;
-                odataR[i] *= log(Rval * temp + 1);
-                odataG[i] *= log(Gval * temp + 1);
-                odataB[i] *= log(Bval * temp + 1);
+                odataR[f] *= log(Rval * temp + 1);
+                odataG[f] *= log(Gval * temp + 1);
+                odataB[f] *= log(Bval * temp + 1);
             }
         }
 
@@ -0,0 +1,128 @@
+#include "Thread_Pool.h"
+
+
+static std::atomic<int> PPL_Threads_(0);
+
+
+// Functions of class ThreadPool
+ThreadPool::ThreadPool(int _Threads)
+{
+    if (_Threads <= 0)
+    {
+        _Threads = HardwareThreads();
+    }
+
+    for (int t = 1; t < _Threads; ++t)
+    {
+        workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+
+    task_cond_.notify_all();
+
+    for (auto &w : workers_)
+    {
+        w.join();
+    }
+}
+
+
+void ThreadPool::Submit(task_type task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+
+    task_cond_.notify_one();
+}
+
+
+void ThreadPool::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true)
+    {
+        task_cond_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+
+        if (tasks_.empty())
+        {
+            return;
+        }
+
+        task_type task = std::move(tasks_.front());
+        tasks_.pop_front();
+
+        lock.unlock();
+        task();
+        task = nullptr;
+        lock.lock();
+
+        done_cond_.notify_all();
+    }
+}
+
+
+void ThreadPool::Wait(const std::atomic<int> &pending)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (pending > 0)
+    {
+        // Help with the queued tasks instead of idle waiting, which also avoids dead lock in nested parallel_for
+        if (!tasks_.empty())
+        {
+            task_type task = std::move(tasks_.front());
+            tasks_.pop_front();
+
+            lock.unlock();
+            task();
+            task = nullptr;
+            lock.lock();
+        }
+        else
+        {
+            done_cond_.wait(lock);
+        }
+    }
+}
+
+
+int ThreadPool::HardwareThreads()
+{
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    return threads > 0 ? threads : 1;
+}
+
+
+ThreadPool &ThreadPool::Default()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+
+// Functions for *_PPL loop helpers
+int PPL_Threads()
+{
+    return PPL_Threads_;
+}
+
+void PPL_SetThreads(int threads)
+{
+    PPL_Threads_ = threads > 0 ? threads : 0;
+}
+
+int PPL_Concurrency()
+{
+    const int threads = PPL_Threads_;
+    return threads > 0 ? threads : ThreadPool::HardwareThreads();
+}
@@ -0,0 +1,259 @@
+#include <chrono>
+#include <iomanip>
+#include "VBM3D.h"
+#include "Conversion.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions of class VBM3D
+
+
+void VBM3D::Push(const Frame &src)
+{
+    if (finished)
+    {
+        DEBUG_FAIL("VBM3D::Push: the sequence is finished, Reset() should be called before pushing a new sequence.");
+    }
+    if (!src.isRGB())
+    {
+        DEBUG_FAIL("VBM3D::Push: only RGB input is supported.");
+    }
+    if (pushed > 0)
+    {
+        const Plane_FL &last = GetSlot(pushed - 1).src[0];
+
+        if (src.Width() != last.Width() || src.Height() != last.Height())
+        {
+            DEBUG_FAIL("VBM3D::Push: all the frames of the sequence must have the same size.");
+        }
+    }
+
+    // The slot of frame pushed - ring.size() is no longer referenced by any window
+    Slot &slot = GetSlot(pushed);
+
+    MatrixConvert_RGB2YUV(slot.src[0], slot.src[1], slot.src[2], src.R(), src.G(), src.B(), ColorMatrix::OPP, false);
+    slot.dst = Frame(src, false);
+
+    ++pushed;
+    Advance();
+}
+
+
+void VBM3D::Finish()
+{
+    finished = true;
+    Advance();
+}
+
+
+bool VBM3D::Pop(Frame &dst)
+{
+    if (output.empty())
+    {
+        return false;
+    }
+
+    dst = std::move(output.front());
+    output.pop_front();
+
+    return true;
+}
+
+
+void VBM3D::Reset()
+{
+    pushed = 0;
+    basicDone = 0;
+    finalDone = 0;
+    finished = false;
+    output.clear();
+}
+
+
+std::vector<Frame> VBM3D::operator()(const std::vector<Frame> &src)
+{
+    std::vector<Frame> dst;
+    Frame frame;
+
+    Reset();
+
+    for (const auto &s : src)
+    {
+        Push(s);
+        while (Pop(frame)) dst.push_back(std::move(frame));
+    }
+
+    Finish();
+    while (Pop(frame)) dst.push_back(std::move(frame));
+
+    Reset();
+
+    return dst;
+}
+
+
+void VBM3D::Advance()
+{
+    // The basic estimate of frame n needs the source frames up to n + radius
+    while (basicDone < pushed && (basicDone + radius < pushed || finished))
+    {
+        ProcessBasic(basicDone++);
+    }
+
+    // The final estimate of frame n needs the basic estimates up to n + radius
+    while (finalDone < basicDone && (finalDone + radius < basicDone || (finished && basicDone == pushed)))
+    {
+        ProcessFinal(finalDone++);
+    }
+}
+
+
+void VBM3D::ProcessBasic(PCType n)
+{
+    const PCType lower = Max(PCType(0), n - radius);
+    const PCType upper = Min(pushed - 1, n + radius);
+
+    BM3D_Base::PlaneSeq src[3];
+
+    for (PCType z = lower; z <= upper; ++z)
+    {
+        Slot &slot = GetSlot(z);
+
+        for (int plane = 0; plane < 3; ++plane)
+        {
+            src[plane].push_back(&slot.src[plane]);
+        }
+    }
+
+    Slot &slot = GetSlot(n);
+    Plane_FL *const dst[3] = { &slot.basic[0], &slot.basic[1], &slot.basic[2] };
+
+    basic.Kernel(dst, src, src, n - lower);
+}
+
+
+void VBM3D::ProcessFinal(PCType n)
+{
+    const PCType lower = Max(PCType(0), n - radius);
+    const PCType upper = Min(basicDone - 1, n + radius);
+
+    BM3D_Base::PlaneSeq src[3];
+    BM3D_Base::PlaneSeq ref[3];
+
+    for (PCType z = lower; z <= upper; ++z)
+    {
+        Slot &slot = GetSlot(z);
+
+        for (int plane = 0; plane < 3; ++plane)
+        {
+            src[plane].push_back(&slot.src[plane]);
+            ref[plane].push_back(&slot.basic[plane]);
+        }
+    }
+
+    Slot &slot = GetSlot(n);
+    Plane_FL dstY, dstU, dstV;
+    Plane_FL *const dst[3] = { &dstY, &dstU, &dstV };
+
+    final.Kernel(dst, src, ref, n - lower);
+
+    // Convert filtered image from YUV to RGB
+    MatrixConvert_YUV2RGB(slot.dst.R(), slot.dst.G(), slot.dst.B(), dstY, dstU, dstV, ColorMatrix::OPP, true);
+
+    output.push_back(std::move(slot.dst));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions of class VBM3D_IO
+
+
+void VBM3D_IO::arguments_process()
+{
+    _Mybase::arguments_process();
+
+    Args ArgsObj(argc, args);
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (args[i] == "-TR" || args[i] == "--radius")
+        {
+            ArgsObj.GetPara(i, radius);
+            continue;
+        }
+        if (args[i][0] == '-')
+        {
+            i++;
+            continue;
+        }
+    }
+
+    radius = Max(PCType(0), radius);
+}
+
+
+void VBM3D_IO::prepare()
+{
+    BM3D_FilterData::plan_cache &cache = BM3D_FilterData::plan_cache::instance();
+    cache.load_wisdom(WisdomPath);
+
+    VBM3D_Para vpara;
+    vpara.basic = para.basic;
+    vpara.final = para.final;
+    vpara.radius = radius;
+
+    vfilter.reset(new VBM3D(vpara));
+
+    cache.save_wisdom();
+
+    elapsed = 0;
+    frames = 0;
+}
+
+
+void VBM3D_IO::finish()
+{
+    if (frames == 0)
+    {
+        return;
+    }
+
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::cout.unsetf(std::ios_base::showpos);
+    std::cout << std::fixed << std::setprecision(2);
+
+    std::cout << "VBM3D_IO: " << frames << " frame(s) filtered in " << elapsed << " s, "
+        << (elapsed > 0 ? frames / elapsed : 0) << " fps\n";
+
+    std::cout.flags(flags);
+}
+
+
+Frame VBM3D_IO::process(const Frame &src)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    Frame dst;
+    vfilter->Push(src);
+    if (vfilter->Pop(dst)) ++frames;
+
+    std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+    elapsed += duration.count();
+
+    return dst;
+}
+
+
+Frame VBM3D_IO::flush()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    Frame dst;
+    vfilter->Finish();
+    if (vfilter->Pop(dst)) ++frames;
+
+    std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+    elapsed += duration.count();
+
+    return dst;
+}